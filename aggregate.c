@@ -0,0 +1,238 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+
+/* bst_aggregate: give a tree an aggregate of each subtree, kept by bst_put and bst_remove */
+Boolean bst_aggregate(char *tname, int offset, int size,
+		      void (*aggf) (void *, const void *, const void *, const void *))
+{
+ /*******************************************************************************
+  *  A user acccessible function that has each node of a tree keep an aggregate
+  *  of the leaves of its subtree, e.g. the sum, least and greatest of a field
+  *  of them, so bst_aggregate_range answers for any range of keys in O(log n)
+  *  rather than a walk of the tree. The aggregate is size bytes, at most
+  *  AGG_MAX, at offset in each leaf: a field of the user's leaf that the
+  *  library owns, so bst_save, bst_dump, bst_copy and bst_compact carry it
+  *  along with the rest of the leaf. Whatever the user puts there is written
+  *  over.
+  *
+  *  aggf(agg, left, leaf, right) sets agg to the aggregate of the leaves of
+  *  left, then leaf, then right, in that order: left and right are aggregates
+  *  of subtrees, leaf a users data area, and any of them may be NULL for none;
+  *  agg is never one of them. It must be associative, but need not be
+  *  commutative. With all three NULL it sets the aggregate of no leaves.
+  *
+  *  The aggregates are made for every node now, O(n); then bst_put and
+  *  bst_remove make them again on the path to the root and for the nodes each
+  *  rotation moves, with the subtree counts of a multimap (see tsubup), and
+  *  bst_freeze for the new shape, so an insert or remove costs O(log n) calls
+  *  of aggf more. Functions can not be kept in a file: a tree of
+  *  bst_open_mapped or bst_restore needs bst_aggregate again. A NULL aggf stops
+  *  keeping the aggregates.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *  offset     : Offset of the aggregate in a leaf.
+  *  size       : Bytes of the aggregate.
+  *  aggf       : Pointer to user written aggregate function, or NULL.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : Each node has the aggregate of its subtree, or none if aggf is
+  *               NULL.
+  *  FALSE      : Tree not defined, the aggregate is not within leafsize bytes,
+  *               is over AGG_MAX or overlaps the subtree count of a multimap,
+  *               or a leaf of the tree is too short for it.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+
+    extern t_header *find_header(char *);
+    extern void tmaplinks(t_header * ph);
+    extern void tsubcount(t_header * ph, t_node * root);
+    extern Boolean tleafmin(t_header * ph, int size);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    if (aggf == NULL) {
+	ph->th_aggf = NULL;
+	return (TRUE);
+    }
+    if (offset < 0 || size <= 0 || size > AGG_MAX || offset > ph->th_usiz - size
+	|| (ph->th_multi && offset < ph->th_moff + (int) sizeof(long) && ph->th_moff < offset + size)) {
+	bst_errno = BST_ERR_AGGREGATE_FIELD;
+	return (FALSE);
+    }
+    tmaplinks(ph);
+
+    /* leaves of variable size must each hold the aggregate: */
+    if (!tleafmin(ph, offset + size)) {
+	bst_errno = BST_ERR_LEAF_SIZE;
+	return (FALSE);
+    }
+
+    ph->th_aggf = aggf;
+    ph->th_aoff = offset;
+    ph->th_asiz = size;
+    if (ph->th_root != NULL)
+	tsubcount(ph, ph->th_root);
+    return (TRUE);
+}
+
+/* bst_aggregate_range: aggregate of the leaves of a tree with keys from lo to hi */
+Boolean bst_aggregate_range(char *tname, void *lo, void *hi, void *result)
+{
+ /*******************************************************************************
+  *  A user acccessible function that sets result to the aggregate of the
+  *  leaves whose keys are not before that of lo nor after that of hi, in order,
+  *  for a tree given one by bst_aggregate. The search goes down to the top node
+  *  of the range, then on down either side of it to lo and to hi; a node on the
+  *  way down to lo that is in the range brings its right subtree whole, by the
+  *  aggregate it keeps, and one on the way to hi its left subtree. So at most
+  *  two calls of aggf are made per level: O(log n). An empty range, e.g. lo
+  *  after hi, gives the aggregate of no leaves.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *  lo         : Pointer to a leaf of the tree with the first key of the range,
+  *               or NULL to start at the first node.
+  *  hi         : Pointer to a leaf of the tree with the last key of the range,
+  *               or NULL to end at the last node.
+  *
+  *  Output Parameters
+  *  =================
+  *  result     : The aggregate of the range, of the size given bst_aggregate.
+  *  Function name returns Boolean result:
+  *  TRUE       : result is set.
+  *  FALSE      : Tree not defined, lo or hi not of it, or the tree has no
+  *               aggregate.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+    t_node *p, *q;
+    unsigned long ncmp, npfx, klo, khi;
+    double buf[5][AGG_MAX / sizeof(double)];
+    void *la, *ra, *n;
+
+    extern t_header *find_header(char *);
+    extern void tmaplinks(t_header * ph);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    if ((lo != NULL && ph->th_id != (((t_node *) lo) - 1)->tn_id)
+	|| (hi != NULL && ph->th_id != (((t_node *) hi) - 1)->tn_id)) {
+	bst_errno = BST_ERR_TREE_NODE_MISMATCH;
+	return (FALSE);
+    }
+    if (ph->th_aggf == NULL) {
+	bst_errno = BST_ERR_NO_AGGREGATE;
+	return (FALSE);
+    }
+    tmaplinks(ph);
+
+    /* down to the top node of the range, the one nearest the root: */
+    ncmp = npfx = 0;
+    klo = lo != NULL && ph->th_pfx ? TPFX(ph, lo) : 0;
+    khi = hi != NULL && ph->th_pfx ? TPFX(ph, hi) : 0;
+    for (p = ph->th_root; p != NULL;)
+	if (lo != NULL && tpcmp(ph, klo, lo, p, &ncmp, &npfx) > 0)
+	    p = p->tn_rlink;
+	else if (hi != NULL && tpcmp(ph, khi, hi, p, &ncmp, &npfx) < 0)
+	    p = p->tn_llink;
+	else
+	    break;
+    if (p == NULL) {
+	STAT_ADD(STATS(ph), st_cmp, ncmp);
+	STAT_ADD(STATS(ph), st_pfx, npfx);
+	ph->th_aggf(result, NULL, NULL, NULL);
+	return (TRUE);
+    }
+
+    /* la gathers the range left of p, from right to left: a node not before lo */
+    /* goes in with its right subtree ahead of what is gathered so far. la is  */
+    /* in buf[0] or buf[1], ra in buf[2] or buf[3]; buf[4] holds a step:        */
+    if (lo == NULL)
+	la = TAGG(ph, p->tn_llink);
+    else
+	for (la = NULL, q = p->tn_llink; q != NULL;)
+	    if (tpcmp(ph, klo, lo, q, &ncmp, &npfx) <= 0) {
+		n = la == buf[0] ? buf[1] : buf[0];
+		if (la == NULL)
+		    ph->th_aggf(n, NULL, q + 1, TAGG(ph, q->tn_rlink));
+		else {
+		    ph->th_aggf(buf[4], NULL, q + 1, TAGG(ph, q->tn_rlink));
+		    ph->th_aggf(n, buf[4], NULL, la);
+		}
+		la = n;
+		q = q->tn_llink;
+	    } else
+		q = q->tn_rlink;
+
+    /* and ra the range right of p, from left to right, with left subtrees: */
+    if (hi == NULL)
+	ra = TAGG(ph, p->tn_rlink);
+    else
+	for (ra = NULL, q = p->tn_rlink; q != NULL;)
+	    if (tpcmp(ph, khi, hi, q, &ncmp, &npfx) >= 0) {
+		n = ra == buf[2] ? buf[3] : buf[2];
+		if (ra == NULL)
+		    ph->th_aggf(n, TAGG(ph, q->tn_llink), q + 1, NULL);
+		else {
+		    ph->th_aggf(buf[4], TAGG(ph, q->tn_llink), q + 1, NULL);
+		    ph->th_aggf(n, ra, NULL, buf[4]);
+		}
+		ra = n;
+		q = q->tn_rlink;
+	    } else
+		q = q->tn_llink;
+    STAT_ADD(STATS(ph), st_cmp, ncmp);
+    STAT_ADD(STATS(ph), st_pfx, npfx);
+
+    ph->th_aggf(result, la, p + 1, ra);
+    return (TRUE);
+}
@@ -0,0 +1,85 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+extern t_alloc talloc_def;
+
+
+/* bst_allocator: give the memory of the trees defined from now on to an allocator of the user */
+Boolean bst_allocator(t_alloc * pa)
+{
+ /*******************************************************************************
+  *  A user acccessible function that sets the allocator of every tree defined
+  *  from now on by bst_create, bst_create_key, bst_copy, bst_restore or
+  *  bst_open_mapped. The tree keeps its own copy of *pa, so pa need not live
+  *  on, and whatever the tree allocates - its header, its nodes, the leaves
+  *  handed to the user, and the scratch of bst_verify, bst_copy, bst_compact
+  *  and the write ahead log - it gets from ta_alloc and gives back to ta_free,
+  *  each called with ta_ctx first. The chunks of bst_freeze and bst_restore
+  *  and the slabs of nodes are much larger and are given back all at once, so
+  *  they come from ta_bulk_alloc and go to ta_bulk_free, which is also told
+  *  their size; without those they come from ta_alloc too. Trees defined
+  *  before keep the allocator they were defined with.
+  *
+  *  The library only ever asks for memory aligned as malloc's. It does not map
+  *  huge pages for the slabs of a tree with an allocator of the user (see
+  *  bst_huge_pages); that is up to the allocator. The functions must be safe
+  *  to call from as many threads as the trees are used from.
+  *
+  *  Input Parameters
+  *  =================
+  *  pa         : The allocator, or NULL for malloc and free again. ta_alloc
+  *               and ta_free are both given or both NULL; so are ta_bulk_alloc
+  *               and ta_bulk_free, and they need ta_alloc.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : Trees defined from now on use pa.
+  *  FALSE      : A function is missing from pa; the allocator is unchanged.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *  talloc_def : Set to *pa, or to all NULL.
+  *******************************************************************************/
+
+    bst_errno = BST_ERR_RESET;
+
+    if (pa == NULL) {
+	memset(&talloc_def, 0, sizeof(t_alloc));
+	return (TRUE);
+    }
+    if ((pa->ta_alloc == NULL) != (pa->ta_free == NULL) || (pa->ta_bulk_alloc == NULL) != (pa->ta_bulk_free == NULL)
+	|| (pa->ta_alloc == NULL && pa->ta_bulk_alloc != NULL)) {
+	bst_errno = BST_ERR_ALLOCATOR;
+	return (FALSE);
+    }
+    talloc_def = *pa;
+    return (TRUE);
+}
@@ -0,0 +1,1028 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+/* C++ programs include this file for bst::avl_map and bst::avl_set; link with libbst.a */
+
+/*
+ * bst::avl_map<Key, T, Compare, Allocator> and bst::avl_set<Key, Compare,
+ * Allocator> hold their values in the nodes of libbst, a struct node header
+ * followed by the value, and keep them balanced with the same rotations
+ * bst_put and bst_remove use: rbal after an insert, balancel and balancer on
+ * the way up after an erase. The searches are templates, so Compare is
+ * inlined; there is no tree name to look up and find hands back an iterator
+ * to the value in the tree rather than a copy of it.
+ *
+ * They follow std::map and std::set: bidirectional iterators that stay valid
+ * until their element is erased, values that may be move only (emplace,
+ * try_emplace), and an allocator that is rebound to the node type. Unlike
+ * std::map, a map or set must not be shared between threads without a lock,
+ * and stats() hands back the rotation counters as bst_stats does for a tree.
+ */
+
+#ifndef BST_AVL_MAP_HPP
+#define BST_AVL_MAP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace bst {
+
+/* operation counters of a map or set, the layout of BstStats in bstpkg.h: only */
+/* st_put, st_remove and the rotations are kept                                 */
+struct tree_stats {
+    unsigned long st_put;	/* values inserted */
+    unsigned long st_get;	/* not kept */
+    unsigned long st_remove;	/* values erased */
+    unsigned long st_cmp;	/* not kept */
+    unsigned long st_pfx;	/* not kept */
+    unsigned long st_ll;	/* LL rotations on insert */
+    unsigned long st_lr;	/* LR rotations on insert */
+    unsigned long st_rr;	/* RR rotations on insert */
+    unsigned long st_rl;	/* RL rotations on insert */
+    unsigned long st_rmll;	/* LL rotations on erase */
+    unsigned long st_rmlr;	/* LR rotations on erase */
+    unsigned long st_rmrr;	/* RR rotations on erase */
+    unsigned long st_rmrl;	/* RL rotations on erase */
+    unsigned long st_flist;	/* not kept */
+    unsigned long st_malloc;	/* not kept */
+    unsigned long st_chain;	/* not kept */
+    unsigned long st_free;	/* not kept */
+};
+
+namespace detail {
+
+/* the node header of libbst, struct node of inc/struct.h itself, so it is laid out as the */
+/* library was built, with or without bitfields, and with tn_pfx only if BST_KEY_PREFIX    */
+/* is defined here as it was there; the value follows it. The structures struct.h          */
+/* shares with bstpkg.h are left to bstpkg.h, whichever is included first                  */
+namespace c {
+#ifndef BST_STRUCT_KEY
+#define BST_AVL_MAP_KEY
+#endif
+#ifndef BST_STRUCT_ALLOCATOR
+#define BST_AVL_MAP_ALLOCATOR
+#endif
+#ifndef BST_STRUCT_CURSOR
+#define BST_AVL_MAP_CURSOR
+#endif
+#ifndef BST_STRUCT_VERIFY
+#define BST_AVL_MAP_VERIFY
+#endif
+#ifndef BST_STRUCT_STATS
+#define BST_AVL_MAP_STATS
+#endif
+#ifndef BST_STRUCT_MEMSTATS
+#define BST_AVL_MAP_MEMSTATS
+#endif
+#ifndef MAX_ID_LEN
+#define MAX_ID_LEN 32		/* defined in inc/bst.h */
+#define BST_AVL_MAP_ID_LEN
+#endif
+#ifndef SLAB_CLASSES
+#define SLAB_CLASSES 48		/* defined in inc/bst.h */
+#define BST_AVL_MAP_SLAB_CLASSES
+#endif
+extern "C" {
+#include "inc/struct.h"
+}
+#ifdef BST_AVL_MAP_KEY
+#undef BST_STRUCT_KEY
+#undef BST_AVL_MAP_KEY
+#endif
+#ifdef BST_AVL_MAP_ALLOCATOR
+#undef BST_STRUCT_ALLOCATOR
+#undef BST_AVL_MAP_ALLOCATOR
+#endif
+#ifdef BST_AVL_MAP_CURSOR
+#undef BST_STRUCT_CURSOR
+#undef BST_AVL_MAP_CURSOR
+#endif
+#ifdef BST_AVL_MAP_VERIFY
+#undef BST_STRUCT_VERIFY
+#undef BST_AVL_MAP_VERIFY
+#endif
+#ifdef BST_AVL_MAP_STATS
+#undef BST_STRUCT_STATS
+#undef BST_AVL_MAP_STATS
+#endif
+#ifdef BST_AVL_MAP_MEMSTATS
+#undef BST_STRUCT_MEMSTATS
+#undef BST_AVL_MAP_MEMSTATS
+#endif
+#ifdef BST_AVL_MAP_ID_LEN
+#undef MAX_ID_LEN
+#undef BST_AVL_MAP_ID_LEN
+#endif
+#ifdef BST_AVL_MAP_SLAB_CLASSES
+#undef SLAB_CLASSES
+#undef BST_AVL_MAP_SLAB_CLASSES
+#endif
+#undef MIN_TREE_NAME_LEN
+#undef MAX_TREE_NAME_LEN
+}
+typedef c::node node_hdr;
+
+enum { LEFT_SON, ROOT, RIGHT_SON };	/* Tags of inc/typedefs.h */
+
+/* the rotations of libbst (rebalance.c, remove.c) */
+extern "C" {
+    void rbal(node_hdr ** treeroot, node_hdr * a, node_hdr * f, node_hdr * q, node_hdr * b, int d, tree_stats * ps);
+    void balancel(node_hdr ** root, node_hdr ** p, int *bsw, tree_stats * ps);
+    void balancer(node_hdr ** root, node_hdr ** p, int *bsw, tree_stats * ps);
+}
+
+/* a node: the header and room for a V, which is built and destroyed by the allocator */
+template <class V> struct node : node_hdr {
+    alignas(V) unsigned char store[sizeof(V)];
+
+    V *val() { return std::launder(reinterpret_cast<V *>(store)); }
+};
+
+/* tmin, tmax: least and greatest node of the subtree p */
+inline node_hdr *tmin(node_hdr * p)
+{
+    while (p->tn_llink != nullptr)
+	p = p->tn_llink;
+    return p;
+}
+
+inline node_hdr *tmax(node_hdr * p)
+{
+    while (p->tn_rlink != nullptr)
+	p = p->tn_rlink;
+    return p;
+}
+
+/* tnext, tprev: node after and before p in order, or nullptr */
+inline node_hdr *tnext(node_hdr * p)
+{
+    if (p->tn_rlink != nullptr)
+	return tmin(p->tn_rlink);
+    while (p->tn_tag == RIGHT_SON)
+	p = p->tn_ulink;
+    return p->tn_ulink;
+}
+
+inline node_hdr *tprev(node_hdr * p)
+{
+    if (p->tn_llink != nullptr)
+	return tmax(p->tn_llink);
+    while (p->tn_tag == LEFT_SON)
+	p = p->tn_ulink;
+    return p->tn_ulink;
+}
+
+/* select1st, identity: the key of a value of a map and of a set */
+template <class Key> struct select1st {
+    template <class P> const Key &operator()(const P & v) const { return v.first; }
+};
+
+template <class Key> struct identity {
+    const Key &operator()(const Key & v) const { return v; }
+};
+
+/* tree: what avl_map and avl_set share; V is the value type and KeyOf gives its key */
+template <class Key, class V, class KeyOf, class Compare, class Alloc> class tree {
+  public:
+    typedef Key key_type;
+    typedef V value_type;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Compare key_compare;
+    typedef Alloc allocator_type;
+    typedef V &reference;
+    typedef const V &const_reference;
+    typedef typename std::allocator_traits<Alloc>::pointer pointer;
+    typedef typename std::allocator_traits<Alloc>::const_pointer const_pointer;
+
+    /* iter: a bidirectional iterator; end() is the null node, from which -- goes to the greatest */
+    template <bool Const> class iter {
+      public:
+	typedef std::bidirectional_iterator_tag iterator_category;
+	typedef V value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef typename std::conditional<Const, const V *, V *>::type pointer;
+	typedef typename std::conditional<Const, const V &, V &>::type reference;
+
+	iter() : p(nullptr), root(nullptr) {}
+	iter(node_hdr * p, node_hdr * const *root) : p(p), root(root) {}
+	template <bool C, class = typename std::enable_if<Const && !C>::type> iter(const iter<C> &i) : p(i.p), root(i.root) {}
+
+	reference operator*() const { return *static_cast<node<V> *>(p)->val(); }
+	pointer operator->() const { return static_cast<node<V> *>(p)->val(); }
+	iter &operator++() { p = tnext(p); return *this; }
+	iter operator++(int) { iter i = *this; p = tnext(p); return i; }
+	iter &operator--() { p = p == nullptr ? tmax(*root) : tprev(p); return *this; }
+	iter operator--(int) { iter i = *this; --*this; return i; }
+	template <bool C> bool operator==(const iter<C> &i) const { return p == i.p; }
+	template <bool C> bool operator!=(const iter<C> &i) const { return p != i.p; }
+
+      private:
+	template <bool> friend class iter;
+	friend class tree;
+	node_hdr *p;
+	node_hdr *const *root;
+    };
+    typedef iter<false> iterator;
+    typedef iter<true> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+  protected:
+    typedef node<V> node_t;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<node_t> node_alloc;
+    typedef std::allocator_traits<node_alloc> ntraits;
+    typedef std::allocator_traits<Alloc> vtraits;
+
+  public:
+    tree() : tree(Compare()) {}
+    explicit tree(const Compare & c, const Alloc & a = Alloc()) : cmp(c), alloc(a), root(nullptr), n(0), st() {}
+    explicit tree(const Alloc & a) : tree(Compare(), a) {}
+
+    tree(const tree & t) : tree(t.cmp, vtraits::select_on_container_copy_construction(t.get_allocator())) { clone(t); }
+    tree(const tree & t, const Alloc & a) : tree(t.cmp, a) { clone(t); }
+
+    tree(tree && t) noexcept : cmp(std::move(t.cmp)), alloc(std::move(t.alloc)), root(t.root), n(t.n), st(t.st)
+    {
+	t.root = nullptr;
+	t.n = 0;
+    }
+
+    tree(tree && t, const Alloc & a) : tree(t.cmp, a)
+    {
+	if (alloc == t.alloc)
+	    steal(t);
+	else
+	    for (auto &v : t)
+		emplace_unique(std::move(v));
+    }
+
+    ~tree() { clear(); }
+
+    tree &operator=(const tree & t)
+    {
+	if (this != &t) {
+	    clear();
+	    cmp = t.cmp;
+	    if (ntraits::propagate_on_container_copy_assignment::value)
+		alloc = t.alloc;
+	    clone(t);
+	}
+	return *this;
+    }
+
+    tree &operator=(tree && t) noexcept(ntraits::propagate_on_container_move_assignment::value
+					 || ntraits::is_always_equal::value)
+    {
+	if (this != &t) {
+	    clear();
+	    cmp = std::move(t.cmp);
+	    if (ntraits::propagate_on_container_move_assignment::value) {
+		alloc = std::move(t.alloc);
+		steal(t);
+	    } else if (alloc == t.alloc)
+		steal(t);
+	    else {
+		for (auto &v : t)
+		    emplace_unique(std::move(v));
+		t.clear();
+	    }
+	}
+	return *this;
+    }
+
+    allocator_type get_allocator() const { return allocator_type(alloc); }
+    key_compare key_comp() const { return cmp; }
+    const tree_stats &stats() const { return st; }
+
+    /* verify: whether the nodes are linked as an AVL tree with their tags and balance */
+    /* factors right, each key after the one before it, and size() of them, as         */
+    /* bst_verify checks a tree of libbst                                              */
+    bool verify() const
+    {
+	const node_hdr *prev = nullptr;
+	size_type cnt = 0;
+
+	return vheight(root, nullptr, ROOT, prev, cnt) >= 0 && cnt == n;
+    }
+
+    iterator begin() noexcept { return iterator(root == nullptr ? nullptr : tmin(root), &root); }
+    const_iterator begin() const noexcept { return const_iterator(root == nullptr ? nullptr : tmin(root), &root); }
+    const_iterator cbegin() const noexcept { return begin(); }
+    iterator end() noexcept { return iterator(nullptr, &root); }
+    const_iterator end() const noexcept { return const_iterator(nullptr, &root); }
+    const_iterator cend() const noexcept { return end(); }
+    reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+    const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+    reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+    const_reverse_iterator crend() const noexcept { return rend(); }
+
+    bool empty() const noexcept { return n == 0; }
+    size_type size() const noexcept { return n; }
+    size_type max_size() const noexcept { return ntraits::max_size(alloc); }
+
+    /* clear: destroy every node, children before their parent, with no stack */
+    void clear() noexcept
+    {
+	node_hdr *p, *up;
+
+	for (p = root; p != nullptr;)
+	    if (p->tn_llink != nullptr)
+		p = p->tn_llink;
+	    else if (p->tn_rlink != nullptr)
+		p = p->tn_rlink;
+	    else {
+		if ((up = p->tn_ulink) != nullptr)
+		    (up->tn_llink == p ? up->tn_llink : up->tn_rlink) = nullptr;
+		drop(p);
+		p = up;
+	    }
+	root = nullptr;
+	n = 0;
+    }
+
+    void swap(tree & t) noexcept
+    {
+	using std::swap;
+	swap(cmp, t.cmp);
+	if (ntraits::propagate_on_container_swap::value)
+	    swap(alloc, t.alloc);
+	swap(root, t.root);
+	swap(n, t.n);
+	swap(st, t.st);
+    }
+
+    iterator find(const key_type & k) { return iterator(search(k), &root); }
+    const_iterator find(const key_type & k) const { return const_iterator(search(k), &root); }
+    size_type count(const key_type & k) const { return search(k) != nullptr; }
+    bool contains(const key_type & k) const { return search(k) != nullptr; }
+    iterator lower_bound(const key_type & k) { return iterator(lower(k), &root); }
+    const_iterator lower_bound(const key_type & k) const { return const_iterator(lower(k), &root); }
+    iterator upper_bound(const key_type & k) { return iterator(upper(k), &root); }
+    const_iterator upper_bound(const key_type & k) const { return const_iterator(upper(k), &root); }
+    std::pair<iterator, iterator> equal_range(const key_type & k) { return {lower_bound(k), upper_bound(k)}; }
+    std::pair<const_iterator, const_iterator> equal_range(const key_type & k) const
+    {
+	return {lower_bound(k), upper_bound(k)};
+    }
+
+    /* with a transparent Compare (one with is_transparent, such as std::less<>), the */
+    /* lookups take any K it compares with key_type, e.g. a std::string_view for a   */
+    /* std::string key, so no key_type is made to search by                         */
+    template <class K, class C = Compare, class = typename C::is_transparent> iterator find(const K & k)
+    {
+	return iterator(search(k), &root);
+    }
+    template <class K, class C = Compare, class = typename C::is_transparent> const_iterator find(const K & k) const
+    {
+	return const_iterator(search(k), &root);
+    }
+    template <class K, class C = Compare, class = typename C::is_transparent> size_type count(const K & k) const
+    {
+	return search(k) != nullptr;
+    }
+    template <class K, class C = Compare, class = typename C::is_transparent> bool contains(const K & k) const
+    {
+	return search(k) != nullptr;
+    }
+    template <class K, class C = Compare, class = typename C::is_transparent> iterator lower_bound(const K & k)
+    {
+	return iterator(lower(k), &root);
+    }
+    template <class K, class C = Compare, class = typename C::is_transparent> const_iterator lower_bound(const K & k) const
+    {
+	return const_iterator(lower(k), &root);
+    }
+    template <class K, class C = Compare, class = typename C::is_transparent> iterator upper_bound(const K & k)
+    {
+	return iterator(upper(k), &root);
+    }
+    template <class K, class C = Compare, class = typename C::is_transparent> const_iterator upper_bound(const K & k) const
+    {
+	return const_iterator(upper(k), &root);
+    }
+    template <class K, class C = Compare, class = typename C::is_transparent>
+    std::pair<iterator, iterator> equal_range(const K & k)
+    {
+	return {lower_bound(k), upper_bound(k)};
+    }
+    template <class K, class C = Compare, class = typename C::is_transparent>
+    std::pair<const_iterator, const_iterator> equal_range(const K & k) const
+    {
+	return {lower_bound(k), upper_bound(k)};
+    }
+
+    iterator erase(const_iterator pos)
+    {
+	iterator next(tnext(pos.p), &root);
+
+	unlink(pos.p);
+	return next;
+    }
+
+    iterator erase(const_iterator first, const_iterator last)
+    {
+	while (first != last)
+	    first = erase(first);
+	return iterator(last.p, &root);
+    }
+
+    size_type erase(const key_type & k)
+    {
+	node_hdr *p;
+
+	if ((p = search(k)) == nullptr)
+	    return 0;
+	unlink(p);
+	return 1;
+    }
+
+  protected:
+    Compare cmp;
+    node_alloc alloc;
+    node_hdr *root;
+    size_type n;
+    tree_stats st;
+
+    static const key_type &key(node_hdr * p) { return KeyOf()(*static_cast<node_t *>(p)->val()); }
+
+    /* search: the node with key k or nullptr, as find_node */
+    template <class K> node_hdr *search(const K & k) const
+    {
+	node_hdr *p;
+
+	for (p = root; p != nullptr;)
+	    if (cmp(k, key(p)))
+		p = p->tn_llink;
+	    else if (cmp(key(p), k))
+		p = p->tn_rlink;
+	    else
+		return p;
+	return nullptr;
+    }
+
+    /* lower, upper: the least node not below k, above k, or nullptr */
+    template <class K> node_hdr *lower(const K & k) const
+    {
+	node_hdr *p, *r;
+
+	for (p = root, r = nullptr; p != nullptr;)
+	    if (cmp(key(p), k))
+		p = p->tn_rlink;
+	    else {
+		r = p;
+		p = p->tn_llink;
+	    }
+	return r;
+    }
+
+    template <class K> node_hdr *upper(const K & k) const
+    {
+	node_hdr *p, *r;
+
+	for (p = root, r = nullptr; p != nullptr;)
+	    if (cmp(k, key(p))) {
+		r = p;
+		p = p->tn_llink;
+	    } else
+		p = p->tn_rlink;
+	return r;
+    }
+
+    /* make: a new unlinked node with its value built from a */
+    template <class... A> node_hdr *make(A &&... a)
+    {
+	node_t *p;
+	Alloc va(alloc);
+
+	p = &*ntraits::allocate(alloc, 1);
+	::new (static_cast<void *>(p)) node_t;
+#ifdef BST_KEY_PREFIX
+	p->tn_pfx = 0;
+#endif
+	p->tn_id = 0;
+	p->tn_rank = 0;
+	p->tn_chunk = 0;
+	p->tn_slab = 0;
+	p->tn_usiz = sizeof(V);
+	try {
+	    vtraits::construct(va, p->val(), std::forward<A>(a)...);
+	}
+	catch(...) {
+	    ntraits::deallocate(alloc, p, 1);
+	    throw;
+	}
+	return p;
+    }
+
+    /* drop: destroy the value of an unlinked node and free it */
+    void drop(node_hdr * p) noexcept
+    {
+	Alloc va(alloc);
+
+	vtraits::destroy(va, static_cast<node_t *>(p)->val());
+	ntraits::deallocate(alloc, static_cast<node_t *>(p), 1);
+    }
+
+    /* insert: find where key k goes, as find_node does, and there link the node mk() */
+    /* makes, unless k is in the tree already                                        */
+    template <class K, class Make> std::pair<iterator, bool> insert(const K & k, Make && mk)
+    {
+	node_hdr *p, *q, *a, *f, *pn;
+	bool left;
+
+	/* a is the last node with a balance factor of +1 or -1, f its parent, q that of the new node */
+	for (p = root, q = f = nullptr, a = root, left = false; p != nullptr;) {
+	    if (p->tn_bf != 0) {
+		a = p;
+		f = q;
+	    }
+	    q = p;
+	    if ((left = cmp(k, key(p))))
+		p = p->tn_llink;
+	    else if (cmp(key(p), k))
+		p = p->tn_rlink;
+	    else
+		return {iterator(p, &root), false};
+	}
+	pn = mk();
+	link(pn, a, f, q, left);
+	return {iterator(pn, &root), true};
+    }
+
+    /* emplace_unique: build the value first, for when its key is not at hand */
+    template <class... A> std::pair<iterator, bool> emplace_unique(A &&... a)
+    {
+	node_hdr *pn;
+	std::pair<iterator, bool> r;
+
+	pn = make(std::forward<A>(a)...);
+	try {
+	    r = insert(key(pn), [pn] { return pn; });
+	}
+	catch(...) {
+	    drop(pn);
+	    throw;
+	}
+	if (!r.second)
+	    drop(pn);
+	return r;
+    }
+
+    /* link: hang pn under q and rebalance, as put_node and rbal do for bst_put */
+    void link(node_hdr * pn, node_hdr * a, node_hdr * f, node_hdr * q, bool left)
+    {
+	node_hdr *p, *b;
+	int d;
+
+	pn->tn_llink = pn->tn_rlink = nullptr;
+	pn->tn_bf = 0;
+	n++;
+	st.st_put++;
+	if (q == nullptr) {
+	    root = pn;
+	    pn->tn_ulink = nullptr;
+	    pn->tn_tag = ROOT;
+	    return;
+	}
+	pn->tn_ulink = q;
+	if (left) {
+	    q->tn_llink = pn;
+	    pn->tn_tag = LEFT_SON;
+	} else {
+	    q->tn_rlink = pn;
+	    pn->tn_tag = RIGHT_SON;
+	}
+
+	/* set the balance factors on the path from a down to the new node; d is the side of a it went */
+	if (cmp(key(a), key(pn))) {
+	    p = b = a->tn_rlink;
+	    d = -1;
+	} else {
+	    p = b = a->tn_llink;
+	    d = +1;
+	}
+	while (p != pn)
+	    if (cmp(key(pn), key(p))) {
+		p->tn_bf = +1;
+		p = p->tn_llink;
+	    } else {
+		p->tn_bf = -1;
+		p = p->tn_rlink;
+	    }
+
+	if (a->tn_bf == 0)
+	    a->tn_bf = d;
+	else if (a->tn_bf + d == 0)
+	    a->tn_bf = 0;
+	else
+	    rbal(&root, a, f, q, b, d, &st);
+    }
+
+    /* unlink: take node p out and rebalance, as bst_remove does; the values stay where */
+    /* they are, so a node with two sons first trades places with the one before it     */
+    void unlink(node_hdr * p)
+    {
+	node_hdr *s, *up, *c;
+	int tside, bsw;
+
+	if (p->tn_llink != nullptr && p->tn_rlink != nullptr) {
+	    s = tmax(p->tn_llink);
+	    trade(p, s);
+	}
+	c = p->tn_llink != nullptr ? p->tn_llink : p->tn_rlink;
+	up = p->tn_ulink;
+	tside = p->tn_tag;
+	if (up == nullptr)
+	    root = c;
+	else if (tside == LEFT_SON)
+	    up->tn_llink = c;
+	else
+	    up->tn_rlink = c;
+	if (c != nullptr) {
+	    c->tn_ulink = up;
+	    c->tn_tag = tside;
+	}
+
+	/* the subtree on the tside of up is one lower: rebalance up to the root while it matters */
+	for (bsw = 1; up != nullptr && bsw; up = up->tn_ulink) {
+	    if (tside == LEFT_SON)
+		balancel(&root, &up, &bsw, &st);
+	    else
+		balancer(&root, &up, &bsw, &st);
+	    tside = up->tn_tag;
+	}
+	drop(p);
+	n--;
+	st.st_remove++;
+    }
+
+    /* trade: swap node p, with two sons, and s, the greatest node of its left subtree, in the tree */
+    void trade(node_hdr * p, node_hdr * s)
+    {
+	node_hdr *pu, *sl;
+	int bf, tag;
+
+	pu = p->tn_ulink;
+	if (pu == nullptr)
+	    root = s;
+	else if (p->tn_tag == LEFT_SON)
+	    pu->tn_llink = s;
+	else
+	    pu->tn_rlink = s;
+	sl = s->tn_llink;
+	if (s == p->tn_llink) {
+	    s->tn_llink = p;
+	    p->tn_ulink = s;
+	} else {
+	    s->tn_llink = p->tn_llink;
+	    s->tn_llink->tn_ulink = s;
+	    s->tn_ulink->tn_rlink = p;
+	    p->tn_ulink = s->tn_ulink;
+	}
+	s->tn_ulink = pu;
+	s->tn_rlink = p->tn_rlink;
+	s->tn_rlink->tn_ulink = s;
+	p->tn_llink = sl;
+	p->tn_rlink = nullptr;
+	if (sl != nullptr)
+	    sl->tn_ulink = p;
+	bf = p->tn_bf;
+	p->tn_bf = s->tn_bf;
+	s->tn_bf = bf;
+	tag = p->tn_tag;
+	p->tn_tag = s->tn_tag;
+	s->tn_tag = tag;
+    }
+
+    /* clone: copy the shape and values of t; each node is linked before its sons are */
+    /* made, so if a copy throws, clear finds all that was made                      */
+    void clone(const tree & t)
+    {
+	node_hdr *p, *d;
+
+	if (t.root == nullptr)
+	    return;
+	try {
+	    root = d = copy1(t.root, nullptr);
+	    for (p = t.root;;) {
+		if (p->tn_llink != nullptr && d->tn_llink == nullptr) {
+		    p = p->tn_llink;
+		    d = d->tn_llink = copy1(p, d);
+		} else if (p->tn_rlink != nullptr && d->tn_rlink == nullptr) {
+		    p = p->tn_rlink;
+		    d = d->tn_rlink = copy1(p, d);
+		} else if (p == t.root)
+		    break;
+		else {
+		    p = p->tn_ulink;
+		    d = d->tn_ulink;
+		}
+	    }
+	}
+	catch(...) {
+	    clear();
+	    throw;
+	}
+	n = t.n;
+    }
+
+    node_hdr *copy1(node_hdr * p, node_hdr * up)
+    {
+	node_hdr *d;
+
+	d = make(*static_cast<node_t *>(p)->val());
+	d->tn_ulink = up;
+	d->tn_llink = d->tn_rlink = nullptr;
+	d->tn_bf = p->tn_bf;
+	d->tn_tag = p->tn_tag;
+	return d;
+    }
+
+    /* vheight: height of the subtree p, son of up on side tag, or -1 if it breaks a rule */
+    int vheight(const node_hdr * p, const node_hdr * up, int tag, const node_hdr *& prev, size_type & cnt) const
+    {
+	int lh, rh;
+
+	if (p == nullptr)
+	    return 0;
+	if (p->tn_ulink != up || (int) p->tn_tag != tag)
+	    return -1;
+	if ((lh = vheight(p->tn_llink, p, LEFT_SON, prev, cnt)) < 0)
+	    return -1;
+	if (prev != nullptr && !cmp(key(const_cast<node_hdr *>(prev)), key(const_cast<node_hdr *>(p))))
+	    return -1;
+	prev = p;
+	cnt++;
+	if ((rh = vheight(p->tn_rlink, p, RIGHT_SON, prev, cnt)) < 0)
+	    return -1;
+	if (p->tn_bf != lh - rh || lh - rh < -1 || lh - rh > 1)
+	    return -1;
+	return 1 + std::max(lh, rh);
+    }
+
+    void steal(tree & t) noexcept
+    {
+	root = t.root;
+	n = t.n;
+	st = t.st;
+	t.root = nullptr;
+	t.n = 0;
+    }
+};
+
+template <class Key, class V, class KeyOf, class Compare, class Alloc>
+bool operator==(const tree<Key, V, KeyOf, Compare, Alloc> &a, const tree<Key, V, KeyOf, Compare, Alloc> &b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+template <class Key, class V, class KeyOf, class Compare, class Alloc>
+bool operator!=(const tree<Key, V, KeyOf, Compare, Alloc> &a, const tree<Key, V, KeyOf, Compare, Alloc> &b)
+{
+    return !(a == b);
+}
+
+template <class Key, class V, class KeyOf, class Compare, class Alloc>
+bool operator<(const tree<Key, V, KeyOf, Compare, Alloc> &a, const tree<Key, V, KeyOf, Compare, Alloc> &b)
+{
+    return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+}
+
+}				/* namespace detail */
+
+/* avl_map: std::map of unique keys held in an AVL tree of libbst nodes */
+template <class Key, class T, class Compare = std::less<Key>,
+	  class Allocator = std::allocator<std::pair<const Key, T>>>
+class avl_map : public detail::tree<Key, std::pair<const Key, T>, detail::select1st<Key>, Compare, Allocator> {
+    typedef detail::tree<Key, std::pair<const Key, T>, detail::select1st<Key>, Compare, Allocator> base;
+
+  public:
+    typedef T mapped_type;
+    typedef typename base::value_type value_type;
+    typedef typename base::size_type size_type;
+    typedef typename base::iterator iterator;
+    typedef typename base::const_iterator const_iterator;
+
+    /* value_compare: orders the values by their keys, as std::map::value_compare */
+    class value_compare {
+      public:
+	bool operator()(const value_type & a, const value_type & b) const { return cmp(a.first, b.first); }
+      protected:
+	friend class avl_map;
+	explicit value_compare(Compare c) : cmp(c) {}
+	Compare cmp;
+    };
+
+    using base::base;
+    avl_map() : base() {}
+    template <class It> avl_map(It first, It last, const Compare & c = Compare(), const Allocator & a = Allocator())
+	: base(c, a) { insert(first, last); }
+    avl_map(std::initializer_list<value_type> il, const Compare & c = Compare(), const Allocator & a = Allocator())
+	: base(c, a) { insert(il.begin(), il.end()); }
+
+    value_compare value_comp() const { return value_compare(this->cmp); }
+
+    T &operator[](const Key & k) { return try_emplace(k).first->second; }
+    T &operator[](Key && k) { return try_emplace(std::move(k)).first->second; }
+
+    T &at(const Key & k)
+    {
+	iterator i = this->find(k);
+
+	if (i == this->end())
+	    throw std::out_of_range("bst::avl_map::at");
+	return i->second;
+    }
+
+    const T &at(const Key & k) const
+    {
+	const_iterator i = this->find(k);
+
+	if (i == this->end())
+	    throw std::out_of_range("bst::avl_map::at");
+	return i->second;
+    }
+
+    std::pair<iterator, bool> insert(const value_type & v)
+    {
+	return base::insert(v.first, [&] { return this->make(v); });
+    }
+
+    std::pair<iterator, bool> insert(value_type && v)
+    {
+	return base::insert(v.first, [&] { return this->make(std::move(v)); });
+    }
+
+    template <class P, class = typename std::enable_if<std::is_constructible<value_type, P &&>::value>::type>
+    std::pair<iterator, bool> insert(P && v) { return this->emplace_unique(std::forward<P>(v)); }
+
+    iterator insert(const_iterator, const value_type & v) { return insert(v).first; }
+    iterator insert(const_iterator, value_type && v) { return insert(std::move(v)).first; }
+
+    template <class It> void insert(It first, It last)
+    {
+	for (; first != last; ++first)
+	    this->emplace_unique(*first);
+    }
+
+    void insert(std::initializer_list<value_type> il) { insert(il.begin(), il.end()); }
+
+    template <class... A> std::pair<iterator, bool> emplace(A &&... a)
+    {
+	return this->emplace_unique(std::forward<A>(a)...);
+    }
+
+    template <class... A> iterator emplace_hint(const_iterator, A &&... a) { return emplace(std::forward<A>(a)...).first; }
+
+    /* try_emplace: builds the value only if k is not in the map, so a may be moved from safely */
+    template <class... A> std::pair<iterator, bool> try_emplace(const Key & k, A &&... a)
+    {
+	return base::insert(k, [&] {
+	    return this->make(std::piecewise_construct, std::forward_as_tuple(k), std::forward_as_tuple(std::forward<A>(a)...));
+	});
+    }
+
+    template <class... A> std::pair<iterator, bool> try_emplace(Key && k, A &&... a)
+    {
+	return base::insert(k, [&] {
+	    return this->make(std::piecewise_construct, std::forward_as_tuple(std::move(k)),
+			      std::forward_as_tuple(std::forward<A>(a)...));
+	});
+    }
+
+    template <class M> std::pair<iterator, bool> insert_or_assign(const Key & k, M && m)
+    {
+	std::pair<iterator, bool> r = try_emplace(k, std::forward<M>(m));
+
+	if (!r.second)
+	    r.first->second = std::forward<M>(m);
+	return r;
+    }
+
+    void swap(avl_map & m) noexcept { base::swap(m); }
+};
+
+/* avl_set: std::set of unique keys held in an AVL tree of libbst nodes; its iterators are const */
+template <class Key, class Compare = std::less<Key>, class Allocator = std::allocator<Key>>
+class avl_set : public detail::tree<Key, Key, detail::identity<Key>, Compare, Allocator> {
+    typedef detail::tree<Key, Key, detail::identity<Key>, Compare, Allocator> base;
+
+  public:
+    typedef Compare value_compare;
+    typedef typename base::size_type size_type;
+    typedef typename base::const_iterator iterator;
+    typedef typename base::const_iterator const_iterator;
+    typedef typename base::const_reverse_iterator reverse_iterator;
+    typedef typename base::const_reverse_iterator const_reverse_iterator;
+
+    using base::base;
+    avl_set() : base() {}
+    template <class It> avl_set(It first, It last, const Compare & c = Compare(), const Allocator & a = Allocator())
+	: base(c, a) { insert(first, last); }
+    avl_set(std::initializer_list<Key> il, const Compare & c = Compare(), const Allocator & a = Allocator())
+	: base(c, a) { insert(il.begin(), il.end()); }
+
+    value_compare value_comp() const { return this->cmp; }
+
+    iterator begin() const noexcept { return base::begin(); }
+    iterator end() const noexcept { return base::end(); }
+    reverse_iterator rbegin() const noexcept { return base::rbegin(); }
+    reverse_iterator rend() const noexcept { return base::rend(); }
+    iterator find(const Key & k) const { return base::find(k); }
+    iterator lower_bound(const Key & k) const { return base::lower_bound(k); }
+    iterator upper_bound(const Key & k) const { return base::upper_bound(k); }
+    std::pair<iterator, iterator> equal_range(const Key & k) const { return base::equal_range(k); }
+    template <class K, class C = Compare, class = typename C::is_transparent> iterator find(const K & k) const
+    {
+	return base::find(k);
+    }
+    template <class K, class C = Compare, class = typename C::is_transparent> iterator lower_bound(const K & k) const
+    {
+	return base::lower_bound(k);
+    }
+    template <class K, class C = Compare, class = typename C::is_transparent> iterator upper_bound(const K & k) const
+    {
+	return base::upper_bound(k);
+    }
+    template <class K, class C = Compare, class = typename C::is_transparent>
+    std::pair<iterator, iterator> equal_range(const K & k) const
+    {
+	return base::equal_range(k);
+    }
+
+    std::pair<iterator, bool> insert(const Key & k)
+    {
+	return base::insert(k, [&] { return this->make(k); });
+    }
+
+    std::pair<iterator, bool> insert(Key && k)
+    {
+	return base::insert(k, [&] { return this->make(std::move(k)); });
+    }
+
+    iterator insert(const_iterator, const Key & k) { return insert(k).first; }
+    iterator insert(const_iterator, Key && k) { return insert(std::move(k)).first; }
+
+    template <class It> void insert(It first, It last)
+    {
+	for (; first != last; ++first)
+	    this->emplace_unique(*first);
+    }
+
+    void insert(std::initializer_list<Key> il) { insert(il.begin(), il.end()); }
+
+    template <class... A> std::pair<iterator, bool> emplace(A &&... a)
+    {
+	return this->emplace_unique(std::forward<A>(a)...);
+    }
+
+    template <class... A> iterator emplace_hint(const_iterator, A &&... a) { return emplace(std::forward<A>(a)...).first; }
+
+    void swap(avl_set & s) noexcept { base::swap(s); }
+};
+
+template <class Key, class T, class Compare, class Alloc>
+void swap(avl_map<Key, T, Compare, Alloc> &a, avl_map<Key, T, Compare, Alloc> &b) noexcept
+{
+    a.swap(b);
+}
+
+template <class Key, class Compare, class Alloc>
+void swap(avl_set<Key, Compare, Alloc> &a, avl_set<Key, Compare, Alloc> &b) noexcept
+{
+    a.swap(b);
+}
+
+}				/* namespace bst */
+
+#endif
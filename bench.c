@@ -0,0 +1,1143 @@
+/*
+  +------------------------------------------------------------------------+
+  | bench is a terminal program timing the C library libbst of AVL & BST   |
+  | routines over reproducible workloads of any size.                      |
+  |                                                                        |
+  | Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net            |
+  |                                                                        |
+  | This program is free software: you can redistribute it and/or modify   |
+  | it under the terms of the GNU General Public License as published by   |
+  | the Free Software Foundation, either version 3 of the License, or      |
+  | (at your option) any later version.                                    |
+  |                                                                        |
+  | This program is distributed in the hope that it will be useful,        |
+  | but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+  | MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+  | GNU General Public License for more details.                           |
+  |                                                                        |
+  | You should have received a copy of the GNU General Public License      |
+  | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+  +------------------------------------------------------------------------+
+*/
+
+/*
+ * bench runs each workload below in turn and prints one line per workload
+ * with the number of operations, seconds taken, operations per second,
+ * nanoseconds per operation and the peak resident set size so far, as CSV
+ * (default) or JSON, for tracking regressions from one build to the next.
+ *
+ * Keys are never stored: the i'th key is computed from i and the seed by a
+ * bijective 64 bit mix, so key i and key j differ for i != j and any key can
+ * be made again at will. The same seed gives the same run; the tree sizes
+ * are limited only by memory (-n 100000000 needs about 7GB).
+ *
+ * Workloads, in the order they are run:
+ *   insert-random : insert keys 0..n-1 into tree "rand"; always run since the
+ *                   workloads after it use that tree, only reported if asked for.
+ *   get-hit       : look up ops keys known to be in the tree.
+ *   get-miss      : look up ops keys known not to be in the tree.
+ *   get-key       : get-hit by the key alone (bst_find_key), with no leaf.
+ *   freeze        : bst_freeze the tree; ops is the number of nodes laid out.
+ *   get-frozen    : get-hit on the frozen tree, then bst_thaw it.
+ *   get-keyed     : get-hit on the tree frozen with a key index of its keys
+ *                   (bst_freeze_keys), then bst_thaw it.
+ *   get-local     : get-hit on the frozen tree by this thread bound to the cpus
+ *                   of NUMA node 0, where the tree was built.
+ *   get-remote    : the same bound to the cpus of the last NUMA node, then
+ *                   bst_thaw it; less get-local is the cost of reading the tree
+ *                   across nodes (with -N replicate, of reading a copy). On a
+ *                   machine of one node, or not Linux, the two are alike.
+ *   save          : bst_save the tree to the file -m; ops is the number of nodes
+ *                   written, the tree frozen for it and thawed again.
+ *   open-mapped   : bst_open_mapped the file as tree "mapped"; ops is the number
+ *                   of nodes, none of them read or copied to open it.
+ *   get-mapped    : get-hit on the mapped tree, then bst_delete it and remove
+ *                   the file.
+ *   dump          : bst_dump the leaves of the tree to the file -d; ops is the
+ *                   number of leaves written.
+ *   restore       : bst_restore the file as tree "restored", then bst_delete it
+ *                   and remove the file; ops is the number of leaves read.
+ *   mixed         : ops operations, -r percent of them get-hits, the rest
+ *                   alternately inserting a new key and removing the oldest.
+ *   churn         : ops times remove the oldest key and insert a new one.
+ *   compact       : bst_compact the tree scattered by churn; ops is the number
+ *                   of nodes moved.
+ *   get-compacted : get-hit on the compacted tree.
+ *   copy          : bst_copy the tree; ops is the number of nodes copied.
+ *   equal         : bst_equal the tree and its copy; ops is the number of nodes.
+ *   remove        : remove every key left in the tree.
+ *   insert-seq    : insert keys 0..n-1 in ascending order into a new tree.
+ *   insert-zipf   : n inserts into a new tree of keys drawn Zipfian(-z) from
+ *                   n keys; the repeats of hot keys are rejected as duplicates.
+ *   wal-none      : -l inserts into a new tree with a write ahead log in the
+ *                   file -L (bst_wal_open) buffering its records, then closed.
+ *   wal-write     : the same, each record written as it is made.
+ *   wal-fsync     : the same, each record synced to the disk as it is made.
+ *   wal-group     : the same by WAL_THREADS threads taking turns at the tree,
+ *                   each syncing after its insert with bst_wal_commit, so the
+ *                   syncs of the threads waiting together are shared.
+ *
+ * Usage: bench [-n keys] [-o ops] [-s seed] [-r read%] [-z theta]
+ *              [-w workload,...] [-f csv|json] [-k] [-c] [-a] [-v bytes [-F]]
+ *              [-m file] [-d file] [-l inserts] [-L file]
+ *              [-C frag] [-N local|interleave|replicate] [-H] [-t] [-x] [-p]
+ *   -k  order the trees by the built in KEY_UINT64 key (bst_create_key)
+ *       rather than by a compare function called by pointer.
+ *   -c  keep a copy of each key in its node header (bst_key_prefix), so the
+ *       searches compare it there rather than in the leaf.
+ *   -a  insert a new node from bst_alloc itself (bst_put_adopt) rather than
+ *       a copy of one leaf kept for the puts (bst_put).
+ *   -v  give each leaf put a tail of 0 to bytes more bytes, most of them short
+ *       (bytes times u^4 for u uniform in 0..1), each allocated at its own size
+ *       (bst_alloc_size); compare peak_rss with -F for what the sizes save.
+ *   -F  with -v, allocate every leaf at the full size of the longest tail.
+ *   -m  the file of save and the mapped workloads (default bench.tree).
+ *   -d  the file of dump and restore (default bench.dump).
+ *   -l  the inserts of each wal workload (default 10000); a sync may take a
+ *       few milliseconds on a disk, so it is kept well below -n.
+ *   -L  the write ahead log of the wal workloads (default bench.wal).
+ *   -C  have bst_remove compact tree "rand" once the share of its node slots
+ *       not in the tree reaches frag (bst_compact_auto); see the "memory" of
+ *       -x for the fragmentation it ends with.
+ *   -N  place the nodes of tree "rand" on the NUMA nodes by the policy
+ *       (bst_numa): local to the node of the thread, interleaved page by page
+ *       across the nodes, or with a copy of the frozen tree on each node.
+ *       bench is bound to node 0 from the start when there are more nodes.
+ *   -H  malloc each node of the trees by itself rather than slab them in huge
+ *       pages as they grow (bst_huge_pages(FALSE)); compare dtlb_misses_per_op
+ *       of a run with -p and one with -p -H for the data TLB misses saved.
+ *   -t  time every call into the libbst latency histograms (bst_stats_timing);
+ *       compare a run with and without it for the cost of the timing.
+ *   -x  write bst_stats_dump of the tree to stderr at the end.
+ *   -p  count cycles, instructions, L1 data cache misses, last level cache
+ *       misses, branch misses and data TLB misses of each workload with Linux
+ *       perf_event (user space only) and add them per operation to its line.
+ *       A counter the kernel or the cpu will not give is left empty (null);
+ *       see /proc/sys/kernel/perf_event_paranoid.
+ *
+ * For meaningful numbers build the library with CC_FLAGS = $(GCC_CFLAGS_REL)
+ * and no DEBUG_LIB_* defines in the Makefile.
+ */
+
+#define _GNU_SOURCE		/* sched_setaffinity */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/* the leaf bench stores: a 64 bit key; comes before the include of bstpkg.h */
+typedef struct leafnode {
+    unsigned long key;
+} Leaf;
+
+#include "bstpkg.h"
+
+#define  KEYS_DEFAULT   1000000	/* -n */
+#define  SEED_DEFAULT   1	/* -s */
+#define  READ_DEFAULT   90	/* -r */
+#define  THETA_DEFAULT  0.99	/* -z */
+#define  WALOPS_DEFAULT 10000	/* -l */
+#define  WAL_THREADS    4	/* threads of wal-group */
+
+/* one workload: runs ops operations returning how many were done */
+typedef struct {
+    char *name;
+    long (*run)(long ops);
+    int wanted;			/* reported */
+} Workload;
+
+static long insert_random(long ops);
+static long get_hit(long ops);
+static long get_miss(long ops);
+static long get_key(long ops);
+static long freeze(long ops);
+static long get_frozen(long ops);
+static long get_keyed(long ops);
+static long get_local(long ops);
+static long get_remote(long ops);
+static long save(long ops);
+static long open_mapped(long ops);
+static long get_mapped(long ops);
+static long dump(long ops);
+static long restore(long ops);
+static long mixed(long ops);
+static long churn(long ops);
+static long compact(long ops);
+static long get_compacted(long ops);
+static long copy(long ops);
+static long equal(long ops);
+static long remove_all(long ops);
+static long insert_seq(long ops);
+static long insert_zipf(long ops);
+static long wal_none(long ops);
+static long wal_write(long ops);
+static long wal_fsync(long ops);
+static long wal_group(long ops);
+
+static Workload workloads[] = {
+    {"insert-random", insert_random, 1},
+    {"get-hit", get_hit, 1},
+    {"get-miss", get_miss, 1},
+    {"get-key", get_key, 1},
+    {"freeze", freeze, 1},
+    {"get-frozen", get_frozen, 1},
+    {"get-keyed", get_keyed, 1},
+    {"get-local", get_local, 1},
+    {"get-remote", get_remote, 1},
+    {"save", save, 1},
+    {"open-mapped", open_mapped, 1},
+    {"get-mapped", get_mapped, 1},
+    {"dump", dump, 1},
+    {"restore", restore, 1},
+    {"mixed", mixed, 1},
+    {"churn", churn, 1},
+    {"compact", compact, 1},
+    {"get-compacted", get_compacted, 1},
+    {"copy", copy, 1},
+    {"equal", equal, 1},
+    {"remove", remove_all, 1},
+    {"insert-seq", insert_seq, 1},
+    {"insert-zipf", insert_zipf, 1},
+    {"wal-none", wal_none, 1},
+    {"wal-write", wal_write, 1},
+    {"wal-fsync", wal_fsync, 1},
+    {"wal-group", wal_group, 1},
+    {NULL, NULL, 0}
+};
+
+/* the hardware counters of -p */
+#ifdef __linux__
+#define  L1D_MISS   (PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+#define  DTLB_MISS  (PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+#endif
+
+typedef struct {
+    char *name;
+    unsigned int type;		/* perf_event_attr type and config */
+    unsigned long config;
+    int fd;			/* -1 if not open */
+    double count;		/* of the last workload, scaled if multiplexed; -1 if unknown */
+} Counter;
+
+#ifdef __linux__
+static Counter counters[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, -1},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, -1},
+    {"l1d_misses", PERF_TYPE_HW_CACHE, L1D_MISS, -1, -1},
+    {"llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1, -1},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1, -1},
+    {"dtlb_misses", PERF_TYPE_HW_CACHE, DTLB_MISS, -1, -1},
+    {NULL, 0, 0, -1, -1}
+};
+#else
+static Counter counters[] = {
+    {NULL, 0, 0, -1, -1}
+};
+#endif
+
+static char *RCSid[] = { "$Id$" };
+
+static long nkeys = KEYS_DEFAULT;	/* keys inserted by each insert workload */
+static unsigned long seed = SEED_DEFAULT;	/* seed of the keys and of the draws */
+static int readpct = READ_DEFAULT;	/* percent of reads in mixed */
+static double theta = THETA_DEFAULT;	/* skew of insert-zipf */
+static unsigned long state;	/* state of rnd() */
+static long lo, hi;		/* keys lo..hi-1 are in tree "rand" */
+static Leaf *pl;		/* leaf of tree "rand" for puts and keys */
+static int frozen;		/* tree "rand" is frozen */
+static int saved;		/* tree "rand" is in mapfile */
+static int compacted;		/* tree "rand" is compacted */
+static double autofrag;		/* -C: fragmentation tree "rand" is compacted at */
+static int numa = -1;		/* -N: NUMA policy of tree "rand", -1 if none given */
+static int nnodes;		/* NUMA nodes of the machine */
+static int builtin;		/* -k: trees use a built in key */
+static int prefixed;		/* -c: trees keep key prefixes */
+static int adopt;		/* -a: insert with bst_put_adopt */
+static int vtail;		/* -v: leaves have a tail of up to vtail bytes */
+static int padded;		/* -F: every leaf has the whole tail */
+static char *mapfile = "bench.tree";	/* -m: file of the mapped workloads */
+static char *dumpfile = "bench.dump";	/* -d: file of dump and restore */
+static int dumped;		/* tree "rand" is in dumpfile */
+static long walops = WALOPS_DEFAULT;	/* -l: inserts of each wal workload */
+static char *walfile = "bench.wal";	/* -L: write ahead log of the wal workloads */
+static pthread_mutex_t wallock = PTHREAD_MUTEX_INITIALIZER;	/* tree "wal" of wal-group */
+static long walnext;		/* next key of wal-group */
+static double untimed;		/* seconds a workload spent setting up, not counted */
+
+static long wal_run(int sync);
+static void *wal_thread(void *arg);
+static Boolean create(char *tname);
+static int f(Leaf *, Leaf *);
+static int fkey(const void *, Leaf *);
+static unsigned long keyof(Leaf *);
+static unsigned long mix(unsigned long x);
+static unsigned long rnd(void);
+static unsigned long key(long i);
+static int vsize(unsigned long k);
+static void put(char *tname, Leaf * p, unsigned long k);
+static double now(void);
+static void popen_all(void);
+static void pstart(void);
+static void pstop(void);
+static long peakrss(void);
+static int countnodes(void);
+static void bindnode(int node);
+static void usage(char *prog);
+
+int main(int argc, char *argv[])
+{
+    int c, json, timing, dump, perf, nrows;
+    long ops, done;
+    double t;
+    char *list, *name;
+    Workload *w;
+    Counter *pc;
+
+    ops = -1;
+    json = timing = dump = perf = 0;
+    list = NULL;
+    while ((c = getopt(argc, argv, "n:o:s:r:z:w:f:kcav:Fm:d:l:L:C:N:Htxph")) != -1)
+	switch (c) {
+	case 'n':
+	    nkeys = atol(optarg);
+	    break;
+	case 'o':
+	    ops = atol(optarg);
+	    break;
+	case 's':
+	    seed = strtoul(optarg, NULL, 0);
+	    break;
+	case 'r':
+	    readpct = atoi(optarg);
+	    break;
+	case 'z':
+	    theta = atof(optarg);
+	    break;
+	case 'w':
+	    list = optarg;
+	    break;
+	case 'f':
+	    json = strcmp(optarg, "json") == 0;
+	    break;
+	case 'k':
+	    builtin = 1;
+	    break;
+	case 'c':
+	    prefixed = 1;
+	    break;
+	case 'a':
+	    adopt = 1;
+	    break;
+	case 'v':
+	    vtail = atoi(optarg);
+	    break;
+	case 'F':
+	    padded = 1;
+	    break;
+	case 'm':
+	    mapfile = optarg;
+	    break;
+	case 'd':
+	    dumpfile = optarg;
+	    break;
+	case 'l':
+	    walops = atol(optarg);
+	    break;
+	case 'L':
+	    walfile = optarg;
+	    break;
+	case 'C':
+	    autofrag = atof(optarg);
+	    break;
+	case 'N':
+	    numa = strcmp(optarg, "local") == 0 ? NUMA_LOCAL
+		: strcmp(optarg, "interleave") == 0 ? NUMA_INTERLEAVE
+		: strcmp(optarg, "replicate") == 0 ? NUMA_REPLICATE : -2;
+	    break;
+	case 'H':
+	    bst_huge_pages(FALSE);
+	    break;
+	case 't':
+	    timing = 1;
+	    break;
+	case 'x':
+	    dump = 1;
+	    break;
+	case 'p':
+	    perf = 1;
+	    break;
+	default:
+	    usage(argv[0]);
+	}
+    if (nkeys < 1 || readpct < 0 || readpct > 100 || theta <= 0 || theta == 1.0 || vtail < 0 || walops < 1
+	|| autofrag < 0 || autofrag >= 1 || numa == -2)
+	usage(argv[0]);
+    if (ops < 0)
+	ops = nkeys;
+
+    /* -w names the workloads to report: */
+    if (list != NULL) {
+	for (w = workloads; w->name != NULL; w++)
+	    w->wanted = 0;
+	for (name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+	    for (w = workloads; w->name != NULL && strcmp(w->name, name) != 0; w++);
+	    if (w->name == NULL)
+		usage(argv[0]);
+	    w->wanted = 1;
+	}
+    }
+
+    /* build the trees on node 0, for get-local and get-remote: */
+    if ((nnodes = countnodes()) > 1)
+	bindnode(0);
+
+    if (create("rand") == FALSE) {
+	fprintf(stderr, "bench: cannot create tree: %s\n", bst_errmsg(bst_errno));
+	return (1);
+    }
+    pl = (Leaf *) bst_alloc("rand");
+    if (autofrag > 0)
+	bst_compact_auto("rand", autofrag);
+    if (numa >= 0)
+	bst_numa("rand", numa);
+    if (timing)
+	bst_stats_timing(TRUE);
+
+    if (perf)
+	popen_all();
+
+    if (json)
+	printf("[");
+    else {
+	printf("workload,keys,ops,seconds,ops_per_sec,ns_per_op,peak_rss_kb,seed");
+	for (pc = counters; perf && pc->name != NULL; pc++)
+	    printf(",%s_per_op", pc->name);
+	printf("\n");
+    }
+    nrows = 0;
+    for (w = workloads; w->name != NULL; w++) {
+	/* every workload draws from the same point whatever ran before it: */
+	state = mix(seed + (unsigned long) (w - workloads));
+	if (!w->wanted && w->run != insert_random)
+	    continue;
+	if (perf)
+	    pstart();
+	untimed = 0;
+	t = now();
+	done = w->run(ops);
+	t = now() - t - untimed;
+	if (perf)
+	    pstop();
+	if (!w->wanted)
+	    continue;
+	if (json)
+	    printf("%s\n {\"workload\": \"%s\", \"keys\": %li, \"ops\": %li, \"seconds\": %.6f, \"ops_per_sec\": %.0f, "
+		   "\"ns_per_op\": %.1f, \"peak_rss_kb\": %li, \"seed\": %lu", nrows ? "," : "", w->name, nkeys, done,
+		   t, done ? done / t : 0.0, done ? t * 1e9 / done : 0.0, peakrss(), seed);
+	else
+	    printf("%s,%li,%li,%.6f,%.0f,%.1f,%li,%lu", w->name, nkeys, done, t, done ? done / t : 0.0,
+		   done ? t * 1e9 / done : 0.0, peakrss(), seed);
+	for (pc = counters; perf && pc->name != NULL; pc++)
+	    if (json && (pc->count < 0 || done == 0))
+		printf(", \"%s_per_op\": null", pc->name);
+	    else if (json)
+		printf(", \"%s_per_op\": %.3f", pc->name, pc->count / done);
+	    else if (pc->count < 0 || done == 0)
+		printf(",");
+	    else
+		printf(",%.3f", pc->count / done);
+	printf(json ? "}" : "\n");
+	fflush(stdout);
+	nrows++;
+    }
+    if (json)
+	printf("\n]\n");
+
+    if (dump)
+	bst_stats_dump("rand", stderr);
+    bst_release("rand", pl);
+    bst_delete("rand");
+    return (0);
+}
+
+/* insert_random: insert keys 0..nkeys-1 into tree "rand" */
+static long insert_random(long ops)
+{
+    for (hi = 0; hi < nkeys; hi++)
+	put("rand", pl, key(hi));
+    lo = 0;
+    return (nkeys);
+}
+
+/* get_hit: look up ops keys that are in the tree */
+static long get_hit(long ops)
+{
+    long i;
+    Leaf *l;
+
+    for (i = 0; i < ops; i++) {
+	pl->key = key(lo + (long) (rnd() % (hi - lo)));
+	if ((l = (Leaf *) bst_get("rand", pl)) == NULL) {
+	    fprintf(stderr, "bench: key %lu not found\n", pl->key);
+	    exit(1);
+	}
+	bst_release("rand", l);
+    }
+    return (ops);
+}
+
+/* get_miss: look up ops keys that are not in the tree; keys past hi are never inserted yet */
+static long get_miss(long ops)
+{
+    long i;
+
+    for (i = 0; i < ops; i++) {
+	pl->key = key(hi + (long) (rnd() % nkeys) + 1);
+	if (bst_get("rand", pl) != NULL) {
+	    fprintf(stderr, "bench: key %lu found\n", pl->key);
+	    exit(1);
+	}
+    }
+    return (ops);
+}
+
+/* get_key: look up ops keys known to be in the tree by the key alone */
+static long get_key(long ops)
+{
+    long i;
+    unsigned long k;
+    Leaf *l;
+
+    for (i = 0; i < ops; i++) {
+	k = key(lo + (long) (rnd() % (hi - lo)));
+	if ((l = (Leaf *) bst_find_key("rand", &k)) == NULL) {
+	    fprintf(stderr, "bench: key %lu not found\n", k);
+	    exit(1);
+	}
+	bst_release("rand", l);
+    }
+    return (ops);
+}
+
+/* freeze: lay the tree out read only */
+static long freeze(long ops)
+{
+    if (bst_freeze("rand") == FALSE) {
+	fprintf(stderr, "bench: cannot freeze tree: %s\n", bst_errmsg(bst_errno));
+	exit(1);
+    }
+    frozen = 1;
+    return (bst_count("rand"));
+}
+
+/* get_frozen: get_hit on the frozen tree, freezing it first if freeze did not run, then thaw it */
+static long get_frozen(long ops)
+{
+    double t;
+
+    if (!frozen) {
+	t = now();
+	freeze(ops);
+	untimed = now() - t;
+    }
+    get_hit(ops);
+    bst_thaw("rand");
+    frozen = 0;
+    return (ops);
+}
+
+/* get_keyed: get_hit on the tree frozen with a key index, then thaw it */
+static long get_keyed(long ops)
+{
+    double t;
+
+    t = now();
+    if (bst_freeze_keys("rand", keyof) == FALSE) {
+	fprintf(stderr, "bench: cannot freeze tree with keys: %s\n", bst_errmsg(bst_errno));
+	exit(1);
+    }
+    untimed = now() - t;
+    get_hit(ops);
+    bst_thaw("rand");
+    frozen = 0;
+    return (ops);
+}
+
+/* get_local: get_hit on the frozen tree bound to node 0, freezing it first if need be */
+static long get_local(long ops)
+{
+    double t;
+
+    if (!frozen) {
+	t = now();
+	freeze(ops);
+	untimed = now() - t;
+    }
+    bindnode(0);
+    return (get_hit(ops));
+}
+
+/* get_remote: get_hit on the frozen tree bound to the last node, then thaw it */
+static long get_remote(long ops)
+{
+    double t;
+
+    if (!frozen) {
+	t = now();
+	freeze(ops);
+	untimed = now() - t;
+    }
+    bindnode(nnodes - 1);
+    get_hit(ops);
+    bindnode(0);
+    bst_thaw("rand");
+    frozen = 0;
+    return (ops);
+}
+
+/* save: write the tree to mapfile */
+static long save(long ops)
+{
+    if (bst_save("rand", mapfile) == FALSE) {
+	fprintf(stderr, "bench: cannot save tree to %s: %s\n", mapfile, bst_errmsg(bst_errno));
+	exit(1);
+    }
+    saved = 1;
+    return (bst_count("rand"));
+}
+
+/* open_mapped: map mapfile as tree "mapped", saving the tree first if save did not run */
+static long open_mapped(long ops)
+{
+    double t;
+
+    if (!saved) {
+	t = now();
+	save(ops);
+	untimed = now() - t;
+    }
+    if (bst_open_mapped("mapped", mapfile, builtin ? NULL : f, NULL) == FALSE) {
+	fprintf(stderr, "bench: cannot open %s: %s\n", mapfile, bst_errmsg(bst_errno));
+	exit(1);
+    }
+    if (!builtin)
+	bst_key_compare("mapped", fkey);
+    return (bst_count("mapped"));
+}
+
+/* get_mapped: get_hit on the mapped tree, opening it first if open-mapped did not run */
+static long get_mapped(long ops)
+{
+    long i;
+    double t;
+    Leaf *l;
+
+    if (bst_defined("mapped") == FALSE) {
+	t = now();
+	open_mapped(ops);
+	untimed = now() - t;
+    }
+    /* the mapped tree keeps the id of the tree saved, so pl of "rand" searches it: */
+    for (i = 0; i < ops; i++) {
+	pl->key = key(lo + (long) (rnd() % (hi - lo)));
+	if ((l = (Leaf *) bst_get("mapped", pl)) == NULL) {
+	    fprintf(stderr, "bench: key %lu not found in %s\n", pl->key, mapfile);
+	    exit(1);
+	}
+	bst_release("mapped", l);
+    }
+    bst_delete("mapped");
+    unlink(mapfile);
+    saved = 0;
+    return (ops);
+}
+
+/* dump: write the leaves of the tree to dumpfile */
+static long dump(long ops)
+{
+    if (bst_dump("rand", dumpfile) == FALSE) {
+	fprintf(stderr, "bench: cannot dump tree to %s: %s\n", dumpfile, bst_errmsg(bst_errno));
+	exit(1);
+    }
+    dumped = 1;
+    return (bst_count("rand"));
+}
+
+/* restore: build tree "restored" from dumpfile, dumping the tree first if dump did not run */
+static long restore(long ops)
+{
+    double t;
+    long n;
+
+    if (!dumped) {
+	t = now();
+	dump(ops);
+	untimed = now() - t;
+    }
+    if (bst_restore("restored", dumpfile, builtin ? NULL : f, NULL) == FALSE) {
+	fprintf(stderr, "bench: cannot restore %s: %s\n", dumpfile, bst_errmsg(bst_errno));
+	exit(1);
+    }
+    n = bst_count("restored");
+    t = now();
+    bst_delete("restored");
+    unlink(dumpfile);
+    dumped = 0;
+    untimed += now() - t;
+    return (n);
+}
+
+/* mixed: readpct percent get-hits, the rest alternately inserting a new key and removing the oldest */
+static long mixed(long ops)
+{
+    long i, writes;
+    Leaf *l;
+
+    for (i = writes = 0; i < ops; i++)
+	if (rnd() % 100 < readpct) {
+	    pl->key = key(lo + (long) (rnd() % (hi - lo)));
+	    if ((l = (Leaf *) bst_get("rand", pl)) != NULL)
+		bst_release("rand", l);
+	} else if (writes++ % 2 == 0)
+	    put("rand", pl, key(hi++));
+	else {
+	    pl->key = key(lo++);
+	    bst_remove("rand", pl);
+	}
+    return (ops);
+}
+
+/* churn: ops times remove the oldest key and insert a new one */
+static long churn(long ops)
+{
+    long i;
+
+    for (i = 0; i < ops; i++) {
+	pl->key = key(lo++);
+	bst_remove("rand", pl);
+	put("rand", pl, key(hi++));
+    }
+    return (2 * ops);
+}
+
+/* compact: move the nodes of the tree into one chunk in search order */
+static long compact(long ops)
+{
+    if (bst_compact("rand", 0) != 0) {
+	fprintf(stderr, "bench: cannot compact tree: %s\n", bst_errmsg(bst_errno));
+	exit(1);
+    }
+    compacted = 1;
+    return (bst_count("rand"));
+}
+
+/* get_compacted: get_hit on the compacted tree, compacting it first if compact did not run */
+static long get_compacted(long ops)
+{
+    double t;
+
+    if (!compacted) {
+	t = now();
+	compact(ops);
+	untimed = now() - t;
+    }
+    return (get_hit(ops));
+}
+
+/* copy: copy the tree to tree "copy" */
+static long copy(long ops)
+{
+    if (bst_copy("rand", "copy") == FALSE) {
+	fprintf(stderr, "bench: cannot copy tree: %s\n", bst_errmsg(bst_errno));
+	exit(1);
+    }
+    return (bst_count("rand"));
+}
+
+/* equal: compare the tree and its copy, making the copy first if copy did not run */
+static long equal(long ops)
+{
+    double t;
+    long n;
+
+    if (bst_defined("copy") == FALSE) {
+	t = now();
+	copy(ops);
+	untimed = now() - t;
+    }
+    if (bst_equal("rand", "copy") == FALSE) {
+	fprintf(stderr, "bench: copy is not equal\n");
+	exit(1);
+    }
+    n = bst_count("rand");
+    bst_delete("copy");
+    return (n);
+}
+
+/* remove_all: remove every key left in the tree */
+static long remove_all(long ops)
+{
+    long n;
+
+    bst_delete("copy");
+    for (n = 0; lo < hi; n++) {
+	pl->key = key(lo++);
+	if (bst_remove("rand", pl) == FALSE) {
+	    fprintf(stderr, "bench: cannot remove key %lu: %s\n", pl->key, bst_errmsg(bst_errno));
+	    exit(1);
+	}
+    }
+    return (n);
+}
+
+/* insert_seq: insert keys 0..nkeys-1 in ascending order into a new tree */
+static long insert_seq(long ops)
+{
+    long i;
+    Leaf *p;
+
+    create("seq");
+    p = (Leaf *) bst_alloc("seq");
+    for (i = 0; i < nkeys; i++)
+	put("seq", p, (unsigned long) i);
+    bst_release("seq", p);
+    bst_delete("seq");
+    return (nkeys);
+}
+
+/* insert_zipf: nkeys inserts of keys drawn Zipfian from nkeys keys, as YCSB does (Gray et al.) */
+static long insert_zipf(long ops)
+{
+    long i;
+    double zetan, zeta2, alpha, eta, u, uz;
+    Leaf *p;
+
+    for (zetan = 0.0, i = 1; i <= nkeys; i++)
+	zetan += 1.0 / pow((double) i, theta);
+    zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+    alpha = 1.0 / (1.0 - theta);
+    eta = (1.0 - pow(2.0 / nkeys, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+
+    create("zipf");
+    p = (Leaf *) bst_alloc("zipf");
+    for (i = 0; i < nkeys; i++) {
+	u = (double) (rnd() >> 11) / 9007199254740992.0;
+	uz = u * zetan;
+	p->key = key(uz < 1.0 ? 0 : uz < zeta2 ? 1 : (long) (nkeys * pow(eta * u - eta + 1.0, alpha)));
+	bst_put("zipf", p);
+    }
+    bst_release("zipf", p);
+    bst_delete("zipf");
+    return (nkeys);
+}
+
+/* wal_none: walops inserts logged to a buffer */
+static long wal_none(long ops)
+{
+    return (wal_run(WAL_NONE));
+}
+
+/* wal_write: walops inserts each written to the log */
+static long wal_write(long ops)
+{
+    return (wal_run(WAL_WRITE));
+}
+
+/* wal_fsync: walops inserts each synced to the log */
+static long wal_fsync(long ops)
+{
+    return (wal_run(WAL_FSYNC));
+}
+
+/* wal_group: walops inserts by WAL_THREADS threads, each synced by a group commit */
+static long wal_group(long ops)
+{
+    return (wal_run(WAL_COMMIT));
+}
+
+/* wal_run: insert keys 0..walops-1 into a new tree "wal" logged at level sync, then close the log */
+static long wal_run(int sync)
+{
+    long i;
+    pthread_t tids[WAL_THREADS];
+    Leaf *p;
+
+    unlink(walfile);
+    create("wal");
+    if (bst_wal_open("wal", walfile, sync) == FALSE) {
+	fprintf(stderr, "bench: cannot open log %s: %s\n", walfile, bst_errmsg(bst_errno));
+	exit(1);
+    }
+    if (sync == WAL_COMMIT) {
+	walnext = 0;
+	for (i = 0; i < WAL_THREADS; i++)
+	    pthread_create(&tids[i], NULL, wal_thread, NULL);
+	for (i = 0; i < WAL_THREADS; i++)
+	    pthread_join(tids[i], NULL);
+    } else {
+	p = (Leaf *) bst_alloc("wal");
+	for (i = 0; i < walops; i++)
+	    put("wal", p, key(i));
+	bst_release("wal", p);
+    }
+    if (bst_wal_close("wal") == FALSE) {
+	fprintf(stderr, "bench: cannot close log %s: %s\n", walfile, bst_errmsg(bst_errno));
+	exit(1);
+    }
+    bst_delete("wal");
+    unlink(walfile);
+    return (walops);
+}
+
+/* wal_thread: take the next key and insert it under wallock, then commit it with the other threads */
+static void *wal_thread(void *arg)
+{
+    long i;
+    Leaf *p;
+
+    pthread_mutex_lock(&wallock);
+    p = (Leaf *) bst_alloc("wal");
+    while ((i = walnext++) < walops) {
+	put("wal", p, key(i));
+	pthread_mutex_unlock(&wallock);
+	if (bst_wal_commit("wal") == FALSE) {
+	    fprintf(stderr, "bench: cannot commit log %s: %s\n", walfile, bst_errmsg(bst_errno));
+	    exit(1);
+	}
+	pthread_mutex_lock(&wallock);
+    }
+    bst_release("wal", p);
+    pthread_mutex_unlock(&wallock);
+    return (NULL);
+}
+
+/* create: create an AVL tree of Leafs ordered by f, or with -k by the built in key */
+static Boolean create(char *tname)
+{
+    BstKey k;
+
+    k.tk_type = KEY_UINT64;
+    k.tk_offset = offsetof(Leaf, key);
+    k.tk_len = 0;
+    if (!(builtin ? bst_create_key(tname, AVL, sizeof(Leaf) + vtail, FALSE, &k, NULL, TREE_VERIFY_NO)
+	  : bst_create(tname, AVL, sizeof(Leaf) + vtail, FALSE, f, NULL, TREE_VERIFY_NO)))
+	return (FALSE);
+    if (!builtin && bst_key_compare(tname, fkey) == FALSE)
+	return (FALSE);
+    return (!prefixed || bst_key_prefix(tname, builtin ? NULL : keyof));
+}
+
+/* f: compare two keys */
+static int f(Leaf * a, Leaf * b)
+{
+    return (a->key < b->key ? -1 : a->key > b->key);
+}
+
+/* fkey: compare a bare key to that of a leaf */
+static int fkey(const void *k, Leaf * b)
+{
+    unsigned long a;
+
+    a = *(const unsigned long *) k;
+    return (a < b->key ? -1 : a > b->key);
+}
+
+/* keyof: the key is its own fixed width key for bst_freeze_keys */
+static unsigned long keyof(Leaf * a)
+{
+    return (a->key);
+}
+
+/* mix: splitmix64 finalizer; a bijection, so distinct inputs give distinct keys */
+static unsigned long mix(unsigned long x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+    return (x ^ (x >> 31));
+}
+
+/* rnd: next number of the splitmix64 sequence */
+static unsigned long rnd(void)
+{
+    return (mix(state += 0x9e3779b97f4a7c15UL));
+}
+
+/* key: the i'th key of this seed */
+static unsigned long key(long i)
+{
+    return (mix((unsigned long) i + seed * 0x9e3779b97f4a7c15UL));
+}
+
+/* vsize: bytes of the leaf of key k; with -v a tail of vtail * u^4 for u of k in 0..1 */
+static int vsize(unsigned long k)
+{
+    double u;
+
+    if (padded)
+	return (sizeof(Leaf) + vtail);
+    u = (mix(k) >> 11) * (1.0 / 9007199254740992.0);
+    return (sizeof(Leaf) + (int) (vtail * u * u * u * u));
+}
+
+/* put: insert key k into tname with leaf p, or with -a or -v a new node, stopping the run if it cannot */
+static void put(char *tname, Leaf * p, unsigned long k)
+{
+    Leaf *q;
+
+    q = p;
+    if ((adopt || vtail) && (q = (Leaf *) bst_alloc_size(tname, vsize(k))) == NULL) {
+	fprintf(stderr, "bench: cannot allocate a node: %s\n", bst_errmsg(bst_errno));
+	exit(1);
+    }
+    q->key = k;
+    if ((adopt ? bst_put_adopt(tname, q) : bst_put(tname, q)) == FALSE) {
+	fprintf(stderr, "bench: cannot insert key %lu: %s\n", k, bst_errmsg(bst_errno));
+	exit(1);
+    }
+    if (q != p && !adopt)
+	bst_release(tname, q);
+}
+
+/* now: seconds on the monotonic clock */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+/* popen_all: open the counters of -p, disabled, counting this process in user space */
+static void popen_all(void)
+{
+#ifdef __linux__
+    struct perf_event_attr pa;
+    Counter *pc;
+
+    for (pc = counters; pc->name != NULL; pc++) {
+	memset(&pa, 0, sizeof(pa));
+	pa.size = sizeof(pa);
+	pa.type = pc->type;
+	pa.config = pc->config;
+	pa.disabled = 1;
+	pa.exclude_kernel = 1;
+	pa.exclude_hv = 1;
+	pa.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	if ((pc->fd = (int) syscall(SYS_perf_event_open, &pa, 0, -1, -1, 0)) < 0)
+	    fprintf(stderr, "bench: no %s counter: %s\n", pc->name, strerror(errno));
+    }
+#else
+    fprintf(stderr, "bench: no hardware counters on this platform\n");
+#endif
+}
+
+/* pstart: zero and start the open counters */
+static void pstart(void)
+{
+    Counter *pc;
+
+    for (pc = counters; pc->name != NULL; pc++)
+	if (pc->fd >= 0) {
+	    ioctl(pc->fd, PERF_EVENT_IOC_RESET, 0);
+	    ioctl(pc->fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+/* pstop: stop the open counters and read them, scaling up any the kernel multiplexed */
+static void pstop(void)
+{
+    Counter *pc;
+    unsigned long v[3];		/* value, time enabled, time running */
+
+    for (pc = counters; pc->name != NULL; pc++) {
+	pc->count = -1;
+	if (pc->fd < 0)
+	    continue;
+	ioctl(pc->fd, PERF_EVENT_IOC_DISABLE, 0);
+	if (read(pc->fd, v, sizeof(v)) == sizeof(v) && v[2] != 0)
+	    pc->count = (double) v[0] * v[1] / v[2];
+    }
+}
+
+/* peakrss: peak resident set size of the process so far in KB */
+static long peakrss(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_maxrss);
+}
+
+/* countnodes: NUMA nodes of the machine, 1 if it does not say */
+static int countnodes(void)
+{
+    char path[64];
+    int n;
+
+    for (n = 0;; n++) {
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", n);
+	if (access(path, F_OK) != 0)
+	    break;
+    }
+    return (n > 0 ? n : 1);
+}
+
+/* bindnode: bind this thread to the cpus of NUMA node node, as its cpulist gives them */
+static void bindnode(int node)
+{
+#ifdef __linux__
+    char path[64];
+    FILE *fp;
+    cpu_set_t set;
+    int a, b, c;
+
+    if (nnodes < 2)
+	return;
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    if ((fp = fopen(path, "r")) == NULL)
+	return;
+    CPU_ZERO(&set);
+    /* a list such as 0-3,8-11: */
+    while (fscanf(fp, "%d", &a) == 1) {
+	b = a;
+	if ((c = fgetc(fp)) == '-') {
+	    if (fscanf(fp, "%d", &b) != 1)
+		break;
+	    c = fgetc(fp);
+	}
+	for (; a <= b && a < CPU_SETSIZE; a++)
+	    CPU_SET(a, &set);
+	if (c != ',')
+	    break;
+    }
+    fclose(fp);
+    if (CPU_COUNT(&set) > 0)
+	sched_setaffinity(0, sizeof(set), &set);
+#endif
+}
+
+/* usage: say how to run bench and stop */
+static void usage(char *prog)
+{
+    Workload *w;
+
+    fprintf(stderr, "usage: %s [-n keys] [-o ops] [-s seed] [-r read%%] [-z theta] [-w workload,...] [-f csv|json] [-k] [-c] [-a] [-v bytes [-F]] [-m file] [-d file] [-l inserts] [-L file] [-C frag] [-N local|interleave|replicate] [-H] [-t] [-x] [-p]\n",
+	    prog);
+    fprintf(stderr, "workloads:");
+    for (w = workloads; w->name != NULL; w++)
+	fprintf(stderr, " %s", w->name);
+    fprintf(stderr, "\n");
+    exit(2);
+}
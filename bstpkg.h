@@ -21,31 +21,162 @@
 
 /* userland programs include this file for use of libbst.a */
 
+#include <stdio.h>
+
 extern int bst_errno;
 
 typedef enum { FALSE, TRUE } Boolean;
 typedef enum { AVL, BST } BstType;
-typedef enum { TREE_VERIFY_NO, TREE_VERIFY_YES } TreeVerifyType;
+typedef enum { TREE_VERIFY_NO, TREE_VERIFY_YES, TREE_VERIFY_PATH } TreeVerifyType;
+typedef enum { KEY_USER, KEY_INT32, KEY_INT64, KEY_UINT64, KEY_DOUBLE, KEY_MEMCMP, KEY_STRING } KeyType;
+typedef enum { WAL_NONE, WAL_WRITE, WAL_COMMIT, WAL_FSYNC } WalSync;
+typedef enum { NUMA_LOCAL, NUMA_INTERLEAVE, NUMA_REPLICATE } NumaPolicy;
+
+/* built in key for bst_create_key(): its type and where it is in the users data, */
+/* e.g. { KEY_STRING, offsetof(Leaf, key), sizeof(((Leaf *) 0)->key) }           */
+#ifndef BST_STRUCT_KEY
+#define BST_STRUCT_KEY
+struct key {
+    int tk_type;		/* KeyType */
+    int tk_offset;		/* offset of the key in the users data */
+    int tk_len;			/* bytes of a KEY_MEMCMP or KEY_STRING key */
+};
+#endif
+typedef struct key BstKey;
+
+/* result of bst_verify(): the first violation found, if any */
+#ifndef BST_STRUCT_VERIFY
+#define BST_STRUCT_VERIFY
+struct verify {
+    int tv_errno;		/* kind of violation, see bst_errmsg(); 0 if none */
+    void *tv_leaf;		/* users data area of the bad node; NULL if none */
+    long int tv_ncnt;		/* number of nodes counted */
+    int tv_height;		/* height of the tree */
+};
+#endif
+typedef struct verify BstVerify;
+
+/* result of bst_stats(): operation counters of a tree since it was created */
+#ifndef BST_STRUCT_STATS
+#define BST_STRUCT_STATS
+struct stats {
+    unsigned long st_put;	/* bst_put calls */
+    unsigned long st_get;	/* bst_get calls */
+    unsigned long st_remove;	/* bst_remove calls */
+    unsigned long st_cmp;	/* compare function calls by the three */
+    unsigned long st_pfx;	/* compares decided by the key prefixes alone */
+    unsigned long st_ll;	/* LL rotations on insert */
+    unsigned long st_lr;	/* LR rotations on insert */
+    unsigned long st_rr;	/* RR rotations on insert */
+    unsigned long st_rl;	/* RL rotations on insert */
+    unsigned long st_rmll;	/* LL rotations on remove */
+    unsigned long st_rmlr;	/* LR rotations on remove */
+    unsigned long st_rmrr;	/* RR rotations on remove */
+    unsigned long st_rmrl;	/* RL rotations on remove */
+    unsigned long st_flist;	/* nodes taken from the tree's free list */
+    unsigned long st_malloc;	/* nodes malloc'd */
+    unsigned long st_chain;	/* nodes put back on the free list */
+    unsigned long st_free;	/* nodes freed, the free list being full */
+};
+#endif
+typedef struct stats BstStats;
+
+/* result of bst_mem_stats(): how full the chunks and slabs of a tree are */
+#ifndef BST_STRUCT_MEMSTATS
+#define BST_STRUCT_MEMSTATS
+struct memstats {
+    long int ms_nodes;		/* nodes in the tree */
+    long int ms_slots;		/* nodes its chunks and slabs have room for */
+    long int ms_chunked;	/* of those, in chunks */
+    long int ms_free;		/* nodes on the free lists */
+    long int ms_unused;		/* slab nodes not handed out yet */
+    long int ms_malloced;	/* nodes of the tree malloc'd by themselves */
+    long int ms_bytes;		/* bytes of the chunks and slabs */
+    long int ms_huge;		/* of those, in huge pages */
+    double ms_frag;		/* share of the slots not holding a node of the tree */
+    double ms_distance;		/* average bytes from a node to its parent */
+};
+#endif
+typedef struct memstats BstMemStats;
+
+/* memory of the trees defined after bst_allocator(); ctx is ta_ctx */
+#ifndef BST_STRUCT_ALLOCATOR
+#define BST_STRUCT_ALLOCATOR
+struct allocator {
+    void *(*ta_alloc) (void *ctx, size_t size);	/* allocate size bytes; NULL: malloc */
+    void (*ta_free) (void *ctx, void *p);	/* give back what ta_alloc gave */
+    void *(*ta_bulk_alloc) (void *ctx, size_t size);	/* chunks and slabs of nodes, or NULL */
+    void (*ta_bulk_free) (void *ctx, void *p, size_t size);	/* give back a bulk piece of size bytes */
+    void *ta_ctx;		/* first argument of each of the above */
+};
+#endif
+typedef struct allocator BstAllocator;
+
+/* a run of equal keys of a multimap from bst_equal_range(), read by bst_cursor_next() */
+#ifndef BST_STRUCT_CURSOR
+#define BST_STRUCT_CURSOR
+struct cursor {
+    void *tu_next;		/* node to hand back next, or NULL at the end */
+    void *tu_last;		/* last node of the run */
+    long int tu_count;		/* nodes in the run */
+    unsigned long tu_gen;	/* th_gen of the tree the run is of */
+};
+#endif
+typedef struct cursor BstCursor;
 
 
+extern Boolean bst_aggregate(char *, int, int, void (*)(void *, const void *, const Leaf *, const void *));
+extern Boolean bst_aggregate_range(char *, void *, void *, void *);
 extern void *bst_alloc(char *);
+extern void *bst_alloc_size(char *, int);
+extern Boolean bst_allocator(BstAllocator *);
+extern Boolean bst_checkpoint(char *, char *);
+extern long bst_compact(char *, long);
+extern Boolean bst_compact_auto(char *, double);
 extern Boolean bst_copy(char *, char *);
 extern int bst_count(char *);
+extern long bst_count_key(char *, void *);
 extern Boolean bst_create(char *, int, int, int, int (*)(Leaf *, Leaf *), void (*prntf) (Leaf *, int), int);
+extern Boolean bst_create_key(char *, int, int, int, BstKey *, void (*prntf) (Leaf *, int), int);
+extern void *bst_cursor_next(char *, BstCursor *);
 extern Boolean bst_defined(char *);
 extern Boolean bst_delete(char *);
+extern Boolean bst_dump(char *, char *);
 extern Boolean bst_empty(char *);
 extern char *bst_errmsg(int);
 extern Boolean bst_equal(char *, char *);
+extern Boolean bst_equal_range(char *, void *, BstCursor *);
+extern void *bst_find_key(char *, const void *);
+extern Boolean bst_freeze(char *);
+extern Boolean bst_freeze_keys(char *, unsigned long (*)(Leaf *));
 extern void *bst_get(char *, void *);
+extern void bst_huge_pages(Boolean);
+extern Boolean bst_numa(char *, int);
+extern Boolean bst_mem_stats(char *, BstMemStats *);
+extern Boolean bst_multimap(char *, Boolean, int);
 extern Boolean bst_ident(char *, char *);
+extern Boolean bst_key_compare(char *, int (*)(const void *, Leaf *));
+extern Boolean bst_key_prefix(char *, unsigned long (*)(Leaf *));
+extern int bst_leaf_size(char *, void *);
 extern void *bst_node(char *);
+extern Boolean bst_open_mapped(char *, char *, int (*)(Leaf *, Leaf *), void (*prntf) (Leaf *, int));
 extern void bst_print(char *);
 extern Boolean bst_put(char *, void *);
+extern Boolean bst_put_adopt(char *, void *);
 extern void bst_rprint(char *);
 extern Boolean bst_remove(char *, void *);
+extern Boolean bst_restore(char *, char *, int (*)(Leaf *, Leaf *), void (*prntf) (Leaf *, int));
+extern Boolean bst_save(char *, char *);
 extern Boolean bst_release(char *, void *);
 extern void bst_stat(char *);	/* debugging purposes only; remove when done */
+extern Boolean bst_stats(char *, BstStats *);
+extern void bst_stats_timing(Boolean);
+extern Boolean bst_stats_dump(char *, FILE *);
+extern Boolean bst_thaw(char *);
+extern Boolean bst_wal_close(char *);
+extern Boolean bst_wal_commit(char *);
+extern Boolean bst_wal_open(char *, char *, int);
+extern Boolean bst_verify(char *, BstVerify *);
 
 /* TODO extern void     bst_trees  (void); *//* return array of defined trees */
 /* TODO extern char[] bst_treewalk(tn, treeorder,userfunction); */
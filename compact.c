@@ -0,0 +1,350 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+/* the compaction under way of a tree; th_cmp points to one */
+struct compact {
+    t_chunk *chunk;		/* the chunk the nodes are moved into */
+    t_node *base;		/* its first slot */
+    long n;			/* its slots: th_ncnt when begun */
+    long k;			/* slots filled */
+    long top;			/* breadth first index of the next top node, 0 past them */
+    t_node *cur;		/* past the top: the next node in order */
+    int depth;			/* depth of cur, the root's 0 */
+    unsigned long gen;		/* th_gen when begun */
+};
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+static long tcompact(t_header * ph, long nodes);
+static void tmove(t_header * ph, t_node * s, t_node * p);
+static t_node *tnext(t_node * p, int *depth);
+
+
+/* bst_compact: move the nodes of a tree into one chunk in the order its searches take them */
+long bst_compact(char *tname, long nodes)
+{
+ /*******************************************************************************
+  *  A user acccessible function that moves the nodes of a tree, scattered over
+  *  its slabs by a churn of puts and removes, into a new chunk laid out for the
+  *  searches and walks of the tree: the top COMPACT_LEVELS levels breadth first,
+  *  so that the start of every search is in a few pages, and the nodes below
+  *  them in order, so that each subtree of the top is in one piece and a walk
+  *  in order, or the end of a search, goes from a node to its neighbours. Each
+  *  node moved is copied into its slot, the links to and from it are set to
+  *  the slot, and the old node is freed as bst_remove frees one.
+  *
+  *  The work can be spread over idle time: each call moves at most nodes nodes
+  *  and the tree is whole and usable in between. A put or remove in between
+  *  spoils the layout; the next call then starts over with a new chunk, and the
+  *  nodes already moved are moved again. When the last node is moved, the
+  *  chunks the tree had before, the pages of a tree file opened by
+  *  bst_open_mapped, the free nodes malloc'd by themselves and every slab with
+  *  no node in use go back. Nodes removed from the chunk later are not reused
+  *  until the tree is compacted, frozen or deleted again. A frozen tree is laid
+  *  out already; it is left as it is.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree to compact.
+  *  nodes      : Most nodes to move in this call; 0 or less for all of them.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns the nodes still to move, 0 when the tree is compact,
+  *  or -1 if the tree is not defined or on a malloc error.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+
+    extern t_header *find_header(char *);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (-1);
+    }
+    return (tcompact(ph, nodes));
+}
+
+/* tcompact: does the work of bst_compact */
+static long tcompact(t_header * ph, long nodes)
+{
+    struct compact *pm;
+    t_chunk *pc, **pp;
+    t_node *p, *s, *pn;
+    long moved, stride, b;
+
+    extern void *tallocm(MallocTypes mkind, ...);
+    extern void tfreem(MallocTypes mkind, ...);
+    extern void *tmalloc(t_header * ph, size_t size);
+    extern void tmfree(t_header * ph, void *p);
+    extern void tmaplinks(t_header * ph);
+    extern long tslabtrim(t_header * ph);
+    extern void tcmpfree(t_header * ph);
+
+    if (ph->th_frozen)
+	return (0);
+    tmaplinks(ph);
+
+    /* Begin, or begin again if the tree has changed since the last call: */
+    if ((pm = ph->th_cmp) != NULL && pm->gen != ph->th_gen)
+	tcmpfree(ph);
+    if ((pm = ph->th_cmp) == NULL) {
+	if (ph->th_ncnt == 0)
+	    return (0);
+	if ((pm = (struct compact *) tmalloc(ph, sizeof(struct compact))) == NULL) {
+	    bst_errno = BST_ERR_MALLOC;
+	    return (-1);
+	}
+	if ((pm->base = (t_node *) tallocm(T_CHUNK, ph, ph->th_ncnt)) == NULL) {
+	    tmfree(ph, pm);
+	    return (-1);
+	}
+	pm->chunk = ph->th_clist;
+	pm->n = ph->th_ncnt;
+	pm->k = 0;
+	pm->top = 1;
+	pm->cur = NULL;
+	pm->depth = 0;
+	pm->gen = ph->th_gen;
+	ph->th_cmp = pm;
+    }
+    stride = pm->chunk->tc_stride;
+
+    for (moved = 0; pm->k < pm->n && (nodes <= 0 || moved < nodes);) {
+	/* past the top levels, the rest in order from the leftmost node: */
+	if (pm->top == 1L << COMPACT_LEVELS) {
+	    pm->top = 0;
+	    for (pm->cur = ph->th_root, pm->depth = 0; pm->cur->tn_llink != NULL; pm->depth++)
+		pm->cur = pm->cur->tn_llink;
+	}
+	if (pm->top > 0) {
+	    /* the bits of top after its leading one go left (0) or right (1) from the root: */
+	    for (b = 1; 2 * b <= pm->top; b *= 2);
+	    for (p = ph->th_root, b /= 2; p != NULL && b > 0; b /= 2)
+		p = pm->top & b ? p->tn_rlink : p->tn_llink;
+	    pm->top++;
+	    if (p == NULL)
+		continue;
+	} else {
+	    /* the top nodes, moved already, are passed over: */
+	    while (pm->depth < COMPACT_LEVELS)
+		pm->cur = tnext(pm->cur, &pm->depth);
+	    p = pm->cur;
+	}
+	s = SLOT(pm->base, pm->k, stride);
+	tmove(ph, s, p);
+	if (pm->top == 0)
+	    pm->cur = tnext(s, &pm->depth);
+	pm->k++;
+	moved++;
+    }
+
+    /* the nodes are where they were no longer, for a cursor (see bst_equal_range): */
+    if (moved > 0)
+	pm->gen = ++ph->th_gen;
+    if (pm->k < pm->n)
+	return (pm->n - pm->k);
+
+    /* Every node is in the new chunk: what held them before goes back. */
+    for (pp = &ph->th_clist; *pp != pm->chunk; pp = &(*pp)->tc_link);
+    pc = *pp;
+    *pp = pc->tc_link;
+    tfreem(T_CHUNK, ph);
+    pc->tc_link = NULL;
+    ph->th_clist = pc;
+    tfreem(T_MAP, ph);
+    while ((pn = ph->th_flist) != EMPTY_LIST) {
+	ph->th_flist = pn->tn_ulink;
+	tfreem(T_NODE, FREE, ph, pn);
+    }
+    ph->th_flcnt = 0;
+    tslabtrim(ph);
+    tcmpfree(ph);
+    return (0);
+}
+
+/* bst_compact_auto: have bst_remove compact a tree once it is fragmented enough */
+Boolean bst_compact_auto(char *tname, double frag)
+{
+ /*******************************************************************************
+  *  A user acccessible function that sets the fragmentation of a tree, the
+  *  ms_frag of bst_mem_stats, at which bst_remove frees the memory the tree no
+  *  longer needs. Every COMPACT_CHECK removes, bst_remove works out the share
+  *  of the slots of the chunks and slabs of the tree not holding one of its
+  *  nodes. If it is frag or more, the slabs with no node in use are freed
+  *  first; if that does not bring it below frag, the whole tree is compacted
+  *  there and then by bst_compact, the remove taking time linear in the size
+  *  of the tree. Since a compacted tree must lose a frag share of its nodes to
+  *  be compacted again, the cost per remove is about 1/frag node moves.
+  *
+  *  Nodes the user holds from bst_alloc or bst_get count as not in the tree;
+  *  nodes malloc'd by themselves (see bst_huge_pages) are not counted at all.
+  *  A copy of the tree by bst_copy has the same setting.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *  frag       : Fragmentation, more than 0 and less than 1, to free memory
+  *               at; 0 never to (as a tree is created).
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree has the setting.
+  *  FALSE      : Tree not defined, or frag is not 0 up to 1.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+
+    extern t_header *find_header(char *);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    if (!(frag >= 0 && frag < 1)) {
+	bst_errno = BST_ERR_FRAG;
+	return (FALSE);
+    }
+    ph->th_frag = frag;
+    ph->th_rmcnt = 0;
+    return (TRUE);
+}
+
+/* tcmpauto: free what a tree no longer needs if it is past its th_frag, for bst_remove */
+void tcmpauto(t_header * ph)
+{
+ /*******************************************************************************
+  *  A private library function that bst_remove calls after each remove from a
+  *  tree with th_frag set; one call in COMPACT_CHECK looks at the tree, as
+  *  bst_compact_auto tells. A compaction that fails for want of memory is
+  *  given up, with bst_errno as it was.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record for this tree.
+  *
+  *  Output Parameters
+  *  =================
+  *  None.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Left as it was on entry.
+  *******************************************************************************/
+
+    long slots;
+    int err;
+
+    extern long tslots(t_header * ph);
+    extern long tslabtrim(t_header * ph);
+
+    if (++ph->th_rmcnt < COMPACT_CHECK)
+	return;
+    ph->th_rmcnt = 0;
+    if ((slots = tslots(ph)) == 0 || 1 - (double) ph->th_ncnt / slots < ph->th_frag)
+	return;
+    if (tslabtrim(ph) > 0 && ((slots = tslots(ph)) == 0 || 1 - (double) ph->th_ncnt / slots < ph->th_frag))
+	return;
+    err = bst_errno;
+    tcompact(ph, 0);
+    bst_errno = err;
+}
+
+/* tcmpfree: drop the compaction under way of a tree, if any */
+void tcmpfree(t_header * ph)
+{
+ /*******************************************************************************
+  *  A private library function for bst_compact and bst_delete. The nodes moved
+  *  so far stay where they are; their chunk goes with the others of the tree.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record for this tree.
+  *
+  *  Output Parameters
+  *  =================
+  *  None.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    extern void tmfree(t_header * ph, void *p);
+
+    tmfree(ph, ph->th_cmp);
+    ph->th_cmp = NULL;
+}
+
+/* tmove: move node p of a tree to slot s of a chunk and free p */
+static void tmove(t_header * ph, t_node * s, t_node * p)
+{
+    extern void tfreem(MallocTypes mkind, ...);
+
+    memcpy(s, p, sizeof(t_node) + p->tn_usiz);
+    s->tn_chunk = 1;
+    s->tn_slab = 0;
+    if (p->tn_ulink == NULL)
+	ph->th_root = s;
+    else if (p->tn_ulink->tn_llink == p)
+	p->tn_ulink->tn_llink = s;
+    else
+	p->tn_ulink->tn_rlink = s;
+    if (s->tn_llink != NULL)
+	s->tn_llink->tn_ulink = s;
+    if (s->tn_rlink != NULL)
+	s->tn_rlink->tn_ulink = s;
+    tfreem(T_NODE, CHAIN, ph, p);
+}
+
+/* tnext: the node after p in order, keeping depth, or NULL after the last */
+static t_node *tnext(t_node * p, int *depth)
+{
+    if (p->tn_rlink != NULL) {
+	for (p = p->tn_rlink, (*depth)++; p->tn_llink != NULL; p = p->tn_llink)
+	    (*depth)++;
+	return (p);
+    }
+    for (; p->tn_tag == RIGHT_SON; (*depth)--)
+	p = p->tn_ulink;
+    (*depth)--;
+    return (p->tn_ulink);
+}
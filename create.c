@@ -28,6 +28,8 @@ static char *RCSid[] = { "$Id: create.c,v 2.2 1999/01/18 03:49:23 roger Exp $" }
 extern t_header *t_head;
 extern int bst_errno;
 
+static Boolean tcreate(char *tname, BstType ttype, int leafsize, int fixedrec, int (*compf) (void *, void *),
+		       t_key * pk, void (*prntf) (void *, int), TreeVerifyType th_stat);
 
 /* bst_create: create a new tree header record returning true or false */
 Boolean bst_create(char *tname, BstType ttype, int leafsize, int fixedrec, int (*compf) (void *, void *),
@@ -53,6 +55,8 @@ Boolean bst_create(char *tname, BstType ttype, int leafsize, int fixedrec, int (
   *               No big deal if user passed NULL to it.
   *  th_stat    : After each bst_put() or bst_remove() should we check (i.e.
   *               verify) the tree balanced state? Meaninful for only AVL trees.
+  *               TREE_VERIFY_YES checks the whole tree, O(n) each time;
+  *               TREE_VERIFY_PATH only the path that changed, O(log n).
   *
   *  Output Parameters
   *  =================
@@ -66,14 +70,72 @@ Boolean bst_create(char *tname, BstType ttype, int leafsize, int fixedrec, int (
   *  bst_errno  : Global error variable; reset on entry.
   *******************************************************************************/
 
+    bst_errno = BST_ERR_RESET;
+
+    return (tcreate(tname, ttype, leafsize, fixedrec, compf, NULL, prntf, th_stat));
+}
+
+/* bst_create_key: create a new tree ordered by a built in key instead of a compare function */
+Boolean bst_create_key(char *tname, BstType ttype, int leafsize, int fixedrec, t_key * pk,
+		       void (*prntf) (void *, int), TreeVerifyType th_stat)
+{
+ /*******************************************************************************
+  *  A user acccessible function that creates a new AVL or BST search tree just
+  *  as bst_create does, except that the keys are ordered by the library itself
+  *  from a key descriptor instead of by a user written compare function. The
+  *  descent of find_node, bst_remove and the frozen searches then compare the
+  *  keys inline (see tkcmp) rather than through a call by pointer per level.
+  *
+  *  The descriptor gives the type of the key and its offset in the users data:
+  *    KEY_INT32, KEY_INT64 : signed int and long long, in numeric order.
+  *    KEY_UINT64           : unsigned long long, in numeric order.
+  *    KEY_DOUBLE           : double, in numeric order; there must be no NaNs.
+  *    KEY_MEMCMP           : tk_len bytes in memcmp order.
+  *    KEY_STRING           : a string of at most tk_len bytes in strncmp order.
+  *  The key need not be aligned.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the new tree to define.
+  *  ttype      : Type of bst to use: AVL or BST.
+  *  leafsize   : sizeof(Leaf) of the _user's_ data record.
+  *  fixedrec   : As for bst_create.
+  *  pk         : Key descriptor; copied, so it need not outlive the call.
+  *  prntf      : Pointer to user written print function, or NULL.
+  *  th_stat    : As for bst_create.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : A new tree was created.
+  *  FALSE      : Tree is already defined, bad key descriptor or malloc error.
+  *
+  *  Global Variables
+  *  =================
+  *  t_head     : A linked list of defined AVL trees.
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    bst_errno = BST_ERR_RESET;
+
+    if (pk == NULL) {
+	bst_errno = BST_ERR_KEY_DESC;
+	return (FALSE);
+    }
+    return (tcreate(tname, ttype, leafsize, fixedrec, NULL, pk, prntf, th_stat));
+}
+
+/* tcreate: check the arguments of bst_create or bst_create_key and create the tree */
+static Boolean tcreate(char *tname, BstType ttype, int leafsize, int fixedrec, int (*compf) (void *, void *),
+		       t_key * pk, void (*prntf) (void *, int), TreeVerifyType th_stat)
+{
     t_header *p;
+    int size;
 
     extern t_header *find_header(char *tname);
     extern void *tallocm(MallocTypes mkind, ...);
     extern double tid(void);
 
-    bst_errno = BST_ERR_RESET;
-
     /* Check if len of tree name is ok */
     if (strlen(tname) < MIN_TREE_NAME_LEN) {
 	bst_errno = BST_ERR_NAME_LEN;
@@ -97,17 +159,26 @@ Boolean bst_create(char *tname, BstType ttype, int leafsize, int fixedrec, int (
 	return (FALSE);
     }
 
-    /* check if a user written compare function is passed */
-    if (compf == NULL) {
-	bst_errno = BST_ERR_NO_UCF_GIVEN;
-	return (FALSE);
-    }
-
-    /* check if user written compare function is same as the user written */
-    /* print function (user written print function is optional)           */
-    if ((long) compf == (long) prntf) {
-	bst_errno = BST_ERR_UCF_EQUALS_UPF;
-	return (FALSE);
+    if (pk == NULL) {
+	/* check if a user written compare function is passed */
+	if (compf == NULL) {
+	    bst_errno = BST_ERR_NO_UCF_GIVEN;
+	    return (FALSE);
+	}
+
+	/* check if user written compare function is same as the user written */
+	/* print function (user written print function is optional)           */
+	if ((long) compf == (long) prntf) {
+	    bst_errno = BST_ERR_UCF_EQUALS_UPF;
+	    return (FALSE);
+	}
+    } else {
+	/* check the built in key lies inside the users data */
+	size = tksize(pk);
+	if (size <= 0 || pk->tk_offset < 0 || pk->tk_offset > leafsize - size) {
+	    bst_errno = BST_ERR_KEY_DESC;
+	    return (FALSE);
+	}
     }
 
     /* ok,  so create a new tree and check for malloc error */
@@ -121,11 +192,42 @@ Boolean bst_create(char *tname, BstType ttype, int leafsize, int fixedrec, int (
     p->th_bsttype = ttype;
     p->th_root = EMPTY_TREE;
     p->th_flist = EMPTY_LIST;
+    p->th_clist = EMPTY_LIST;
+    p->th_slab = NULL;
+    p->th_frz = NULL;
+    p->th_fidx = NULL;
+    p->th_map = NULL;
+    p->th_wal = NULL;
+    p->th_cmp = NULL;
+    p->th_gen = 0;
+    p->th_frag = 0;
+    p->th_rep = NULL;
+    p->th_numa = NUMA_LOCAL;
+    p->th_rmcnt = 0;
+    p->th_mlen = 0;
     p->th_id = tid();		/*  get unique id for this tree */
     p->th_flcnt = 0;
-    p->th_stat = (ttype == AVL && th_stat == TREE_VERIFY_YES) ? TRUE : FALSE;
+    p->th_frozen = FALSE;
+    p->th_var = FALSE;
+    p->th_multi = FALSE;
+    p->th_moff = 0;
+    p->th_mrel = FALSE;
+    p->th_stat = (ttype == AVL && (th_stat == TREE_VERIFY_YES || th_stat == TREE_VERIFY_PATH)) ? th_stat : TREE_VERIFY_NO;
     p->th_usiz = leafsize;
     p->th_ucf = (int (*)(void *, void *)) compf;	/* user compare two nodes function(Leaf1,Leaf2) */
+    if (pk != NULL)
+	p->th_key = *pk;
+    else {
+	p->th_key.tk_type = KEY_USER;
+	p->th_key.tk_offset = 0;
+	p->th_key.tk_len = 0;
+    }
+    p->th_pfxf = NULL;
+    p->th_kcf = NULL;
+    p->th_aggf = NULL;
+    p->th_aoff = 0;
+    p->th_asiz = 0;
+    p->th_pfx = FALSE;
     p->th_upf = (void (*)(void *, int)) prntf;	/* user print function given a node Leaf */
     p->th_ncnt = 0;
     p->th_np = fixedrec;
@@ -134,8 +236,10 @@ Boolean bst_create(char *tname, BstType ttype, int leafsize, int fixedrec, int (
     p->th_reserved2 = 0;
 
 #ifdef DEBUG_TRACE
-    if (p->th_stat == TRUE)
+    if (p->th_stat == TREE_VERIFY_YES)
 	printf("********** AVL TREE BALANCE VERIFICATION IS IN EFFECT **********\n");
+    else if (p->th_stat == TREE_VERIFY_PATH)
+	printf("********** AVL TREE PATH VERIFICATION IS IN EFFECT **********\n");
 #endif
 
     /* Insert new tree header record into linked list of defined AVL trees: */
@@ -106,6 +106,7 @@
  ************************************************************************/
 #ifdef DEBUG_EXPLOIT_TREE_HDR
 #define  MAX_ID_LEN          32	/* program version number */
+#define  SLAB_CLASSES        48	/* size classes of nodes smaller than th_usiz */
 /* included only for debugging or temp TODO on treewalk */
 #include "struct.h"
 typedef struct header t_header;
@@ -124,7 +125,7 @@ typedef enum { LEFT_SON, ROOT, RIGHT_SON } Tags;
 /* All user input commands are mapped to this enumeration */
 typedef enum { NEWT, DELT, SHOWT, ISEMPTY, COUNT, DEF, CKT, ADDK, FINDK,
     DELK, PRINT, RPRINT, QUIT, STOP, UNKNOWN, STATS, TWALK, TCOPY,
-    TIDENT, TEQUAL
+    TIDENT, TEQUAL, FREEZE, THAW
 } ValidCmd;
 
 const int rev_major = 1;
@@ -222,6 +223,7 @@ void display_screen(void)
     printf("\n");
 #endif
     printf("     copy\n");
+    printf("     freeze   thaw\n");
     printf("\n");
     printf("     tree inquiries        key inquiries\n");
     printf("     ===============       --------------\n");
@@ -287,6 +289,10 @@ ValidCmd get_cmd(void)
 	return (TIDENT);
     else if (strcmp("equal", cmd) == 0)
 	return (TEQUAL);
+    else if (strcmp("freeze", cmd) == 0)
+	return (FREEZE);
+    else if (strcmp("thaw", cmd) == 0)
+	return (THAW);
     else
 	return (UNKNOWN);
 }
@@ -321,6 +327,8 @@ int process_cmd(ValidCmd usrcmd)
     void tcopy(char *);			/* duplicate an existing tree */
     void tident(char *);		/* are two trees identical in structure */
     void tequal(char *);		/* are two trees equal */
+    void freeze_tree(char *);		/* make tree read only for faster finds */
+    void thaw_tree(char *);		/* make frozen tree changeable again */
 
     if (usrcmd == QUIT) {
 	/* traverse through all the trees freeing each node */
@@ -426,6 +434,12 @@ int process_cmd(ValidCmd usrcmd)
     case TEQUAL:
 	tequal(tn);
 	break;
+    case FREEZE:
+	freeze_tree(tn);
+	break;
+    case THAW:
+	thaw_tree(tn);
+	break;
     case UNKNOWN:
 	display_bad_cmd();
 	break;
@@ -512,6 +526,28 @@ void check_tree(char *tn)
 	printf("\n  --- verified  ---\n");
 }
 
+/* freeze_tree: lay the tree out read only for faster finds */
+void freeze_tree(char *tn)
+{
+    if (bst_freeze(tn))
+	printf("\n  --- Tree %s frozen; addk and delk fail until thaw ---\n", tn);
+    else {
+	display_err_msg();
+	printf("\n  ### Can't freeze tree %s ###\n", tn);
+    }
+}
+
+/* thaw_tree: make a frozen tree changeable again */
+void thaw_tree(char *tn)
+{
+    if (bst_thaw(tn))
+	printf("\n  --- Tree %s thawed ---\n", tn);
+    else {
+	display_err_msg();
+	printf("\n  ### Can't thaw tree %s ###\n", tn);
+    }
+}
+
 /* deltete_tree: delete all nodes and the tree definition itself */
 void delete_tree(char *tn)
 {
@@ -594,7 +630,7 @@ void add_key(char *tn, char *kn)
 	    printf("\n --- key added %s ---\n", kn);
 	else {
 	    display_err_msg();
-	    printf("\n ### duplicate key ###\n");
+	    printf("\n ### Can't add key %s ###\n", kn);
 	}
 	bst_release(tn, pk);
     } else {
@@ -784,7 +820,9 @@ void stat_tree(char *tn)
     printf("ph->th_flist      = (0x%-5x)\n", ph->th_flist);
     printf("ph->th_id         = %f\n", ph->th_id);
     printf("ph->th_flcnt      = %i\n", ph->th_flcnt);
-    printf("ph->th_stat       = %s\n", ph->th_stat == TRUE ? "TRUE" : "FALSE");
+    printf("ph->th_stat       = %s\n", ph->th_stat == TREE_VERIFY_YES ? "TREE_VERIFY_YES" :
+	   (ph->th_stat == TREE_VERIFY_PATH ? "TREE_VERIFY_PATH" : "TREE_VERIFY_NO"));
+    printf("ph->th_frozen     = %s\n", ph->th_frozen ? "TRUE" : "FALSE");
     printf("ph->th_np         = %s\n", ph->th_np == TRUE ? "TRUE" : "FALSE");
     printf("ph->th_usiz       = %i\n", ph->th_usiz);
     printf("ph->th_ucf        = (0x%-5x)\n", ph->th_ucf);
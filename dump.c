@@ -0,0 +1,328 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#include <stdio.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+static Boolean tsyncdir(char *path);
+
+
+/* bst_dump: write the leaves of a tree in order to a file that bst_restore reads back */
+Boolean bst_dump(char *tname, char *path)
+{
+ /*******************************************************************************
+  *  A user acccessible function that writes the leaves of a tree to path in
+  *  order, for bst_restore to build the tree again from them in one pass. Unlike
+  *  bst_save, no node headers or links are written, only a header of the tree
+  *  (struct dumpfile) and one record per leaf of its length and bytes, so the
+  *  file is about as large as the users data and does not depend on the node
+  *  layout. A checksum of the records closes the file. The writes go through a
+  *  buffer of DUMP_BUF bytes under path.tmp, which is then renamed to path.
+  *
+  *  The leaves are written as they are: pointers in them mean nothing to the
+  *  process that restores them. Key prefixes are kept only if they are of the
+  *  built in key, since a prefix function can not be written to a file.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree to dump.
+  *  path       : Name of the file to write.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree is in the file.
+  *  FALSE      : Tree not defined or the file could not be written.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    extern Boolean tdump(char *tname, char *path, Boolean durable);
+
+    return (tdump(tname, path, FALSE));
+}
+
+/* tdump: write the dump of bst_dump, if durable on the disk before it returns */
+Boolean tdump(char *tname, char *path, Boolean durable)
+{
+ /*******************************************************************************
+  *  A private library function that does the work of bst_dump and, durable,
+  *  of bst_checkpoint: path.tmp is synced before it is renamed to path, and the
+  *  directory of path after, so neither the leaves nor the rename can be lost
+  *  once it returns TRUE.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree to dump.
+  *  path       : Name of the file to write.
+  *  durable    : TRUE to sync the file and the rename to the disk.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree is in the file.
+  *  FALSE      : Tree not defined or the file could not be written or synced.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+    t_dumpfile d;
+    t_node *p;
+    char tmp[PATH_MAX];
+    FILE *fp;
+    unsigned long sum;
+    int err;
+
+    extern t_header *find_header(char *);
+    extern void tmaplinks(t_header * ph);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    tmaplinks(ph);
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int) sizeof(tmp) || (fp = fopen(tmp, "wb")) == NULL) {
+	bst_errno = BST_ERR_MAP_IO;
+	return (FALSE);
+    }
+    setvbuf(fp, NULL, _IOFBF, DUMP_BUF);
+
+    memset(&d, 0, sizeof(d));
+    memcpy(d.tdf_magic, DUMP_MAGIC, sizeof(d.tdf_magic));
+    d.tdf_version = DUMP_VERSION;
+    d.tdf_usiz = ph->th_usiz;
+    d.tdf_order = MAP_ORDER;
+    d.tdf_ncnt = ph->th_ncnt;
+    d.tdf_bsttype = ph->th_bsttype;
+    d.tdf_np = ph->th_np;
+    d.tdf_key = ph->th_key;
+    d.tdf_pfx = ph->th_pfx && ph->th_pfxf == NULL;
+    d.tdf_multi = ph->th_multi;
+    d.tdf_moff = ph->th_moff;
+    memcpy(d.tdf_version_id, ph->th_version_id, sizeof(d.tdf_version_id));
+    fwrite(&d, sizeof(d), 1, fp);
+
+    /* the leaves in order, walking the tree by its links: */
+    sum = SUM_BASIS;
+    if ((p = ph->th_root) != NULL)
+	while (p->tn_llink != NULL)
+	    p = p->tn_llink;
+    while (p != NULL) {
+	fwrite(&p->tn_usiz, sizeof(int), 1, fp);
+	fwrite(p + 1, p->tn_usiz, 1, fp);
+	sum = tsum(tsum(sum, &p->tn_usiz, sizeof(int)), p + 1, p->tn_usiz);
+	if (p->tn_rlink != NULL)
+	    for (p = p->tn_rlink; p->tn_llink != NULL; p = p->tn_llink);
+	else {
+	    while (p->tn_tag == RIGHT_SON)
+		p = p->tn_ulink;
+	    p = p->tn_ulink;
+	}
+    }
+    fwrite(&sum, sizeof(sum), 1, fp);
+
+    err = ferror(fp) || (durable && (fflush(fp) != 0 || fsync(fileno(fp)) != 0));
+    if (fclose(fp) != 0 || err || rename(tmp, path) != 0) {
+	unlink(tmp);
+	bst_errno = BST_ERR_MAP_IO;
+	return (FALSE);
+    }
+    if (durable && tsyncdir(path) == FALSE) {
+	bst_errno = BST_ERR_MAP_IO;
+	return (FALSE);
+    }
+    return (TRUE);
+}
+
+/* tsyncdir: sync the directory holding path, so a rename to path is on the disk */
+static Boolean tsyncdir(char *path)
+{
+    char dir[PATH_MAX];
+    char *slash;
+    int fd;
+    Boolean r;
+
+    if ((slash = strrchr(path, '/')) == NULL)
+	strcpy(dir, ".");
+    else if (slash == path)
+	strcpy(dir, "/");
+    else if (slash - path >= (int) sizeof(dir))
+	return (FALSE);
+    else {
+	memcpy(dir, path, slash - path);
+	dir[slash - path] = '\0';
+    }
+    if ((fd = open(dir, O_RDONLY)) < 0)
+	return (FALSE);
+    r = fsync(fd) == 0;
+    close(fd);
+    return (r);
+}
+
+/* bst_restore: define a tree as the leaves of a file of bst_dump */
+Boolean bst_restore(char *tname, char *path, int (*compf) (void *, void *), void (*prntf) (void *, int))
+{
+ /*******************************************************************************
+  *  A user acccessible function that defines the tree tname from a file of
+  *  bst_dump. The leaves come in order, so rather than bst_put each one, with
+  *  its search and rebalancing, they are read straight into one chunk of nodes
+  *  laid out as bst_freeze lays out a tree, and the chunk is linked as a
+  *  complete tree: a valid AVL tree of the least height, built in time linear
+  *  in the number of leaves. The tree is not frozen; bst_put and bst_remove
+  *  work on it at once. Every node has room for leafsize bytes, whatever the
+  *  length of its leaf.
+  *
+  *  Each leaf is checked to sort after the one before it, or with it in a
+  *  multimap (see bst_multimap), and the checksum of
+  *  the file is checked at the end; if either fails, or the file ends early,
+  *  the tree is deleted again and BST_ERR_DUMP_CORRUPT given. Compare and print
+  *  functions can not be kept in a file, so a tree ordered by a compare function
+  *  needs the same one again here; a tree created by bst_create_key needs none.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree to define.
+  *  path       : Name of the file of bst_dump.
+  *  compf      : Pointer to user written compare function, or NULL for a
+  *               tree with a built in key.
+  *  prntf      : Pointer to user written print function, or NULL.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree is defined with every leaf of the file.
+  *  FALSE      : Tree is already defined, bad tree name, no compare function,
+  *               malloc error, the file could not be read or is not a dump,
+  *               or the dump is corrupt; no tree is defined.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+    t_dumpfile d;
+    t_node *base, *p, *prev;
+    FILE *fp;
+    long n, i, k, stride;
+    unsigned long sum, fsum;
+    int len, var, err;
+
+    extern t_header *find_header(char *);
+    extern void *tallocm(MallocTypes mkind, ...);
+    extern long tfrznext(long k, long n);
+    extern void tfrzlink(t_node * base, long n, long stride);
+    extern void tsubcount(t_header * ph, t_node * root);
+    extern Boolean bst_create(char *, BstType, int, int, int (*)(void *, void *), void (*)(void *, int),
+			      TreeVerifyType);
+    extern Boolean bst_create_key(char *, BstType, int, int, t_key *, void (*)(void *, int), TreeVerifyType);
+    extern Boolean bst_delete(char *);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((fp = fopen(path, "rb")) == NULL) {
+	bst_errno = BST_ERR_MAP_IO;
+	return (FALSE);
+    }
+    setvbuf(fp, NULL, _IOFBF, DUMP_BUF);
+
+    /* The file must be one of bst_dump from a library of the same byte order: */
+    if (fread(&d, sizeof(d), 1, fp) != 1 || memcmp(d.tdf_magic, DUMP_MAGIC, sizeof(d.tdf_magic)) != 0
+	|| d.tdf_version != DUMP_VERSION || d.tdf_order != MAP_ORDER || d.tdf_ncnt < 0 || d.tdf_usiz <= 0
+	|| (d.tdf_multi && (d.tdf_moff < 0 || d.tdf_moff % sizeof(long) != 0 || d.tdf_moff > d.tdf_usiz - (int) sizeof(long)))) {
+	fclose(fp);
+	bst_errno = BST_ERR_MAP_FORMAT;
+	return (FALSE);
+    }
+    if (!(d.tdf_key.tk_type == KEY_USER
+	  ? bst_create(tname, d.tdf_bsttype, d.tdf_usiz, d.tdf_np, compf, prntf, TREE_VERIFY_NO)
+	  : bst_create_key(tname, d.tdf_bsttype, d.tdf_usiz, d.tdf_np, &d.tdf_key, prntf, TREE_VERIFY_NO))) {
+	fclose(fp);
+	return (FALSE);
+    }
+    ph = find_header(tname);
+    ph->th_pfx = KEY_PREFIX && d.tdf_pfx && ph->th_key.tk_type != KEY_USER;
+    ph->th_multi = d.tdf_multi;
+    ph->th_moff = d.tdf_moff;
+    base = NULL;
+    if ((n = d.tdf_ncnt) > 0 && (base = (t_node *) tallocm(T_CHUNK, ph, n)) == NULL) {
+	fclose(fp);
+	bst_delete(tname);
+	bst_errno = BST_ERR_MALLOC;
+	return (FALSE);
+    }
+
+    /* Read the leaves in order into the slots in order, as bst_freeze copies them: */
+    stride = n > 0 ? ph->th_clist->tc_stride : 0;
+    sum = SUM_BASIS;
+    var = FALSE;
+    prev = NULL;
+    for (k = 1; 2 * k <= n; k *= 2);
+    for (i = 0; i < n; i++, k = tfrznext(k, n)) {
+	p = SLOT(base, k - 1, stride);
+	if (fread(&len, sizeof(int), 1, fp) != 1 || len < 1 || len > ph->th_usiz || fread(p + 1, len, 1, fp) != 1
+	    || (ph->th_multi && len < ph->th_moff + (int) sizeof(long)))
+	    break;
+	sum = tsum(tsum(sum, &len, sizeof(int)), p + 1, len);
+	if (prev != NULL && !TINORDER(ph, prev + 1, p + 1))
+	    break;
+	p->tn_id = ph->th_id;
+	p->tn_usiz = len;
+	p->tn_rank = 0;
+	TNPFX_SET(p, ph->th_pfx ? TPFX(ph, p + 1) : 0);
+	var |= len < ph->th_usiz;
+	prev = p;
+    }
+    err = i < n || fread(&fsum, sizeof(fsum), 1, fp) != 1 || fsum != sum;
+    if (ferror(fp))
+	err = BST_ERR_MAP_IO;
+    fclose(fp);
+    if (err) {
+	bst_delete(tname);
+	bst_errno = err == BST_ERR_MAP_IO ? BST_ERR_MAP_IO : BST_ERR_DUMP_CORRUPT;
+	return (FALSE);
+    }
+
+    tfrzlink(base, n, stride);
+    if (ph->th_multi && n > 0)
+	tsubcount(ph, base);
+    ph->th_root = n > 0 ? base : EMPTY_TREE;
+    ph->th_ncnt = n;
+    ph->th_var = var;
+    return (TRUE);
+}
@@ -0,0 +1,183 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+static void *do_find_key(char *tname, const void *key);
+
+
+/* bst_key_compare: give a tree a compare of a bare key to a leaf for bst_find_key */
+Boolean bst_key_compare(char *tname, int (*kcf) (const void *, void *))
+{
+ /*******************************************************************************
+  *  A user acccessible function that gives a tree created by bst_create a
+  *  function comparing a key by itself, not in a leaf, to the users data area
+  *  of a node, so bst_find_key can search the tree by the key alone. kcf must
+  *  give the same order as the compare function of the tree: less than zero
+  *  if the key sorts before the leaf, zero if equal, else greater than zero.
+  *  A tree created by bst_create_key needs none; its built in key is used.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *  kcf        : Pointer to user written key compare function, or NULL.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree has kcf.
+  *  FALSE      : Tree not defined.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+
+    extern t_header *find_header(char *);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    ph->th_kcf = kcf;
+    return (TRUE);
+}
+
+/* bst_find_key: search by a bare key and return a copy of the node with it to user */
+void *bst_find_key(char *tname, const void *key)
+{
+ /*******************************************************************************
+  *  A user acccessible function that is bst_get given just a key rather than a
+  *  leaf holding it, so a lookup needs no bst_alloc'd leaf to fill in. For a
+  *  tree created by bst_create_key, key points to a value of the built in key
+  *  type (a KEY_STRING of up to tk_len characters); for any other tree to what
+  *  its bst_key_compare function takes. Where the tree keeps key prefixes (see
+  *  bst_key_prefix) from its built in key, they are compared first; prefixes
+  *  from a user function need a leaf and are not used. A frozen tree is searched
+  *  by the index of its slots, as bst_get does, with no links followed. Of the
+  *  nodes of a multimap with the key, the first put is returned.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of tree to search.
+  *  key        : The key to search for.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns pointer to a copy of the found node or NULL; the
+  *  copy is given back with bst_release as one from bst_get.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    void *r;
+    unsigned long t;
+
+    HIST_START(t);
+    r = do_find_key(tname, key);
+    HIST_STOP(H_GET, t);
+    return (r);
+}
+
+/* do_find_key: does the work of bst_find_key */
+static void *do_find_key(char *tname, const void *key)
+{
+    t_header *ph;
+    t_key *pk;
+    t_node *p, *pcopy, *found;
+    int cmpresult, pfx;
+    unsigned long ncmp, npfx, kp;
+    long k;
+    t_node *base;
+
+    extern int trepof(t_header * ph);
+    extern t_header *find_header(char *);
+    extern void *tallocm(MallocTypes mkind, ...);
+    extern void tcopym(t_header * ph, t_node * to, t_node * from);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (NULL);
+    }
+    pk = &ph->th_key;
+    if (pk->tk_type == KEY_USER && ph->th_kcf == NULL) {
+	bst_errno = BST_ERR_KEY_COMPARE;
+	return (NULL);
+    }
+    STAT_ADD(STATS(ph), st_get, 1);
+
+    /* as find_node, with the key compared to the built in key of a node or by th_kcf; */
+    /* the sons of slot k of a frozen tree are slots 2k and 2k+1, of the copy on the  */
+    /* NUMA node of this thread if there is one (see bst_numa). In a multimap a node  */
+    /* of the key is noted and the search goes on left for the first of them:         */
+    base = ph->th_frozen ? FBASE(ph, TREP(ph)) : NULL;
+    pfx = ph->th_pfx && ph->th_pfxf == NULL;
+    kp = pfx ? tkeypfx(pk, key) : 0;
+    ncmp = npfx = 0;
+    found = NULL;
+    for (p = ph->th_frozen ? base : ph->th_root, k = 1; p != NULL;) {
+	if (pfx && kp != TNPFX(p)) {
+	    npfx++;
+	    cmpresult = kp < TNPFX(p) ? -1 : 1;
+	} else {
+	    ncmp++;
+	    cmpresult = pk->tk_type == KEY_USER ? ph->th_kcf(key, p + 1) : tkeycmp(pk, key, (char *) (p + 1) + pk->tk_offset);
+	}
+	if (cmpresult == 0) {
+	    found = p;
+	    if (!ph->th_multi)
+		break;
+	}
+	if (ph->th_frozen)
+	    p = (k = 2 * k + (cmpresult > 0)) <= ph->th_ncnt ? FSLOTB(ph, base, k) : NULL;
+	else
+	    p = cmpresult <= 0 ? p->tn_llink : p->tn_rlink;
+    }
+    STAT_ADD(STATS(ph), st_cmp, ncmp);
+    STAT_ADD(STATS(ph), st_pfx, npfx);
+    if ((p = found) == NULL) {
+	bst_errno = BST_ERR_KEY_NOT_FOUND;
+	return (NULL);
+    }
+
+    /* make copy of found node to return to user */
+    if ((pcopy = (t_node *) tallocm(T_NODE, ph, p->tn_usiz)) == NULL) {
+	bst_errno = BST_ERR_MALLOC;
+	return (NULL);
+    }
+    tcopym(ph, pcopy, p);
+
+    return (pcopy + 1);		/* point from header part to users data area */
+}
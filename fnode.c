@@ -29,18 +29,20 @@ extern int bst_errno;
 
 
 /* find_node: search the tree for the given node */
-t_node *find_node(t_node * treeroot, void *keyrecord, int (*th_ucf) (void *, void *), t_node ** a, t_node ** f, t_node ** q)
+t_node *find_node(t_header * ph, void *keyrecord, t_node ** a, t_node ** f, t_node ** q)
 {
  /*******************************************************************************
   *  An internal library function that finds and returns the desired node in the tree.
+  *  In a multimap (see bst_multimap) a node of an equal key is passed on the right,
+  *  so the search goes on to where a new node goes after all of them; the last one
+  *  met is returned. tedge finds the first of them.
   *
   *  Input Parameters
   *  =================
-  *  treeroot   : Pointer to the root (t_node) of the AVL tree to search.
-  *               (Found by function find_header which passes the root)
+  *  ph         : Pointer to the header record of the tree to search; its root
+  *               and user written compare function are used, and the compare
+  *               calls made are added to its counters.
   *  keyrecord  : Target key to find in the AVL tree. Structure def. unknown.
-  *  th_ucf     : Pointer to the user written compare function used to make
-  *               the comparisions for this tree.(From find_header).
   *
   *  Output Parameters
   *  =================
@@ -58,12 +60,16 @@ t_node *find_node(t_node * treeroot, void *keyrecord, int (*th_ucf) (void *, voi
   *******************************************************************************/
 
     int cmpresult;
-    t_node *p;
+    unsigned long ncmp, npfx, kp;
+    t_node *p, *found;
 
     *f = NULL;			/* f is pointer to father of a */
-    p = treeroot;		/* p leads the way thru tree */
+    p = ph->th_root;		/* p leads the way thru tree */
     *q = NULL;			/* q follows p around */
-    *a = treeroot;		/* a is pointer to last node with bf + or - 1 */
+    *a = ph->th_root;		/* a is pointer to last node with bf + or - 1 */
+    ncmp = npfx = 0;		/* compare calls made, compares the key prefixes decided */
+    kp = ph->th_pfx ? TPFX(ph, keyrecord) : 0;
+    found = NULL;
 
     /* scan down through the tree searching for the desired key while making */
     /* note of where the last node with a balance factor of +1 or -1 is,     */
@@ -74,7 +80,7 @@ t_node *find_node(t_node * treeroot, void *keyrecord, int (*th_ucf) (void *, voi
 	    *a = p;		/* last node with bf = + or - 1 */
 	    *f = *q;		/* f is the parent node of a */
 	}
-	cmpresult = th_ucf(keyrecord, p + 1);	/* make key comparison call */
+	cmpresult = tpcmp(ph, kp, keyrecord, p, &ncmp, &npfx);	/* make key comparison call */
 
 	if (cmpresult < 0) {	/* move down through left subtree */
 	    *q = p;
@@ -82,11 +88,20 @@ t_node *find_node(t_node * treeroot, void *keyrecord, int (*th_ucf) (void *, voi
 	} else if (cmpresult > 0) {	/* move down through right subtree */
 	    *q = p;
 	    p = p->tn_rlink;
-	} else			/* found it */
+	} else if (ph->th_multi) {	/* found one; on past it */
+	    found = *q = p;
+	    p = p->tn_rlink;
+	} else {		/* found it */
+	    STAT_ADD(STATS(ph), st_cmp, ncmp);
+	    STAT_ADD(STATS(ph), st_pfx, npfx);
 	    return p;		/* p points the header part of the node */
+	}
     }
 
-    bst_errno = BST_ERR_KEY_NOT_FOUND;
+    STAT_ADD(STATS(ph), st_cmp, ncmp);
+    STAT_ADD(STATS(ph), st_pfx, npfx);
+    if (found == NULL)
+	bst_errno = BST_ERR_KEY_NOT_FOUND;
 
-    return (NULL);		/* key not in tree */
+    return (found);		/* key not in tree, or the last of a multimap */
 }
@@ -0,0 +1,538 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+#include <limits.h>
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+/* son i (0..FRZ_KEYS) of block b of a frozen key index; the root block is 0 */
+#define  FSON(b, i)    ((b) * (FRZ_KEYS + 1) + (i) + 1)
+
+/* flipping the sign bit orders unsigned keys as signed ones, which SIMD compares */
+#define  FSIGN         (1UL << 63)
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+static int fheight(long k, long n);
+static void fbnext(long *b, int *j, long nblocks);
+static t_node *tfrzkey(t_header * ph, void *keyrecord, unsigned long *ncmp);
+static int fblock(long *keys, long x);
+
+
+/* bst_freeze: lay a tree out read only in one chunk of nodes in breadth first order */
+Boolean bst_freeze(char *tname)
+{
+ /*******************************************************************************
+  *  A user acccessible function for trees that are built once and then only
+  *  read. The nodes of the tree are copied into a single chunk of th_ncnt nodes
+  *  as a complete binary tree in breadth first (Eytzinger) order: the root in
+  *  slot 1, the sons of slot k in slots 2k and 2k+1. The in order sequence of
+  *  the keys is kept, so the new tree holds the same keys; its height is the
+  *  least possible, which is also a valid AVL tree. The old nodes and chunks
+  *  are freed; old nodes of bst_alloc_size go back to their size class. Every
+  *  slot has room for leafsize bytes, whatever the size of the node in it.
+  *
+  *  The links, tags and balance factors of every node are set as usual, so
+  *  bst_print, bst_copy, bst_equal, bst_verify and the rest work unchanged.
+  *  The aggregates of a tree that has them (see bst_aggregate) are made again
+  *  for the new shape.
+  *  bst_get on a frozen tree searches the slots by index (see tfrzfind), with
+  *  no pointer loads and a prefetch of the grandsons. bst_put and bst_remove
+  *  fail with BST_ERR_TREE_FROZEN until bst_thaw. Freezing a frozen tree does
+  *  nothing.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree to freeze.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree is frozen.
+  *  FALSE      : Tree not defined or malloc error; the tree is left as it was.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    long n, k, i, stride;
+    t_node *p, *next, *base;
+    t_chunk *pc;
+    t_header *ph;
+
+    extern t_header *find_header(char *);
+    extern void *tallocm(MallocTypes mkind, ...);
+    extern void tfreem(MallocTypes mkind, ...);
+    extern long tfrznext(long k, long n);
+    extern void tfrzlink(t_node * base, long n, long stride);
+    extern void trepmake(t_header * ph);
+    extern void tsubcount(t_header * ph, t_node * root);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    if (ph->th_frozen)
+	return (TRUE);
+    if ((n = ph->th_ncnt) == 0) {
+	ph->th_frozen = TRUE;
+	return (TRUE);
+    }
+
+    /* The new chunk goes to the head of th_clist; the chunks after it are the old ones: */
+    if ((base = (t_node *) tallocm(T_CHUNK, ph, n)) == NULL)
+	return (FALSE);
+    stride = ph->th_clist->tc_stride;
+
+    /* Walk the tree in order and the slots in order together, copying node to slot: */
+    for (p = ph->th_root; p->tn_llink != NULL; p = p->tn_llink);
+    for (k = 1; 2 * k <= n; k *= 2);
+    for (i = 0; i < n; i++) {
+	memcpy(SLOT(base, k - 1, stride), p, sizeof(t_node) + p->tn_usiz);
+
+	/* next node in order: leftmost of the right subtree, else up past right sons */
+	if (p->tn_rlink != NULL)
+	    for (p = p->tn_rlink; p->tn_llink != NULL; p = p->tn_llink);
+	else {
+	    for (next = p; next->tn_tag == RIGHT_SON; next = next->tn_ulink);
+	    p = next->tn_ulink;
+	}
+
+	/* next slot in order: the same walk by index */
+	k = tfrznext(k, n);
+    }
+
+    tfrzlink(base, n, stride);
+    if (ph->th_multi || ph->th_aggf != NULL)
+	tsubcount(ph, base);
+
+    /* Free the old nodes, sons first, cutting each link as it is followed; then the old */
+    /* chunks behind the new one: no chunk node is ever on th_flist or handed out, so   */
+    /* nothing else points into them:                                                  */
+    for (p = ph->th_root; p != NULL;)
+	if ((next = p->tn_llink) != NULL || (next = p->tn_rlink) != NULL) {
+	    if (next == p->tn_llink)
+		p->tn_llink = NULL;
+	    else
+		p->tn_rlink = NULL;
+	    p = next;
+	} else {
+	    next = p->tn_ulink;
+	    tfreem(T_NODE, CHAIN, ph, p);
+	    p = next;
+	}
+    pc = ph->th_clist;
+    ph->th_clist = pc->tc_link;
+    tfreem(T_CHUNK, ph);
+    pc->tc_link = NULL;
+    ph->th_clist = pc;
+
+    ph->th_root = base;
+    ph->th_frz = base;
+    ph->th_frozen = TRUE;
+    ph->th_gen++;
+    trepmake(ph);
+    return (TRUE);
+}
+
+/* bst_thaw: make a frozen tree changeable again */
+Boolean bst_thaw(char *tname)
+{
+ /*******************************************************************************
+  *  A user acccessible function that lets bst_put and bst_remove change a tree
+  *  frozen by bst_freeze. The frozen layout is already a valid AVL tree, so the
+  *  nodes stay where they are; only bst_get goes back to following the links.
+  *  Nodes inserted from now on are allocated one by one as usual. The key index
+  *  of bst_freeze_keys, if any, is freed. Thawing a tree that is not frozen does
+  *  nothing.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree to thaw.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree can be changed.
+  *  FALSE      : Tree not defined.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+
+    extern t_header *find_header(char *);
+    extern void tmaplinks(t_header * ph);
+    extern void tfreem(MallocTypes mkind, ...);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    tmaplinks(ph);
+    tfreem(T_FRZIDX, ph);
+    ph->th_frz = NULL;
+    ph->th_frozen = FALSE;
+    return (TRUE);
+}
+
+/* bst_freeze_keys: freeze a tree and index its fixed width keys in blocks of a cache line */
+Boolean bst_freeze_keys(char *tname, unsigned long (*keyf) (void *))
+{
+ /*******************************************************************************
+  *  A user acccessible function for frozen trees whose keys are, or begin with,
+  *  a fixed width integer: keyf gives it as an unsigned long, e.g. the key
+  *  itself or the first 8 bytes of a string key read big endian. It must keep
+  *  the order of the compare function: keyf(a) < keyf(b) only if a sorts before
+  *  b. Different keys may share one keyf value (a common prefix).
+  *
+  *  The tree is frozen as by bst_freeze, then the keyf values are laid out as
+  *  an implicit B-tree of FRZ_KEYS keys per 64 byte block, block b having its
+  *  FRZ_KEYS + 1 sons in blocks b * (FRZ_KEYS + 1) + 1 on, in order, with the
+  *  node of each key beside it. bst_get then goes down the blocks picking
+  *  the son by counting the keys of a block below the search key in one go
+  *  (AVX2 or SSE4.2 compare and movemask when the library is built with them,
+  *  see LIB_SIMD in the Makefile, else a branch free loop): a cache line per
+  *  level and about log(n)/3 levels instead of log(n). The compare function is
+  *  called only on the nodes sharing the found keyf value, mostly once.
+  *
+  *  Calling it again on a frozen tree rebuilds the index with the new keyf; a
+  *  NULL keyf drops it. bst_thaw frees it.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree to freeze and index.
+  *  keyf       : Function giving the fixed width key of a users data area.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree is frozen and indexed.
+  *  FALSE      : Tree not defined or malloc error; if the tree could be frozen
+  *               it is left frozen without an index.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    long n, k, r, b, nblocks;
+    int j;
+    t_node *p;
+    t_header *ph;
+    t_frzidx *pf;
+
+    extern t_header *find_header(char *);
+    extern void tmaplinks(t_header * ph);
+    extern void *tallocm(MallocTypes mkind, ...);
+    extern void tfreem(MallocTypes mkind, ...);
+    extern long tfrznext(long k, long n);
+    extern void trepmake(t_header * ph);
+
+    if (bst_freeze(tname) == FALSE)
+	return (FALSE);
+    ph = find_header(tname);
+    tmaplinks(ph);
+    tfreem(T_FRZIDX, ph);
+    if (keyf == NULL || (n = ph->th_ncnt) == 0)
+	return (TRUE);
+
+    nblocks = (n + FRZ_KEYS - 1) / FRZ_KEYS;
+    if ((pf = (t_frzidx *) tallocm(T_FRZIDX, ph, nblocks)) == NULL)
+	return (FALSE);
+    pf->tf_keyf = keyf;
+
+    /* Fill the blocks in order from the slots in order, the last ones padded with the highest key: */
+    for (k = 1; 2 * k <= n; k *= 2);
+    for (b = 0; FSON(b, 0) < nblocks; b = FSON(b, 0));
+    for (r = 0, j = 0; r < nblocks * FRZ_KEYS; r++, fbnext(&b, &j, nblocks))
+	if (r < n) {
+	    p = FSLOT(ph, k);
+	    pf->tf_keys[b * FRZ_KEYS + j] = (long) (keyf(p + 1) ^ FSIGN);
+	    pf->tf_node[b * FRZ_KEYS + j] = p;
+	    k = tfrznext(k, n);
+	} else {
+	    pf->tf_keys[b * FRZ_KEYS + j] = LONG_MAX;
+	    pf->tf_node[b * FRZ_KEYS + j] = NULL;
+	}
+
+    ph->th_fidx = pf;
+    trepmake(ph);
+    return (TRUE);
+}
+
+/* tfrzfind: search a frozen tree for a key by slot index */
+t_node *tfrzfind(t_header * ph, void *keyrecord, unsigned long *ncmp, unsigned long *npfx)
+{
+ /*******************************************************************************
+  *  A private library function that searches the frozen layout of a tree with
+  *  no branch on the result of a compare: at slot k it goes to slot 2k if the
+  *  key is not above the node there, else to 2k+1, until it falls off the
+  *  bottom. The last slot it went left at holds the least key not below the
+  *  search key; dropping the trailing right turns (1 bits) and that one left
+  *  turn from k gives it back. One more compare tells if it is the key. The 4
+  *  grandsons of each slot, the slots 2 levels down, are prefetched while the
+  *  compare at the slot runs. Where the tree keeps key prefixes (see
+  *  bst_key_prefix) a compare is of those first. A tree with a key index (see
+  *  bst_freeze_keys) is searched by it instead.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record of a frozen tree.
+  *  keyrecord  : Users data area with the key to find.
+  *  ncmp       : Compare function calls made are added here.
+  *  npfx       : Compares decided by the key prefixes are added here.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns the node with the key or NULL if not found.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    long n, k;
+    unsigned long cmps, pfxs, kp;
+    t_node *base;
+
+    extern int trepof(t_header * ph);
+
+    if (ph->th_fidx != NULL)
+	return (tfrzkey(ph, keyrecord, ncmp));
+
+    /* slots of the copy on the NUMA node of this thread, if there is one: */
+    base = FBASE(ph, TREP(ph));
+    n = ph->th_ncnt;
+    kp = ph->th_pfx ? TPFX(ph, keyrecord) : 0;
+    for (k = 1, cmps = pfxs = 0; k <= n;) {
+	if (4 * k <= n) {
+	    PREFETCH(FSLOTB(ph, base, 4 * k));
+	    PREFETCH(FSLOTB(ph, base, 4 * k + 1));
+	    PREFETCH(FSLOTB(ph, base, 4 * k + 2));
+	    PREFETCH(FSLOTB(ph, base, 4 * k + 3));
+	}
+	k = 2 * k + (tpcmp(ph, kp, keyrecord, FSLOTB(ph, base, k), &cmps, &pfxs) > 0);
+    }
+#ifdef __GNUC__
+    k >>= __builtin_ffsl(~k);
+#else
+    while (k & 1)
+	k >>= 1;
+    k >>= 1;
+#endif
+    k = k == 0 || tpcmp(ph, kp, keyrecord, FSLOTB(ph, base, k), &cmps, &pfxs) != 0 ? 0 : k;
+    *ncmp += cmps;
+    *npfx += pfxs;
+    return (k == 0 ? NULL : FSLOTB(ph, base, k));
+}
+
+/* tfrzkey: search the key index of a frozen tree */
+static t_node *tfrzkey(t_header * ph, void *keyrecord, unsigned long *ncmp)
+{
+ /*******************************************************************************
+  *  A private local function that goes down the blocks of the key index from
+  *  block 0. In each block the number i of keys below the search key is the
+  *  son to go to; the key at i, if not padding past the end of the block, is
+  *  the least key not below the search key in that subtree, so the last one
+  *  seen is the least in the index. From its node on, the nodes in order with
+  *  the same keyf value are compared until the key is found or passed; a node
+  *  with a higher keyf value sorts after the key anyway.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record of a frozen tree with a key index.
+  *  keyrecord  : Users data area with the key to find.
+  *  ncmp       : Compare function calls made are added here.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns the node with the key or NULL if not found.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    long b, slot, *keys;
+    int i, r, cmpresult;
+    unsigned long u;
+    t_node *p, *next;
+    t_frzidx *pf;
+
+    extern int trepof(t_header * ph);
+
+    /* the keys of the copy on the NUMA node of this thread, if there is one, and its node of the key: */
+    pf = ph->th_fidx;
+    keys = (r = TREP(ph)) < 0 ? pf->tf_keys : ph->th_rep->tr_keys[r];
+    u = pf->tf_keyf(keyrecord);
+    for (b = 0, slot = -1; b < pf->tf_nblocks; b = FSON(b, i))
+	if ((i = fblock(keys + b * FRZ_KEYS, (long) (u ^ FSIGN))) < FRZ_KEYS)
+	    slot = b * FRZ_KEYS + i;
+    p = slot < 0 ? NULL : pf->tf_node[slot];
+    if (p != NULL && r >= 0)
+	p = (t_node *) ((char *) FBASE(ph, r) + ((char *) p - (char *) ph->th_frz));
+
+    while (p != NULL) {
+	(*ncmp)++;
+	if ((cmpresult = TCMP(ph, keyrecord, p + 1)) <= 0)
+	    return (cmpresult == 0 ? p : NULL);
+
+	/* next node in order, if it shares the keyf value */
+	if (p->tn_rlink != NULL)
+	    for (p = p->tn_rlink; p->tn_llink != NULL; p = p->tn_llink);
+	else {
+	    for (next = p; next->tn_tag == RIGHT_SON; next = next->tn_ulink);
+	    p = next->tn_ulink;
+	}
+	if (p != NULL && pf->tf_keyf(p + 1) != u)
+	    p = NULL;
+    }
+    return (NULL);
+}
+
+/* fblock: number of the FRZ_KEYS sorted keys of a block below x */
+static int fblock(long *keys, long x)
+{
+#if defined(__AVX2__)
+    __m256i vx;
+    int m;
+
+    vx = _mm256_set1_epi64x(x);
+    m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(vx, _mm256_load_si256((__m256i *) keys))))
+	| _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(vx, _mm256_load_si256((__m256i *) (keys + 4))))) << 4;
+    return (__builtin_popcount(m));
+#elif defined(__SSE4_2__)
+    __m128i vx;
+    int m;
+
+    vx = _mm_set1_epi64x(x);
+    m = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(vx, _mm_load_si128((__m128i *) keys))))
+	| _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(vx, _mm_load_si128((__m128i *) (keys + 2))))) << 2
+	| _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(vx, _mm_load_si128((__m128i *) (keys + 4))))) << 4
+	| _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(vx, _mm_load_si128((__m128i *) (keys + 6))))) << 6;
+    return (__builtin_popcount(m));
+#else
+    int i, cnt;
+
+    for (i = 0, cnt = 0; i < FRZ_KEYS; i++)
+	cnt += keys[i] < x;
+    return (cnt);
+#endif
+}
+
+/* tfrzlink: link slots 1..n of a chunk at base as a complete tree in breadth first order */
+void tfrzlink(t_node * base, long n, long stride)
+{
+ /*******************************************************************************
+  *  A private library function that sets the links, tags and balance factors
+  *  of the n nodes of a chunk filled in order of tfrznext, making slot 1 the
+  *  root and slots 2k and 2k+1 the sons of slot k, for bst_freeze and for
+  *  bst_restore. Each node is marked as one of a chunk; the subtree counts of a
+  *  multimap and the aggregates are left to tsubcount.
+  *
+  *  Input Parameters
+  *  =================
+  *  base       : Pointer to slot 1.
+  *  n          : Number of slots.
+  *  stride     : Bytes from one slot to the next.
+  *
+  *  Output Parameters
+  *  =================
+  *  None.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    long k;
+    t_node *d;
+
+    for (k = 1; k <= n; k++) {
+	d = SLOT(base, k - 1, stride);
+	d->tn_chunk = 1;
+	d->tn_slab = 0;
+	d->tn_ulink = k > 1 ? SLOT(base, k / 2 - 1, stride) : NULL;
+	d->tn_llink = 2 * k <= n ? SLOT(base, 2 * k - 1, stride) : NULL;
+	d->tn_rlink = 2 * k + 1 <= n ? SLOT(base, 2 * k, stride) : NULL;
+	d->tn_tag = k == 1 ? ROOT : (k & 1) ? RIGHT_SON : LEFT_SON;
+	d->tn_bf = fheight(2 * k, n) - fheight(2 * k + 1, n);
+    }
+}
+
+/* tfrznext: slot after slot k in order in a complete tree of n slots; 0 after the last */
+long tfrznext(long k, long n)
+{
+    if (2 * k + 1 <= n)
+	for (k = 2 * k + 1; 2 * k <= n; k *= 2);
+    else {
+	while (k & 1)
+	    k >>= 1;
+	k >>= 1;
+    }
+    return (k);
+}
+
+/* fbnext: key after key j of block b in order in a key index of nblocks blocks */
+static void fbnext(long *b, int *j, long nblocks)
+{
+    long i;
+
+    /* leftmost key of the subtree right of key j, if there is one: */
+    if (FSON(*b, *j + 1) < nblocks) {
+	for (*b = FSON(*b, *j + 1); FSON(*b, 0) < nblocks; *b = FSON(*b, 0));
+	*j = 0;
+    } else if (++*j == FRZ_KEYS) {
+	/* else up to the first block this one is left of a key in */
+	for (; *b != 0; *b = (*b - 1) / (FRZ_KEYS + 1))
+	    if ((i = (*b - 1) % (FRZ_KEYS + 1)) < FRZ_KEYS) {
+		*b = (*b - 1) / (FRZ_KEYS + 1);
+		*j = (int) i;
+		return;
+	    }
+    }
+}
+
+/* fheight: height of the subtree at slot k of a complete tree of n slots; 0 if none */
+static int fheight(long k, long n)
+{
+    int h;
+
+    /* the leftmost path is the longest since the bottom level fills from the left */
+    for (h = 0; k <= n; k *= 2)
+	h++;
+    return (h);
+}
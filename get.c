@@ -27,8 +27,13 @@ static char *RCSid[] = { "$Id: get.c,v 2.2 1999/01/18 03:41:38 roger Exp $" };
 
 extern int bst_errno;
 extern t_header *find_header(char *);
-extern t_node *find_node(t_node *, void *, int (*)(), t_node **, t_node **, t_node **);
+extern t_node *find_node(t_header *, void *, t_node **, t_node **, t_node **);
+extern t_node *tfrzfind(t_header *, void *, unsigned long *, unsigned long *);
+extern t_node *tedge(t_header *, void *, Boolean);
 extern void *tallocm(MallocTypes mkind, ...);
+extern void tcopym(t_header * ph, t_node * to, t_node * from);
+
+static void *do_get(char *tname, void *kname);
 
 
 /* bst_get: search and return a copy of the node with specified key to user */
@@ -43,6 +48,7 @@ void *bst_get(char *tname, void *kname)
   *  Upon exit, if found, bst_get is pointing to the users data area
   *  which is of type t_node, which will then be cast to the proper
   *  type by the user in the assignment statement: leafptr = bst_get(...)
+  *  Of the nodes of a multimap with the key, the first put is returned.
   *
   *  Input Parameters
   *  =================
@@ -58,8 +64,21 @@ void *bst_get(char *tname, void *kname)
   *  bst_errno  : Global error variable; reset on entry.
   *******************************************************************************/
 
+    void *r;
+    unsigned long t;
+
+    HIST_START(t);
+    r = do_get(tname, kname);
+    HIST_STOP(H_GET, t);
+    return (r);
+}
+
+/* do_get: does the work of bst_get */
+static void *do_get(char *tname, void *kname)
+{
     t_header *ph;
     t_node *a, *f, *q, *pn, *pcopy;
+    unsigned long ncmp, npfx;
 
 
     bst_errno = BST_ERR_RESET;
@@ -69,6 +88,7 @@ void *bst_get(char *tname, void *kname)
 	bst_errno = BST_ERR_TREE_NOT_DEFINED;
 	return (NULL);		/* tree not defined */
     }
+    STAT_ADD(STATS(ph), st_get, 1);
 
     /* cast pointer from users data part to header node part of node */
     pn = ((t_node *) kname) - 1;	/* cast pointer from leaf type to header type */
@@ -79,22 +99,27 @@ void *bst_get(char *tname, void *kname)
 	return (NULL);
     }
 
-    /* find the node in the tree returning a pointer to it */
-    if ((pn = find_node(ph->th_root, kname, ph->th_ucf, &a, &f, &q)) == NULL) {
+    /* find the node in the tree returning a pointer to it; by index if it is frozen */
+    if (ph->th_frozen) {
+	ncmp = npfx = 0;
+	pn = tfrzfind(ph, kname, &ncmp, &npfx);
+	STAT_ADD(STATS(ph), st_cmp, ncmp);
+	STAT_ADD(STATS(ph), st_pfx, npfx);
+    } else if (ph->th_multi)
+	pn = tedge(ph, kname, FALSE);	/* the first of equal keys */
+    else
+	pn = find_node(ph, kname, &a, &f, &q);
+    if (pn == NULL) {
 	bst_errno = BST_ERR_KEY_NOT_FOUND;
 	return (NULL);
     }
 
     /* make copy of found node to return to user */
-    if ((pcopy = (t_node *) tallocm(T_NODE, ph)) == NULL) {
+    if ((pcopy = (t_node *) tallocm(T_NODE, ph, pn->tn_usiz)) == NULL) {
 	bst_errno = BST_ERR_MALLOC;
 	return (NULL);
     }
-    memcpy(pcopy, pn, sizeof(t_node) + ph->th_usiz);
-
-#ifdef DEBUG_MALLAC_USAGE
-    printf(">>> memcpy FROM LOCATION 0x%-5x TO LOCATION 0x%-5x; %i BYTES <<<\n", pn, pcopy, sizeof(t_node) + ph->th_usiz);
-#endif
+    tcopym(ph, pcopy, pn);
 
     return (pcopy + 1);		/* point from header part to users data area */
 }
@@ -29,6 +29,11 @@
   *  bst_errno : This global varible contains the last error number that occured
   *              in the routines
   *  t_head    : This global variable points to the head of defined bst tree
+  *  thist_on  : TRUE while the public calls are timed (see bst_stats_timing)
+  *  thuge_on  : TRUE while nodes of th_usiz bytes come from slabs that grow into
+  *              huge pages (see bst_huge_pages)
+  *  talloc_def: The allocator of the trees defined from now on; all NULL for
+  *              malloc and free (see bst_allocator)
   *******************************************************************************/
 
 #ifndef BST_HDR
@@ -37,6 +42,9 @@
 
 t_header *t_head = NULL;	/* global list of defined bst trees */
 int bst_errno = BST_ERR_RESET;	/* global error var of last user op */
+Boolean thist_on = FALSE;	/* time the public calls into histograms */
+Boolean thuge_on = TRUE;	/* slab the full sized nodes, in huge pages as they grow */
+t_alloc talloc_def = { NULL, NULL, NULL, NULL, NULL };	/* allocator of new trees: malloc */
 
 static char *RCSid[] = { "$Id: globals.c,v 1.5 1999/01/18 04:33:02 roger Exp roger $" };
 
@@ -0,0 +1,259 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define  TICKS_UNIT  "cycles"	/* time stamp counter */
+#else
+#include <time.h>
+#define  TICKS_UNIT  "ns"	/* monotonic clock */
+#endif
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+/* latency histogram of one public call */
+typedef struct {
+    unsigned long count;	/* calls timed */
+    unsigned long sum;		/* ticks of all calls */
+    unsigned long min, max;	/* fastest and slowest call */
+    unsigned long bucket[HIST_BUCKETS];	/* calls per log bucket, see hbucket */
+} h_hist;
+
+static h_hist hists[HIST_OPS];
+static char *hnames[HIST_OPS] = { "put", "get", "remove", "copy", "equal" };
+
+/* names of the BstStats counters in the order they are declared */
+static char *snames[] = { "put", "get", "remove", "cmp", "pfx", "ll", "lr", "rr", "rl", "rmll", "rmlr", "rmrr", "rmrl",
+    "flist", "malloc", "chain", "free"
+};
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+static int hbucket(unsigned long v);
+static unsigned long hvalue(int i);
+static unsigned long hpercentile(h_hist * h, double q);
+
+
+/* bst_stats_timing: turn the latency histograms of the public calls on or off */
+void bst_stats_timing(Boolean on)
+{
+ /*******************************************************************************
+  *  A user acccessible function that starts or stops timing bst_put, bst_get,
+  *  bst_remove, bst_copy and bst_equal. While on, each call reads the time stamp
+  *  counter (the monotonic clock where there is none) going in and coming out
+  *  and adds the difference to a histogram for that call, for every tree. Turning
+  *  timing on clears the histograms. While off, a call pays one test of
+  *  thist_on. See bst_stats_dump to read them out.
+  *
+  *  Input Parameters
+  *  =================
+  *  on         : TRUE to clear the histograms and start timing, FALSE to stop.
+  *
+  *  Output Parameters
+  *  =================
+  *  None.
+  *
+  *  Global Variables
+  *  =================
+  *  thist_on   : Set to on.
+  *******************************************************************************/
+
+    int i;
+
+    if (on) {
+	memset(hists, 0, sizeof(hists));
+	for (i = 0; i < HIST_OPS; i++)
+	    hists[i].min = ~0UL;
+    }
+    thist_on = on;
+}
+
+/* bst_stats_dump: write the counters of a tree and the latency histograms as JSON */
+Boolean bst_stats_dump(char *tname, FILE * fp)
+{
+ /*******************************************************************************
+  *  A user acccessible function that writes one JSON object to fp:
+  *
+  *    {"unit": "cycles", "timing": true,
+  *     "tree": {"name": "t", "nodes": 10, "counters": {"put": 10, ...},
+  *              "memory": {"slots": 744, "chunked": 0, ..., "distance": 322.7}},
+  *     "latency": {"put": {"count": 10, "mean": 412, "min": 180, "p50": 383,
+  *                         "p90": 639, "p99": 1023, "p999": 1023, "max": 960,
+  *                         "buckets": [[176, 1], [192, 2], ...]}, ...}}
+  *
+  *  "tree" is left out when tname is NULL; "memory" is what bst_mem_stats gives
+  *  back, less nodes. The percentiles are the upper bound
+  *  of the bucket they fall in, so within 1/HIST_SUB of the true value. Each
+  *  pair in "buckets" is the lowest value of a bucket and its count; empty
+  *  buckets are left out.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree whose counters to write, or NULL.
+  *  fp         : Where to write.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : Written.
+  *  FALSE      : Tree not defined.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    int i, j;
+    unsigned long *pc;
+    t_stats st;
+    t_memstats ms;
+    t_header *ph;
+    h_hist *h;
+
+    extern t_header *find_header(char *);
+    extern Boolean bst_stats(char *tname, t_stats * ps);
+    extern Boolean bst_mem_stats(char *tname, t_memstats * pm);
+
+    bst_errno = BST_ERR_RESET;
+
+    fprintf(fp, "{\"unit\": \"%s\", \"timing\": %s", TICKS_UNIT, thist_on ? "true" : "false");
+
+    if (tname != NULL) {
+	if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	    fprintf(fp, "}\n");
+	    bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	    return (FALSE);
+	}
+	bst_stats(tname, &st);
+	fprintf(fp, ",\n \"tree\": {\"name\": \"%s\", \"nodes\": %li, \"counters\": {", ph->th_name, ph->th_ncnt);
+	pc = (unsigned long *) &st;
+	for (i = 0; i < sizeof(t_stats) / sizeof(unsigned long); i++)
+	    fprintf(fp, "%s\"%s\": %lu", i ? ", " : "", snames[i], pc[i]);
+	bst_mem_stats(tname, &ms);
+	fprintf(fp, "},\n  \"memory\": {\"slots\": %li, \"chunked\": %li, \"free\": %li, \"unused\": %li, "
+		"\"malloced\": %li, \"bytes\": %li, \"huge\": %li, \"frag\": %.4f, \"distance\": %.1f}}",
+		ms.ms_slots, ms.ms_chunked, ms.ms_free, ms.ms_unused, ms.ms_malloced, ms.ms_bytes, ms.ms_huge,
+		ms.ms_frag, ms.ms_distance);
+    }
+
+    fprintf(fp, ",\n \"latency\": {");
+    for (i = 0; i < HIST_OPS; i++) {
+	h = &hists[i];
+	fprintf(fp, "%s\n  \"%s\": {\"count\": %lu", i ? "," : "", hnames[i], h->count);
+	if (h->count != 0)
+	    fprintf(fp, ", \"mean\": %lu, \"min\": %lu, \"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"p999\": %lu, \"max\": %lu",
+		    h->sum / h->count, h->min, hpercentile(h, 0.50), hpercentile(h, 0.90), hpercentile(h, 0.99),
+		    hpercentile(h, 0.999), h->max);
+	fprintf(fp, ", \"buckets\": [");
+	for (j = 0, pc = NULL; j < HIST_BUCKETS; j++)
+	    if (h->bucket[j] != 0) {
+		fprintf(fp, "%s[%lu, %lu]", pc == NULL ? "" : ", ", hvalue(j), h->bucket[j]);
+		pc = &h->bucket[j];
+	    }
+	fprintf(fp, "]}");
+    }
+    fprintf(fp, "}}\n");
+    return (TRUE);
+}
+
+/* tticks: read the clock the histograms count in */
+unsigned long tticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return ((unsigned long) __rdtsc());
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((unsigned long) ts.tv_sec * 1000000000UL + ts.tv_nsec);
+#endif
+}
+
+/* thist: add one timed call to the histogram of op */
+void thist(HistOps op, unsigned long ticks)
+{
+    h_hist *h;
+#ifdef BST_STATS_SHARDED
+    unsigned long m;
+#endif
+
+    h = &hists[op];
+#ifdef BST_STATS_SHARDED
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, ticks, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->bucket[hbucket(ticks)], 1, __ATOMIC_RELAXED);
+    for (m = __atomic_load_n(&h->min, __ATOMIC_RELAXED); ticks < m;)
+	if (__atomic_compare_exchange_n(&h->min, &m, ticks, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	    break;
+    for (m = __atomic_load_n(&h->max, __ATOMIC_RELAXED); ticks > m;)
+	if (__atomic_compare_exchange_n(&h->max, &m, ticks, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	    break;
+#else
+    h->count++;
+    h->sum += ticks;
+    h->bucket[hbucket(ticks)]++;
+    if (ticks < h->min)
+	h->min = ticks;
+    if (ticks > h->max)
+	h->max = ticks;
+#endif
+}
+
+/* hbucket: bucket of v; values below HIST_SUB get one each, then HIST_SUB per power of two */
+static int hbucket(unsigned long v)
+{
+    int msb;
+
+    if (v < HIST_SUB)
+	return ((int) v);
+#ifdef __GNUC__
+    msb = 63 - __builtin_clzl(v);
+#else
+    for (msb = HIST_SUBBITS; (v >> msb) > 1; msb++);
+#endif
+    return ((msb - HIST_SUBBITS) * HIST_SUB + (int) (v >> (msb - HIST_SUBBITS)));
+}
+
+/* hvalue: lowest value falling in bucket i */
+static unsigned long hvalue(int i)
+{
+    if (i < HIST_SUB)
+	return ((unsigned long) i);
+    return ((unsigned long) (HIST_SUB + i % HIST_SUB) << (i / HIST_SUB - 1));
+}
+
+/* hpercentile: upper bound of the bucket holding the q'th fraction of the calls */
+static unsigned long hpercentile(h_hist * h, double q)
+{
+    int i;
+    unsigned long rank, n;
+
+    if ((rank = (unsigned long) (q * h->count + 0.999999)) < 1)
+	rank = 1;
+    for (i = 0, n = 0; i < HIST_BUCKETS - 1; i++)
+	if ((n += h->bucket[i]) >= rank)
+	    break;
+    return (i == HIST_BUCKETS - 1 || hvalue(i + 1) - 1 > h->max ? h->max : hvalue(i + 1) - 1);
+}
@@ -0,0 +1,64 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+static char *RCSid[] = { "$Id$" };
+
+extern Boolean thuge_on;
+
+
+/* bst_huge_pages: slab the full sized nodes of the trees in huge pages or malloc them */
+void bst_huge_pages(Boolean on)
+{
+ /*******************************************************************************
+  *  A user acccessible function that tells how nodes of the full leaf size of
+  *  their tree are allocated from now on, for every tree. On, as it is to begin
+  *  with, they are carved from slabs as the size classed nodes of bst_alloc_size
+  *  are, and once the slabs of a tree come to HUGE_BYTES each new slab is one
+  *  huge page, so that a search through a large tree misses the data TLB far
+  *  less often. The chunks of bst_freeze and bst_restore are then backed by
+  *  huge pages where the kernel allows. Off, each such node is malloc'd by
+  *  itself. Nodes already allocated stay where they are either way.
+  *
+  *  Huge pages are transparent huge pages, or with BST_HUGETLB defined (see
+  *  LIB_HUGETLB in the Makefile) the reserved pages of hugetlbfs first; where
+  *  the kernel has neither, the slabs are in ordinary pages. A tree with an
+  *  allocator of the user (see bst_allocator) gets its slabs from that instead.
+  *
+  *  Input Parameters
+  *  =================
+  *  on         : TRUE to slab the nodes in huge pages, FALSE to malloc them.
+  *
+  *  Output Parameters
+  *  =================
+  *  None.
+  *
+  *  Global Variables
+  *  =================
+  *  thuge_on   : Set to on.
+  *******************************************************************************/
+
+    thuge_on = on;
+}
@@ -37,7 +37,228 @@
 #define  MIN_TREE_NAME_LEN   1
 #define  MAX_TREE_NAME_LEN   128
 #define  MAX_ID_LEN          32
+#define  NODE_ALIGN          sizeof(double)	/* alignment of nodes laid out in a chunk */
+#define  PCOPY_MIN_NODES     (long) 65536	/* smaller trees are copied by twalk */
+#define  PVERIFY_MIN_NODES   (long) 65536	/* smaller trees are verified by one thread */
+#define  TASKS_PER_CPU       4		/* subtrees handed out per thread by tsplit/tpool */
+#define  FRZ_KEYS            8		/* keys per 64 byte block of a frozen key index */
+#define  SLAB_CLASSES        48		/* size classes of nodes smaller than th_usiz */
+#define  SLAB_BYTES          65536	/* bytes of one slab of nodes of a size class */
+#define  COMPACT_LEVELS      10		/* levels of a tree bst_compact lays out breadth first */
+#define  AGG_MAX             256	/* bytes of a subtree aggregate at most (see bst_aggregate) */
+#define  COMPACT_CHECK       1024	/* removes between looks at th_frag (see bst_compact_auto) */
+#define  HUGE_BYTES          (2L << 20)	/* bytes of a huge page; of a slab once a tree has as many */
+#define  MAP_MAGIC           "libbst\n"	/* first bytes of a tree file of bst_save */
+#define  MAP_VERSION         2		/* layout of the tree file */
+#define  MAP_ORDER           0x0102030405060708UL	/* tells the byte order of the writer */
+#define  MAP_ALIGN           64		/* the nodes of a tree file start on a cache line */
+#define  DUMP_MAGIC          "bstdump"	/* first bytes of a tree dump of bst_dump */
+#define  DUMP_VERSION        2		/* format of the tree dump */
+#define  DUMP_BUF            (1 << 20)	/* bytes of the stdio buffer of a dump */
+#define  WAL_BUF             (1 << 20)	/* bytes of records a write ahead log buffers */
+#define  WAL_REMOVE          0x80000000U	/* tw_len bit of a remove record */
+
+/* basis and prime of the 64 bit FNV-1a of tsum */
+#define  SUM_BASIS           0xcbf29ce484222325UL
+#define  SUM_PRIME           0x100000001b3UL
+
+/* address of node i in a chunk of nodes that are stride bytes apart */
+#define  SLOT(base, i, stride)  ((t_node *) ((char *) (base) + (i) * (stride)))
+
+/* slot k, counting from 1, of the frozen layout of a tree (see bst_freeze) */
+#define  FSLOT(ph, k)  SLOT((ph)->th_frz, (k) - 1, (ph)->th_clist->tc_stride)
+
+/* slot k of the frozen layout at base: th_frz or the copy TREP of it on the NUMA node of the thread */
+#define  FSLOTB(ph, base, k)  SLOT((base), (k) - 1, (ph)->th_clist->tc_stride)
+#define  TREP(ph)  ((ph)->th_rep == NULL ? -1 : trepof(ph))
+#define  FBASE(ph, r)  ((r) < 0 ? (ph)->th_frz : (ph)->th_rep->tr_frz[r])
+
+/* nodes in the subtree at p of a multimap, a long in its leaf at th_moff; 0 for none (see bst_multimap) */
+#define  TNSUB(ph, p)  (*(long *) ((char *) ((p) + 1) + (ph)->th_moff))
+#define  NSUB(ph, p)   ((p) == NULL ? 0L : TNSUB((ph), (p)))
+
+/* aggregate of the subtree at p, in its leaf at th_aoff; NULL for none (see bst_aggregate) */
+#define  TAGG(ph, p)  ((p) == NULL ? NULL : (void *) ((char *) ((p) + 1) + (ph)->th_aoff))
+
+/* key prefix in the header of node p: with BST_KEY_PREFIX undefined a node has no */
+/* room for one, th_pfx is never set, a prefix reads as 0 and is not stored:       */
+#ifdef BST_KEY_PREFIX
+#define  KEY_PREFIX          TRUE
+#define  TNPFX(p)            ((p)->tn_pfx)
+#define  TNPFX_SET(p, k)     ((p)->tn_pfx = (k))
+#else
+#define  KEY_PREFIX          FALSE
+#define  TNPFX(p)            ((unsigned long) 0)
+#define  TNPFX_SET(p, k)     ((void) 0)
+#endif
+
+/* hint that memory at p is about to be read */
+#ifdef __GNUC__
+#define  PREFETCH(p)         __builtin_prefetch(p)
+#else
+#define  PREFETCH(p)
+#endif
+
+/* operation counters: with BST_STATS_SHARDED each thread adds atomically into one of */
+/* STATS_SHARDS sets of counters; otherwise a single set is added to without locking: */
+#ifdef BST_STATS_SHARDED
+#define  STATS_SHARDS        16
+#define  STATS(ph)           STATS_SHARD((ph), tshard())
+#define  STAT_ADD(ps, f, n)  __atomic_fetch_add(&(ps)->f, (n), __ATOMIC_RELAXED)
+extern int tshard(void);
+#else
+#define  STATS_SHARDS        1
+#define  STATS(ph)           ((ph)->th_stats)
+#define  STAT_ADD(ps, f, n)  ((ps)->f += (n))
+#endif
+
+/* each set of counters starts a cache line of its own, so no two threads share one */
+#define  STATS_LINE          64
+#define  STATS_STRIDE        ((sizeof(t_stats) + STATS_LINE - 1) / STATS_LINE * STATS_LINE)
+#define  STATS_SHARD(ph, i)  ((t_stats *) ((char *) (ph)->th_stats + (i) * STATS_STRIDE))
+
+/* latency histograms of the public calls (hist.c), log bucketed with HIST_SUB buckets */
+/* per power of two, kept only while bst_stats_timing has turned timing on:          */
+#define  HIST_SUBBITS        3
+#define  HIST_SUB            (1 << HIST_SUBBITS)
+#define  HIST_BUCKETS        ((64 - HIST_SUBBITS + 1) * HIST_SUB)
+#define  HIST_START(t)       ((t) = thist_on ? tticks() : 0)
+#define  HIST_STOP(op, t)    do { if (t) thist(op, tticks() - (t)); } while (0)
 
 #include "typedefs.h"
 #include "struct.h"
 #include "errno.h"
+
+extern Boolean thist_on;
+extern unsigned long tticks(void);
+extern void thist(HistOps op, unsigned long ticks);
+
+/* compare the keys of two users data areas of a tree: its built in key inline, else th_ucf */
+#define  TCMP(ph, a, b)      ((ph)->th_key.tk_type == KEY_USER ? (ph)->th_ucf((a), (b)) : tkcmp(&(ph)->th_key, (a), (b)))
+
+/* users data area a may come before b in order: a below b, or equal to it in a multimap */
+#define  TINORDER(ph, a, b)  (TCMP((ph), (a), (b)) < (int) (ph)->th_multi)
+
+/* tkeycmp: compare two built in keys at x and y; the loads go through memcpy as a key need not be aligned */
+static inline int tkeycmp(t_key * pk, const void *x, const void *y)
+{
+    int i32[2];
+    long long i64[2];
+    unsigned long long u64[2];
+    double d[2];
+
+    switch (pk->tk_type) {
+    case KEY_INT32:
+	memcpy(&i32[0], x, sizeof(int));
+	memcpy(&i32[1], y, sizeof(int));
+	return ((i32[0] > i32[1]) - (i32[0] < i32[1]));
+    case KEY_INT64:
+	memcpy(&i64[0], x, sizeof(long long));
+	memcpy(&i64[1], y, sizeof(long long));
+	return ((i64[0] > i64[1]) - (i64[0] < i64[1]));
+    case KEY_UINT64:
+	memcpy(&u64[0], x, sizeof(unsigned long long));
+	memcpy(&u64[1], y, sizeof(unsigned long long));
+	return ((u64[0] > u64[1]) - (u64[0] < u64[1]));
+    case KEY_DOUBLE:
+	memcpy(&d[0], x, sizeof(double));
+	memcpy(&d[1], y, sizeof(double));
+	return ((d[0] > d[1]) - (d[0] < d[1]));
+    case KEY_MEMCMP:
+	return (memcmp(x, y, pk->tk_len));
+    default:			/* KEY_STRING */
+	return (strncmp(x, y, pk->tk_len));
+    }
+}
+
+/* tsum: add n bytes at p to the checksum h, FNV-1a taken a word at a time, then the bytes left */
+static inline unsigned long tsum(unsigned long h, const void *p, long n)
+{
+    const unsigned char *c;
+    unsigned long w;
+
+    for (c = p; n >= (long) sizeof(w); c += sizeof(w), n -= sizeof(w)) {
+	memcpy(&w, c, sizeof(w));
+	h = (h ^ w) * SUM_PRIME;
+    }
+    while (n-- > 0)
+	h = (h ^ *c++) * SUM_PRIME;
+    return (h);
+}
+
+/* tksize: bytes of the built in key; 0 if the key type is unknown */
+static inline int tksize(t_key * pk)
+{
+    switch (pk->tk_type) {
+    case KEY_INT32:
+	return (sizeof(int));
+    case KEY_INT64:
+    case KEY_UINT64:
+	return (sizeof(long long));
+    case KEY_DOUBLE:
+	return (sizeof(double));
+    case KEY_MEMCMP:
+    case KEY_STRING:
+	return (pk->tk_len);
+    default:
+	return (0);
+    }
+}
+
+/* tkcmp: compare the built in keys of two users data areas */
+static inline int tkcmp(t_key * pk, void *a, void *b)
+{
+    return (tkeycmp(pk, (char *) a + pk->tk_offset, (char *) b + pk->tk_offset));
+}
+
+/* tkeypfx: the leading bytes of the built in key at x as an unsigned long in the same order */
+static inline unsigned long tkeypfx(t_key * pk, const void *x)
+{
+    const char *c;
+    int i, n;
+    unsigned long v;
+    long long i64;
+    double d;
+
+    switch (pk->tk_type) {
+    case KEY_INT32:
+	memcpy(&i, x, sizeof(int));
+	return ((unsigned long) (unsigned int) i ^ 0x80000000UL);
+    case KEY_INT64:
+    case KEY_UINT64:
+	memcpy(&i64, x, sizeof(long long));
+	return (pk->tk_type == KEY_INT64 ? (unsigned long) i64 ^ ~(~0UL >> 1) : (unsigned long) i64);
+    case KEY_DOUBLE:
+	memcpy(&d, x, sizeof(double));
+	d += 0.0;		/* -0.0 to 0.0, as they compare equal */
+	memcpy(&v, &d, sizeof(double));
+	return (v & ~(~0UL >> 1) ? ~v : v | ~(~0UL >> 1));
+    default:			/* KEY_MEMCMP, KEY_STRING: big endian, zero filled */
+	c = x;
+	n = pk->tk_len < (int) sizeof(unsigned long) ? pk->tk_len : (int) sizeof(unsigned long);
+	for (v = 0, i = 0; i < n && (pk->tk_type == KEY_MEMCMP || c[i] != '\0'); i++)
+	    v = v << 8 | (unsigned char) c[i];
+	return (i == 0 ? 0 : v << 8 * (sizeof(unsigned long) - i));
+    }
+}
+
+/* tkpfx: the prefix of the built in key of a users data area */
+static inline unsigned long tkpfx(t_key * pk, void *a)
+{
+    return (tkeypfx(pk, (char *) a + pk->tk_offset));
+}
+
+/* key prefix of a users data area of a tree: th_pfxf, else that of its built in key */
+#define  TPFX(ph, a)         ((ph)->th_pfxf != NULL ? (ph)->th_pfxf(a) : tkpfx(&(ph)->th_key, (a)))
+
+/* tpcmp: compare key a, whose prefix is kp, to node p: by the prefixes when the tree */
+/* keeps them and they differ, else by TCMP; counts which of the two decided it      */
+static inline int tpcmp(t_header * ph, unsigned long kp, void *a, t_node * p, unsigned long *ncmp, unsigned long *npfx)
+{
+    if (ph->th_pfx && kp != TNPFX(p)) {
+	(*npfx)++;
+	return (kp < TNPFX(p) ? -1 : 1);
+    }
+    (*ncmp)++;
+    return (TCMP(ph, a, p + 1));
+}
@@ -49,3 +49,26 @@
 #define  BST_ERR_NAME_LEN_T1            123	/* tree name length problems   */
 #define  BST_ERR_NAME_LEN_T2            124	/* tree name length problems   */
 #define  BST_ERR_UKNOWN_BST_TYPE        125	/* tree type is not AVL or BST */
+#define  BST_ERR_ULINK                  126	/* node has wrong parent link  */
+#define  BST_ERR_KEY_ORDER              127	/* keys out of order           */
+#define  BST_ERR_NODE_COUNT             128	/* th_ncnt differs from tree   */
+#define  BST_ERR_TREE_FROZEN            129	/* tree is frozen: read only   */
+#define  BST_ERR_KEY_DESC               130	/* bad built in key descriptor */
+#define  BST_ERR_KEY_PREFIX             131	/* node key prefix wrong       */
+#define  BST_ERR_KEY_COMPARE            132	/* no compare of a bare key    */
+#define  BST_ERR_LEAF_SIZE              133	/* bad size of a variable leaf */
+#define  BST_ERR_MAP_IO                 134	/* tree file I/O failed        */
+#define  BST_ERR_MAP_FORMAT             135	/* not a tree file of ours     */
+#define  BST_ERR_DUMP_CORRUPT           136	/* tree dump fails its checks  */
+#define  BST_ERR_WAL_IO                 137	/* write ahead log I/O failed  */
+#define  BST_ERR_NO_WAL                 138	/* tree has no write ahead log */
+#define  BST_ERR_FRAG                   139	/* fragmentation not in 0..1   */
+#define  BST_ERR_ALLOCATOR              140	/* allocator lacks a function  */
+#define  BST_ERR_NUMA_POLICY            141	/* no such NUMA policy         */
+#define  BST_ERR_CURSOR_STALE           142	/* tree changed under a cursor */
+#define  BST_ERR_SUBTREE_COUNT          143	/* node subtree count wrong    */
+#define  BST_ERR_AGGREGATE_FIELD        144	/* aggregate not in the leaf   */
+#define  BST_ERR_NO_AGGREGATE           145	/* tree has no aggregate       */
+#define  BST_ERR_AGGREGATE              146	/* node aggregate wrong        */
+#define  BST_ERR_COUNT_FIELD            147	/* subtree count not in leaf   */
+#define  BST_ERR_WAL_MULTIMAP           148	/* multimap can not be logged  */
@@ -24,20 +24,80 @@
 #define  MIN_TREE_NAME_LEN   1      /* min length for a tree name */
 #define  MAX_TREE_NAME_LEN   128    /* max length for a tree name */
 
+/* BUILT IN KEY OF A TREE (SEE bst_create_key); ALSO IN bstpkg.h */
+#ifndef BST_STRUCT_KEY
+#define BST_STRUCT_KEY
+struct key {
+	int            tk_type;				/* KeyType */
+	int            tk_offset;			/* offset of the key in the users data */
+	int            tk_len;				/* bytes of a KEY_MEMCMP or KEY_STRING key */
+};
+#endif
+
+/* ALLOCATOR OF THE MEMORY OF A TREE (SEE bst_allocator); ALSO IN bstpkg.h */
+#ifndef BST_STRUCT_ALLOCATOR
+#define BST_STRUCT_ALLOCATOR
+struct allocator {
+	void        *(*ta_alloc) (void *, size_t);	/* allocate bytes; NULL: malloc */
+	void         (*ta_free) (void *, void *);	/* give back what ta_alloc gave */
+	void        *(*ta_bulk_alloc) (void *, size_t);	/* chunks and slabs of nodes, or NULL */
+	void         (*ta_bulk_free) (void *, void *, size_t);	/* give back a bulk piece of so many bytes */
+	void          *ta_ctx;				/* first argument of each of the above */
+};
+#endif
+
+/* RUN OF EQUAL KEYS OF A MULTIMAP (SEE bst_equal_range); ALSO IN bstpkg.h */
+#ifndef BST_STRUCT_CURSOR
+#define BST_STRUCT_CURSOR
+struct cursor {
+	void          *tu_next;				/* node to hand back next, or NULL at the end */
+	void          *tu_last;				/* last node of the run */
+	long int       tu_count;			/* nodes in the run */
+	unsigned long  tu_gen;				/* th_gen of the tree the run is of */
+};
+#endif
+
 /* HEADER STRUCTURE FOR A BST TREE */
 struct header {	
 	char           th_name[MAX_TREE_NAME_LEN+1];	/* tree name */
 	struct header *th_link;				/* pointer to next tree */
 	struct node   *th_root;				/* pointer to root node */
 	struct node   *th_flist;			/* pointer to free list */
+	struct chunk  *th_clist;			/* pointer to list of node chunks */
+	struct slabs  *th_slab;				/* size classed nodes (see bst_alloc_size) or NULL */
+	struct stats  *th_stats;			/* operation counters, STATS_SHARDS of them */
+	struct wal    *th_wal;				/* write ahead log (see bst_wal_open) or NULL */
+	struct compact *th_cmp;				/* compaction under way (see bst_compact) or NULL */
+	unsigned long  th_gen;				/* changes to the shape of the tree, for th_cmp */
+	double         th_frag;				/* ms_frag at which bst_remove compacts, or 0 */
+	struct allocator th_alloc;			/* allocator of the tree's memory (see bst_allocator) */
+	struct replicas *th_rep;			/* copies of the frozen layout per NUMA node or NULL */
+	long int       th_rmcnt;			/* removes since th_frag was last looked at */
+	struct node   *th_frz;				/* slot 1 of the frozen layout (see bst_freeze) */
+	struct frzidx *th_fidx;				/* key index of the frozen layout or NULL */
+	void          *th_map;				/* tree file mapped by bst_open_mapped or NULL */
+	long int       th_mlen;			/* bytes mapped at th_map */
 	double         th_id;				/* tree/node timestamp id */
 	long int       th_ncnt;				/* number of nodes in tree */
 	int            th_usiz;				/* user data size */
 	int          (*th_ucf) (void *, void *);	/* pointer to user cmp function */
+	struct key     th_key;				/* built in key; KEY_USER: use th_ucf */
+	unsigned long(*th_pfxf) (void *);		/* user's key prefix of a leaf, or NULL */
+	int          (*th_kcf) (const void *, void *);	/* user's cmp of a bare key to a leaf, or NULL */
+	void         (*th_aggf) (void *, const void *, const void *, const void *);	/* user's subtree aggregate, or NULL */
+	int            th_aoff;				/* offset of the aggregate in a leaf (see bst_aggregate) */
+	int            th_asiz;				/* bytes of the aggregate */
+	int            th_moff;				/* offset of the subtree count in a leaf, if th_multi */
 	void         (*th_upf) (void *, int);		/* pointer to user function to print a node */
 	unsigned int   th_flcnt:8;			/* number of nodes in free list */
 	unsigned int   th_np   :1;			/* no pointers in user's structure */
-	unsigned int   th_stat :1;			/* check status of tree for each ins/del */
+	unsigned int   th_stat :2;			/* TreeVerifyType: check tree for each ins/del */
+	unsigned int   th_frozen:1;			/* tree is frozen: read only */
+	unsigned int   th_pfx  :1;			/* nodes carry a key prefix in tn_pfx */
+	unsigned int   th_var  :1;			/* some node has less than th_usiz bytes */
+	unsigned int   th_mrel :1;			/* links of the mapped nodes are still file offsets */
+	unsigned int   th_numa :2;			/* NumaPolicy: placement of the nodes (see bst_numa) */
+	unsigned int   th_multi:1;			/* equal keys are kept, first in first (see bst_multimap) */
 	int            th_bsttype;			/* what type of bst is this: avl or bst */
 	char           th_version_id[MAX_ID_LEN+1];	/* program version number */
 	int            th_reserved1;			/* reserved for later use */
@@ -49,8 +109,151 @@ struct node {
 	struct node   *tn_ulink;			/* pointer to parent */
 	struct node   *tn_llink;			/* pointer to left subtree */
 	struct node   *tn_rlink;			/* pointer to right subtree */
+#ifdef BST_KEY_PREFIX
+	unsigned long  tn_pfx;				/* key prefix, if th_pfx (see bst_key_prefix) */
+#endif
 	double         tn_id;				/* tree/node timestamp id */
 	signed int     tn_bf  :3;			/* balance factor */
 	unsigned int   tn_tag :3;			/* node is left or right subtree */
 	unsigned int   tn_rank:9;			/* number of nodes in left subtree + 1 */
+	unsigned int   tn_chunk:1;			/* node lives in a chunk, not malloc'd */
+	unsigned int   tn_slab:6;			/* 1 + size class of a node in a slab, else 0 */
+	int            tn_usiz;				/* bytes of users data in this node */
+};
+
+/* HEADER STRUCTURE FOR A CHUNK OF TREE NODES ALLOCATED IN ONE PIECE */
+struct chunk {
+	struct chunk  *tc_link;				/* pointer to next chunk */
+	long int       tc_nnodes;			/* number of nodes in chunk */
+	long int       tc_stride;			/* bytes from one node to the next */
+	long int       tc_bytes;			/* bytes allocated, chunk included */
+};
+
+/* NODES CARVED BY SIZE CLASS FROM SLABS (SEE tallocm); CLASS SLAB_CLASSES IS OF th_usiz BYTES */
+struct slabs {
+	struct chunk  *ts_list;				/* pointer to list of malloc'd slabs */
+	struct chunk  *ts_huge;				/* pointer to list of slabs mapped in huge pages */
+	long int       ts_bytes;			/* bytes of all slabs of the tree */
+	struct node   *ts_free[SLAB_CLASSES+1];		/* free nodes of each size class */
+	char          *ts_next[SLAB_CLASSES+1];		/* next node not yet handed out of a class */
+	long int       ts_left[SLAB_CLASSES+1];		/* nodes left at ts_next */
+};
+
+/* HEADER OF A TREE FILE (SEE bst_save): THE NODES FOLLOW AT tm_offset IN FROZEN ORDER, */
+/* THEIR LINKS GIVEN AS BYTES FROM THE NODE TO THE NODE LINKED TO, 0 FOR NULL            */
+struct mapfile {
+	char           tm_magic[8];			/* MAP_MAGIC */
+	int            tm_version;			/* MAP_VERSION of the layout */
+	int            tm_nodesize;			/* sizeof(struct node) of the writer */
+	unsigned long  tm_order;			/* MAP_ORDER, as the writer stores it */
+	double         tm_id;				/* th_id; the tn_id of every node */
+	long int       tm_ncnt;				/* th_ncnt */
+	long int       tm_stride;			/* bytes from one node to the next */
+	long int       tm_offset;			/* bytes from the start of the file to node 1 */
+	int            tm_usiz;				/* th_usiz */
+	int            tm_bsttype;			/* th_bsttype */
+	struct key     tm_key;				/* th_key */
+	int            tm_pfx;				/* nodes carry prefixes of the built in key */
+	int            tm_var;				/* th_var */
+	int            tm_multi;			/* th_multi */
+	int            tm_moff;				/* th_moff */
+	char           tm_version_id[MAX_ID_LEN+1];	/* th_version_id */
+};
+/* HEADER OF A TREE DUMP (SEE bst_dump): THEN tdf_ncnt RECORDS IN ORDER, EACH AN int OF */
+/* ITS LENGTH AND THE USERS DATA, THEN AN unsigned long CHECKSUM OF ALL THE RECORDS        */
+struct dumpfile {
+	char           tdf_magic[8];			/* DUMP_MAGIC */
+	int            tdf_version;			/* DUMP_VERSION of the format */
+	int            tdf_usiz;			/* th_usiz */
+	unsigned long  tdf_order;			/* MAP_ORDER, as the writer stores it */
+	long int       tdf_ncnt;			/* number of records */
+	int            tdf_bsttype;			/* th_bsttype */
+	int            tdf_np;				/* th_np */
+	struct key     tdf_key;				/* th_key */
+	int            tdf_pfx;				/* nodes carry prefixes of the built in key */
+	int            tdf_multi;			/* th_multi */
+	int            tdf_moff;			/* th_moff */
+	char           tdf_version_id[MAX_ID_LEN+1];	/* th_version_id */
+};
+/* RECORD OF A WRITE AHEAD LOG (SEE bst_wal_open): THEN tw_len BYTES OF USERS DATA */
+struct walrec {
+	unsigned int   tw_sum;				/* tsum of tw_len and the data, folded to 32 bits */
+	unsigned int   tw_len;				/* bytes of data; WAL_REMOVE set for a remove */
+};
+
+/* KEY INDEX OF A FROZEN TREE (SEE bst_freeze_keys): FRZ_KEYS KEYS PER BLOCK */
+struct frzidx {
+	unsigned long (*tf_keyf) (void *);		/* user's fixed width key of a leaf */
+	long          *tf_keys;				/* keys of the blocks, sign flipped */
+	struct node  **tf_node;				/* node of each key; NULL for padding */
+	long int       tf_nblocks;			/* number of blocks */
+	void          *tf_base;				/* what was allocated, tf_keys aligned within */
+};
+
+/* COPIES OF THE FROZEN LAYOUT OF A TREE ON THE NUMA NODES (SEE bst_numa) */
+struct replicas {
+	long int       tr_bytes;			/* bytes of each copy */
+	int            tr_count;			/* entries of tr_frz and tr_keys, by node number */
+	struct node  **tr_frz;				/* slot 1 of the copy on each node, or NULL */
+	long         **tr_keys;				/* its copy of the keys of th_fidx, or NULL */
+	int            tr_ncpu;				/* entries of tr_cpu */
+	int           *tr_cpu;				/* copy of each cpu, by cpu number, or -1 */
+};
+
+/* ONE ENTRY OF A TREE SPLIT INTO TOP NODES AND SUBTREES (SEE tsplit) */
+struct split {
+	struct node   *ts_node;			/* top node or subtree root */
+	long int       ts_up;			/* index of parent entry; -1 for root */
+};
+
+/* RESULT OF A TREE VERIFICATION (SEE bst_verify); ALSO IN bstpkg.h */
+#ifndef BST_STRUCT_VERIFY
+#define BST_STRUCT_VERIFY
+struct verify {
+	int            tv_errno;			/* kind of violation; 0 if none */
+	void          *tv_leaf;				/* users data area of the bad node */
+	long int       tv_ncnt;				/* number of nodes counted */
+	int            tv_height;			/* height of the tree */
+};
+#endif
+
+/* OPERATION COUNTERS OF A TREE (SEE bst_stats); ALSO IN bstpkg.h */
+#ifndef BST_STRUCT_STATS
+#define BST_STRUCT_STATS
+struct stats {
+	unsigned long  st_put;				/* bst_put calls */
+	unsigned long  st_get;				/* bst_get calls */
+	unsigned long  st_remove;			/* bst_remove calls */
+	unsigned long  st_cmp;				/* compare function calls by the three */
+	unsigned long  st_pfx;				/* compares decided by the key prefixes alone */
+	unsigned long  st_ll;				/* LL rotations on insert */
+	unsigned long  st_lr;				/* LR rotations on insert */
+	unsigned long  st_rr;				/* RR rotations on insert */
+	unsigned long  st_rl;				/* RL rotations on insert */
+	unsigned long  st_rmll;				/* LL rotations on remove */
+	unsigned long  st_rmlr;				/* LR rotations on remove */
+	unsigned long  st_rmrr;				/* RR rotations on remove */
+	unsigned long  st_rmrl;				/* RL rotations on remove */
+	unsigned long  st_flist;			/* nodes taken from th_flist */
+	unsigned long  st_malloc;			/* nodes malloc'd */
+	unsigned long  st_chain;			/* nodes put back on th_flist */
+	unsigned long  st_free;				/* nodes freed, th_flist being full */
+};
+#endif
+
+/* WHERE THE NODES OF A TREE ARE (SEE bst_mem_stats); ALSO IN bstpkg.h */
+#ifndef BST_STRUCT_MEMSTATS
+#define BST_STRUCT_MEMSTATS
+struct memstats {
+	long int       ms_nodes;			/* nodes in the tree */
+	long int       ms_slots;			/* nodes its chunks and slabs have room for */
+	long int       ms_chunked;			/* of those, in chunks */
+	long int       ms_free;				/* nodes on the free lists */
+	long int       ms_unused;			/* slab nodes not handed out yet */
+	long int       ms_malloced;			/* nodes of the tree malloc'd by themselves */
+	long int       ms_bytes;			/* bytes of the chunks and slabs */
+	long int       ms_huge;				/* of those, in huge pages */
+	double         ms_frag;				/* share of the slots not holding a node of the tree */
+	double         ms_distance;			/* average bytes from a node to its parent */
 };
+#endif
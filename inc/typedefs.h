@@ -23,6 +23,20 @@
 
 typedef struct header t_header;
 typedef struct node t_node;
+typedef struct chunk t_chunk;
+typedef struct split t_split;
+typedef struct verify t_verify;
+typedef struct stats t_stats;
+typedef struct memstats t_memstats;
+typedef struct allocator t_alloc;
+typedef struct replicas t_replicas;
+typedef struct frzidx t_frzidx;
+typedef struct slabs t_slabs;
+typedef struct mapfile t_mapfile;
+typedef struct dumpfile t_dumpfile;
+typedef struct walrec t_walrec;
+typedef struct key t_key;
+typedef struct cursor t_cursor;
 
 typedef
     enum {
@@ -33,7 +47,12 @@ typedef
 typedef
     enum {
     T_HEADER,
-    T_NODE
+    T_NODE,
+    T_CHUNK,
+    T_TRYCHUNK,
+    T_FRZIDX,
+    T_SLAB,
+    T_MAP
 } MallocTypes;
 
 typedef
@@ -48,12 +67,39 @@ typedef
     BST
 } BstType;
 
+typedef
+    enum {
+    KEY_USER,
+    KEY_INT32,
+    KEY_INT64,
+    KEY_UINT64,
+    KEY_DOUBLE,
+    KEY_MEMCMP,
+    KEY_STRING
+} KeyType;
+
 typedef
     enum {
     TREE_VERIFY_NO,
-    TREE_VERIFY_YES
+    TREE_VERIFY_YES,
+    TREE_VERIFY_PATH
 } TreeVerifyType;
 
+typedef
+    enum {
+    WAL_NONE,
+    WAL_WRITE,
+    WAL_COMMIT,
+    WAL_FSYNC
+} WalSync;
+
+typedef
+    enum {
+    NUMA_LOCAL,
+    NUMA_INTERLEAVE,
+    NUMA_REPLICATE
+} NumaPolicy;
+
 typedef
     enum {
     DELETE,
@@ -88,3 +134,13 @@ typedef
     LEFT_ROTATION,
     RIGHT_ROTATION
 } Rotations;
+
+typedef
+    enum {
+    H_PUT,
+    H_GET,
+    H_REMOVE,
+    H_COPY,
+    H_EQUAL,
+    HIST_OPS
+} HistOps;
@@ -27,7 +27,7 @@ static char *RCSid[] = { "$Id$" };
 
 
 /* put_node: insert a node into the tree. */
-Boolean put_node(t_header * ph, t_node * pcopy, int (*th_ucf) (), t_node * a, t_node * q, t_node ** b, int *d)
+Boolean put_node(t_header * ph, t_node * pcopy, t_node * a, t_node * q, t_node ** b, int *d)
 {
  /*******************************************************************************
   *  A private library function that inserts a tree node into the tree returning
@@ -36,7 +36,6 @@ Boolean put_node(t_header * ph, t_node * pcopy, int (*th_ucf) (), t_node * a, t_
   *  Input Parameters
   *  =================
   *    pcopy: Pointer (t_node) to the new node to insert.
-  *    th_ucf  : Pointer to user written compare function.
   *    a    : Pointer to pointer (t_node) to last node with tn_bf **
   *           equal to +1 or -1 closest to the new node pcopy.
   *    q    : Pointer to pointer (t_node) to the parent node of the
@@ -54,6 +53,7 @@ Boolean put_node(t_header * ph, t_node * pcopy, int (*th_ucf) (), t_node * a, t_
   *******************************************************************************/
 
     Boolean unbalanced;
+    unsigned long ncmp, npfx;
     t_node *p, *pn;
 
     if (ph->th_root == NULL) {	/* empty tree - special case      */
@@ -66,8 +66,9 @@ Boolean put_node(t_header * ph, t_node * pcopy, int (*th_ucf) (), t_node * a, t_
 
     /* Link the new node into the tree by linking it to its parent node pointed to by q: */
     pcopy->tn_ulink = q;
+    ncmp = npfx = 0;		/* compare calls made, compares the key prefixes decided */
 
-    if (th_ucf(pcopy + 1, q + 1) < 0) {
+    if (tpcmp(ph, TNPFX(pcopy), pcopy + 1, q, &ncmp, &npfx) < 0) {
 	q->tn_llink = pcopy;
 	pcopy->tn_tag = LEFT_SON;
     } else {
@@ -77,21 +78,22 @@ Boolean put_node(t_header * ph, t_node * pcopy, int (*th_ucf) (), t_node * a, t_
 
     /* Set *p to the head of the path from *a to *q to adjust those balance   */
     /* factors on that path and set flag d to which side of the subtree the   */
-    /* new node was inserted on:                                              */
-    if (th_ucf(pcopy + 1, a + 1) > 0) {
-	p = a->tn_rlink;	/* head of path starts in a.right subtree     */
+    /* new node was inserted on; a key equal to that of a node, in a multimap, */
+    /* goes right of it as above:                                             */
+    if (tpcmp(ph, TNPFX(pcopy), pcopy + 1, a, &ncmp, &npfx) < 0) {
+	p = a->tn_llink;	/* head of path starts in a.left subtree      */
 	*b = p;			/* b is an additional pointer                 */
-	*d = -1;		/* new node is inserted in right subtree of a */
+	*d = +1;		/* new node is inserted in left subtree of a  */
     } else {
-	p = a->tn_llink;	/* head of path starts in a.left subtree      */
+	p = a->tn_rlink;	/* head of path starts in a.right subtree     */
 	*b = p;
-	*d = +1;		/* new node is inserted in left subtree of a  */
+	*d = -1;		/* new node is inserted in right subtree of a */
     }
 
     /* Trace down the path from a to q, adjusting each node tn_bf     */
     /* whether the new node was inserted in the left or right subtree         */
     while (p != pcopy) {
-	if (th_ucf(pcopy + 1, p + 1) < 0) {
+	if (tpcmp(ph, TNPFX(pcopy), pcopy + 1, p, &ncmp, &npfx) < 0) {
 	    p->tn_bf = +1;
 	    p = p->tn_llink;
 	} else {
@@ -100,6 +102,9 @@ Boolean put_node(t_header * ph, t_node * pcopy, int (*th_ucf) (), t_node * a, t_
 	}
     }
 
+    STAT_ADD(STATS(ph), st_cmp, ncmp);
+    STAT_ADD(STATS(ph), st_pfx, npfx);
+
     /* Now after insertion, check if tree is unbalanced: */
     unbalanced = TRUE;
 
@@ -0,0 +1,226 @@
+/*
+  +------------------------------------------------------------------------+
+  | mapbench is a terminal program timing bst::avl_map of avl_map.hpp      |
+  | against std::map over reproducible workloads of any size.              |
+  |                                                                        |
+  | Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net            |
+  |                                                                        |
+  | This program is free software: you can redistribute it and/or modify   |
+  | it under the terms of the GNU General Public License as published by   |
+  | the Free Software Foundation, either version 3 of the License, or      |
+  | (at your option) any later version.                                    |
+  |                                                                        |
+  | This program is distributed in the hope that it will be useful,        |
+  | but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+  | MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+  | GNU General Public License for more details.                           |
+  |                                                                        |
+  | You should have received a copy of the GNU General Public License      |
+  | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+  +------------------------------------------------------------------------+
+*/
+
+/*
+ * mapbench runs each workload below on a bst::avl_map<unsigned long,
+ * unsigned long> and then on a std::map of the same, and prints one line
+ * per map and workload as bench does, CSV (default) or JSON. The keys are
+ * those of bench: the i'th key is a bijective 64 bit mix of i and the seed.
+ *
+ * Workloads, in the order they are run:
+ *   insert-random : insert keys 0..n-1 with emplace.
+ *   get-hit       : find ops keys known to be in the map.
+ *   get-miss      : find ops keys known not to be in the map.
+ *   iterate       : walk the map from begin() to end(); ops is its size.
+ *   churn         : ops times erase the oldest key and insert a new one.
+ *   erase         : erase every key left in the map by key.
+ *
+ * Usage: mapbench [-n keys] [-o ops] [-s seed] [-f csv|json]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <map>
+
+#include "avl_map.hpp"
+
+#define  KEYS_DEFAULT   1000000	/* -n */
+#define  SEED_DEFAULT   1	/* -s */
+
+static char *RCSid[] = { (char *) "$Id$" };
+
+static long nkeys = KEYS_DEFAULT;	/* keys inserted by insert-random */
+static long ops = -1;		/* operations of the get and churn workloads */
+static unsigned long seed = SEED_DEFAULT;	/* seed of the keys and of the draws */
+static int json;		/* -f json */
+static int nrows;		/* lines printed */
+static unsigned long state;	/* state of rnd() */
+static unsigned long sink;	/* what the lookups found, so they are not optimized away */
+
+static unsigned long mix(unsigned long x);
+static unsigned long rnd(void);
+static unsigned long key(long i);
+static double now(void);
+static long peakrss(void);
+static void report(const char *map, const char *workload, long done, double t);
+static void usage(char *prog);
+
+/* run: time the workloads on an empty map m called name */
+template <class Map> static void run(const char *name, Map & m)
+{
+    long i, lo, hi, done;
+    double t;
+    typename Map::iterator it;
+
+    state = mix(seed);
+    t = now();
+    for (i = 0; i < nkeys; i++)
+	m.emplace(key(i), (unsigned long) i);
+    report(name, "insert-random", nkeys, now() - t);
+    lo = 0;
+    hi = nkeys;
+
+    t = now();
+    for (i = 0; i < ops; i++)
+	if ((it = m.find(key(lo + (long) (rnd() % (hi - lo))))) != m.end())
+	    sink += it->second;
+	else {
+	    fprintf(stderr, "mapbench: %s: key missing\n", name);
+	    exit(1);
+	}
+    report(name, "get-hit", ops, now() - t);
+
+    t = now();
+    for (i = 0; i < ops; i++)
+	if (m.find(key(hi + (long) (rnd() % nkeys) + 1)) != m.end()) {
+	    fprintf(stderr, "mapbench: %s: key found\n", name);
+	    exit(1);
+	}
+    report(name, "get-miss", ops, now() - t);
+
+    t = now();
+    for (done = 0, it = m.begin(); it != m.end(); ++it, done++)
+	sink += it->second;
+    report(name, "iterate", done, now() - t);
+
+    t = now();
+    for (i = 0; i < ops; i++, lo++, hi++) {
+	m.erase(key(lo));
+	m.emplace(key(hi), (unsigned long) hi);
+    }
+    report(name, "churn", ops, now() - t);
+
+    t = now();
+    for (done = 0; lo < hi; lo++)
+	done += (long) m.erase(key(lo));
+    report(name, "erase", done, now() - t);
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+
+    while ((c = getopt(argc, argv, "n:o:s:f:h")) != -1)
+	switch (c) {
+	case 'n':
+	    nkeys = atol(optarg);
+	    break;
+	case 'o':
+	    ops = atol(optarg);
+	    break;
+	case 's':
+	    seed = strtoul(optarg, NULL, 0);
+	    break;
+	case 'f':
+	    json = strcmp(optarg, "json") == 0;
+	    break;
+	default:
+	    usage(argv[0]);
+	}
+    if (nkeys < 1)
+	usage(argv[0]);
+    if (ops < 0)
+	ops = nkeys;
+
+    if (json)
+	printf("[");
+    else
+	printf("map,workload,keys,ops,seconds,ops_per_sec,ns_per_op,peak_rss_kb,seed\n");
+    {
+	bst::avl_map<unsigned long, unsigned long> m;
+
+	run("avl_map", m);
+    }
+    {
+	std::map<unsigned long, unsigned long> m;
+
+	run("std::map", m);
+    }
+    if (json)
+	printf("\n]\n");
+    fprintf(stderr, "mapbench: sink %lu\n", sink);
+    return (0);
+}
+
+/* mix: the splitmix64 finalizer, a bijection of 64 bit numbers */
+static unsigned long mix(unsigned long x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+    return (x ^ (x >> 31));
+}
+
+/* rnd: next number of the splitmix64 sequence */
+static unsigned long rnd(void)
+{
+    return (mix(state += 0x9e3779b97f4a7c15UL));
+}
+
+/* key: the i'th key of this seed */
+static unsigned long key(long i)
+{
+    return (mix((unsigned long) i + seed * 0x9e3779b97f4a7c15UL));
+}
+
+/* now: seconds on the monotonic clock */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+/* peakrss: peak resident set size of the process so far in KB */
+static long peakrss(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_maxrss);
+}
+
+/* report: print the line of one workload */
+static void report(const char *map, const char *workload, long done, double t)
+{
+    if (json)
+	printf("%s\n {\"map\": \"%s\", \"workload\": \"%s\", \"keys\": %li, \"ops\": %li, \"seconds\": %.6f, "
+	       "\"ops_per_sec\": %.0f, \"ns_per_op\": %.1f, \"peak_rss_kb\": %li, \"seed\": %lu}", nrows ? "," : "",
+	       map, workload, nkeys, done, t, done ? done / t : 0.0, done ? t * 1e9 / done : 0.0, peakrss(), seed);
+    else
+	printf("%s,%s,%li,%li,%.6f,%.0f,%.1f,%li,%lu\n", map, workload, nkeys, done, t, done ? done / t : 0.0,
+	       done ? t * 1e9 / done : 0.0, peakrss(), seed);
+    fflush(stdout);
+    nrows++;
+}
+
+/* usage: say how to run mapbench and stop */
+static void usage(char *prog)
+{
+    fprintf(stderr, "usage: %s [-n keys] [-o ops] [-s seed] [-f csv|json]\n", prog);
+    fprintf(stderr, "workloads: insert-random get-hit get-miss iterate churn erase, on avl_map then std::map\n");
+    exit(2);
+}
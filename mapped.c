@@ -0,0 +1,349 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#include <stdio.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+/* a link of node p to node l as the bytes from p to l in a tree file, and back */
+#define  MAPOFF(p, l)   ((t_node *) ((l) == NULL ? 0L : (char *) (l) - (char *) (p)))
+#define  MAPLINK(p, l)  ((l) == NULL ? NULL : (t_node *) ((char *) (p) + (long) (l)))
+
+static char *RCSid[] = { "$Id$" };
+
+extern t_header *t_head;
+extern int bst_errno;
+
+static Boolean tsave(t_header * ph, char *path);
+static void tpad(FILE * fp, long n);
+
+
+/* bst_save: write a tree to a file that bst_open_mapped maps back in */
+Boolean bst_save(char *tname, char *path)
+{
+ /*******************************************************************************
+  *  A user acccessible function that writes a tree to path so that a later
+  *  process can bst_open_mapped it and search it at once rather than build it
+  *  again with bst_put. The file holds a header of the tree (struct mapfile)
+  *  and then its nodes in the frozen layout of bst_freeze, each with its links
+  *  as the bytes from the node to the node linked to, so the file means the
+  *  same wherever it is mapped. A tree that is not frozen is frozen to write it
+  *  and thawed again. The file is written under path.tmp and then renamed, so
+  *  a file of the same name that is mapped or being read is never cut short.
+  *
+  *  The leaves are written as they are: pointers in them mean nothing to the
+  *  process that maps the file. Key prefixes are kept only if they are of the
+  *  built in key, since a prefix function can not be written to a file.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree to save.
+  *  path       : Name of the file to write.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree is in the file.
+  *  FALSE      : Tree not defined, malloc error or the file could not be written.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+    Boolean frozen, r;
+
+    extern t_header *find_header(char *);
+    extern void tfreem(MallocTypes mkind, ...);
+    extern Boolean bst_freeze(char *);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    if (!(frozen = ph->th_frozen) && bst_freeze(tname) == FALSE)
+	return (FALSE);
+    r = tsave(ph, path);
+
+    /* as bst_thaw, which would reset bst_errno: */
+    if (!frozen) {
+	tfreem(T_FRZIDX, ph);
+	ph->th_frz = NULL;
+	ph->th_frozen = FALSE;
+    }
+    return (r);
+}
+
+/* bst_open_mapped: define a tree as the tree file written by bst_save */
+Boolean bst_open_mapped(char *tname, char *path, int (*compf) (void *, void *), void (*prntf) (void *, int))
+{
+ /*******************************************************************************
+  *  A user acccessible function that defines the tree tname from a file of
+  *  bst_save by mapping it copy on write into memory, not reading it: the tree
+  *  can be searched at once and only the pages of the nodes looked at are ever
+  *  read from the file. The tree is frozen, so bst_get and bst_find_key search
+  *  it by index with no links followed. The first call that follows the links,
+  *  such as bst_thaw, bst_print, bst_copy or bst_verify, turns them into
+  *  addresses once, which touches every node. A thawed tree can be changed as
+  *  any other; the file is never written. bst_delete unmaps it.
+  *
+  *  Compare and print functions can not be kept in a file, so a tree ordered
+  *  by a compare function needs the same one again here; a tree created by
+  *  bst_create_key needs none. The file must come from a build of libbst with
+  *  the same node layout, word size and byte order.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree to define.
+  *  path       : Name of the file of bst_save.
+  *  compf      : Pointer to user written compare function, or NULL for a
+  *               tree with a built in key.
+  *  prntf      : Pointer to user written print function, or NULL.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree is defined and frozen.
+  *  FALSE      : Tree is already defined, bad tree name, no compare function,
+  *               the file could not be opened or mapped, or is not a tree file.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *  t_head     : A linked list of defined AVL trees.
+  *******************************************************************************/
+
+    t_header *ph;
+    t_mapfile m;
+    t_node *base;
+    struct stat sb;
+    int fd;
+
+    extern t_header *find_header(char *);
+    extern void *tallocm(MallocTypes mkind, ...);
+    extern void tfreem(MallocTypes mkind, ...);
+
+    bst_errno = BST_ERR_RESET;
+
+    if (strlen(tname) < MIN_TREE_NAME_LEN || strlen(tname) > MAX_TREE_NAME_LEN) {
+	bst_errno = BST_ERR_NAME_LEN;
+	return (FALSE);
+    }
+    if (find_header(tname) != TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_ALREADY_DEFINED;
+	return (FALSE);
+    }
+    if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &sb) != 0) {
+	if (fd >= 0)
+	    close(fd);
+	bst_errno = BST_ERR_MAP_IO;
+	return (FALSE);
+    }
+
+    /* The file must be one of bst_save from a library with the same nodes: */
+    if (read(fd, &m, sizeof(m)) != sizeof(m) || memcmp(m.tm_magic, MAP_MAGIC, sizeof(m.tm_magic)) != 0
+	|| m.tm_version != MAP_VERSION || m.tm_nodesize != sizeof(t_node) || m.tm_order != MAP_ORDER
+	|| m.tm_ncnt < 0 || m.tm_usiz <= 0 || m.tm_stride < (long) sizeof(t_node) + m.tm_usiz
+	|| m.tm_offset < (long) sizeof(m) || m.tm_offset % NODE_ALIGN != 0
+	|| (m.tm_multi && (m.tm_moff < 0 || m.tm_moff % sizeof(long) != 0 || m.tm_moff > m.tm_usiz - (int) sizeof(long)))
+	|| (m.tm_ncnt > 0 && sb.st_size < m.tm_offset + m.tm_ncnt * m.tm_stride)) {
+	close(fd);
+	bst_errno = BST_ERR_MAP_FORMAT;
+	return (FALSE);
+    }
+    if (m.tm_key.tk_type == KEY_USER && compf == NULL) {
+	close(fd);
+	bst_errno = BST_ERR_NO_UCF_GIVEN;
+	return (FALSE);
+    }
+
+    if ((ph = (t_header *) tallocm(T_HEADER, sizeof(t_header))) == NULL) {
+	close(fd);
+	bst_errno = BST_ERR_MALLOC;
+	return (FALSE);
+    }
+    ph->th_clist = EMPTY_LIST;
+    ph->th_map = NULL;
+    ph->th_wal = NULL;
+    ph->th_cmp = NULL;
+    ph->th_gen = 0;
+    ph->th_frag = 0;
+    ph->th_rep = NULL;
+    ph->th_numa = NUMA_LOCAL;
+    ph->th_rmcnt = 0;
+    ph->th_mlen = 0;
+    base = NULL;
+    if (m.tm_ncnt > 0
+	&& (base = (t_node *) tallocm(T_MAP, ph, fd, (long) sb.st_size, m.tm_offset, m.tm_ncnt, m.tm_stride)) == NULL) {
+	close(fd);
+	tfreem(T_HEADER, ph);
+	return (FALSE);
+    }
+    close(fd);
+
+    /* Initialize the new tree header as bst_create does, from the file: */
+    strcpy(ph->th_name, tname);
+    ph->th_bsttype = m.tm_bsttype;
+    ph->th_root = base;
+    ph->th_flist = EMPTY_LIST;
+    ph->th_slab = NULL;
+    ph->th_frz = base;
+    ph->th_fidx = NULL;
+    ph->th_id = m.tm_id;	/* the nodes in the file are marked with it */
+    ph->th_flcnt = 0;
+    ph->th_frozen = TRUE;
+    ph->th_var = m.tm_var;
+    ph->th_multi = m.tm_multi;
+    ph->th_moff = m.tm_moff;
+    ph->th_mrel = base != NULL;
+    ph->th_stat = TREE_VERIFY_NO;
+    ph->th_usiz = m.tm_usiz;
+    ph->th_ucf = compf;
+    ph->th_key = m.tm_key;
+    ph->th_pfxf = NULL;
+    ph->th_kcf = NULL;
+    ph->th_aggf = NULL;	/* a function is not in the file; see bst_aggregate */
+    ph->th_aoff = 0;
+    ph->th_asiz = 0;
+    ph->th_pfx = m.tm_pfx;
+    ph->th_upf = prntf;
+    ph->th_ncnt = m.tm_ncnt;
+    ph->th_np = FALSE;
+    memcpy(ph->th_version_id, m.tm_version_id, MAX_ID_LEN);
+    ph->th_version_id[MAX_ID_LEN] = '\0';
+    ph->th_reserved1 = 0;
+    ph->th_reserved2 = 0;
+
+    ph->th_link = t_head;
+    t_head = ph;
+    return (TRUE);
+}
+
+/* tmaplinks: turn the links of the nodes of a mapped tree file into addresses */
+void tmaplinks(t_header * ph)
+{
+ /*******************************************************************************
+  *  A private library function called by every call that follows the links of
+  *  a tree that may come from bst_open_mapped. The first such call writes the
+  *  address of each node linked to over the offset to it in the file, in the
+  *  private copy of the pages; later calls, and calls on any other tree, do
+  *  nothing.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record for this tree.
+  *
+  *  Output Parameters
+  *  =================
+  *  None.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    long k;
+    t_node *p;
+
+    if (!ph->th_mrel)
+	return;
+    for (k = 1; k <= ph->th_ncnt; k++) {
+	p = FSLOT(ph, k);
+	p->tn_ulink = MAPLINK(p, p->tn_ulink);
+	p->tn_llink = MAPLINK(p, p->tn_llink);
+	p->tn_rlink = MAPLINK(p, p->tn_rlink);
+    }
+    ph->th_mrel = FALSE;
+}
+
+/* tsave: write the frozen tree ph to path */
+static Boolean tsave(t_header * ph, char *path)
+{
+    t_mapfile m;
+    t_node n, *p;
+    char tmp[PATH_MAX];
+    FILE *fp;
+    long k;
+    int err;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int) sizeof(tmp) || (fp = fopen(tmp, "wb")) == NULL) {
+	bst_errno = BST_ERR_MAP_IO;
+	return (FALSE);
+    }
+
+    memset(&m, 0, sizeof(m));
+    memcpy(m.tm_magic, MAP_MAGIC, sizeof(m.tm_magic));
+    m.tm_version = MAP_VERSION;
+    m.tm_nodesize = sizeof(t_node);
+    m.tm_order = MAP_ORDER;
+    m.tm_id = ph->th_id;
+    m.tm_ncnt = ph->th_ncnt;
+    m.tm_stride = ph->th_ncnt > 0 ? ph->th_clist->tc_stride : (long) sizeof(t_node) + ph->th_usiz;
+    m.tm_offset = (sizeof(m) + MAP_ALIGN - 1) / MAP_ALIGN * MAP_ALIGN;
+    m.tm_usiz = ph->th_usiz;
+    m.tm_bsttype = ph->th_bsttype;
+    m.tm_key = ph->th_key;
+    m.tm_pfx = ph->th_pfx && ph->th_pfxf == NULL;
+    m.tm_var = ph->th_var;
+    m.tm_multi = ph->th_multi;
+    m.tm_moff = ph->th_moff;
+    memcpy(m.tm_version_id, ph->th_version_id, sizeof(m.tm_version_id));
+    fwrite(&m, sizeof(m), 1, fp);
+    tpad(fp, m.tm_offset - sizeof(m));
+
+    /* the slots in order, each a whole stride, their links made offsets: */
+    for (k = 1; k <= ph->th_ncnt; k++) {
+	p = FSLOT(ph, k);
+	n = *p;
+	if (!ph->th_mrel) {
+	    n.tn_ulink = MAPOFF(p, p->tn_ulink);
+	    n.tn_llink = MAPOFF(p, p->tn_llink);
+	    n.tn_rlink = MAPOFF(p, p->tn_rlink);
+	}
+	fwrite(&n, sizeof(t_node), 1, fp);
+	fwrite(p + 1, p->tn_usiz, 1, fp);
+	tpad(fp, m.tm_stride - sizeof(t_node) - p->tn_usiz);
+    }
+
+    err = ferror(fp);
+    if (fclose(fp) != 0 || err || rename(tmp, path) != 0) {
+	unlink(tmp);
+	bst_errno = BST_ERR_MAP_IO;
+	return (FALSE);
+    }
+    return (TRUE);
+}
+
+/* tpad: write n zero bytes */
+static void tpad(FILE * fp, long n)
+{
+    while (n-- > 0)
+	putc('\0', fp);
+}
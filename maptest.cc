@@ -0,0 +1,143 @@
+/*
+  +------------------------------------------------------------------------+
+  | maptest is a terminal program testing bst::avl_map and bst::avl_set of |
+  | avl_map.hpp against std::map and std::set.                             |
+  |                                                                        |
+  | Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net            |
+  |                                                                        |
+  | This program is free software: you can redistribute it and/or modify   |
+  | it under the terms of the GNU General Public License as published by   |
+  | the Free Software Foundation, either version 3 of the License, or      |
+  | (at your option) any later version.                                    |
+  |                                                                        |
+  | This program is distributed in the hope that it will be useful,        |
+  | but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+  | MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+  | GNU General Public License for more details.                           |
+  |                                                                        |
+  | You should have received a copy of the GNU General Public License      |
+  | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+  +------------------------------------------------------------------------+
+*/
+
+/*
+ * maptest makes the same random inserts and erases on a bst::avl_map and a
+ * std::map, then on a bst::avl_set and a std::set, and every so often checks
+ * that both hold the same values in the same order and that the nodes of
+ * libbst still have the links, tags and balance factors of an AVL tree
+ * (verify()). It prints a success line per section, as test does, and exits
+ * with the number of sections that failed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <set>
+
+#include "avl_map.hpp"
+
+/* bstpkg.h after avl_map.hpp, so the two are seen to go together in either order */
+#include "leaf.h"
+#include "bstpkg.h"
+
+#define  OPS      200000	/* inserts and erases of each section */
+#define  KEYS     4000		/* keys drawn from 0..KEYS-1 */
+#define  CHECK    1000		/* operations between checks */
+
+static char *RCSid[] = { (char *) "$Id$" };
+
+static_assert(sizeof(bst::tree_stats) == sizeof(BstStats), "tree_stats is not the layout of BstStats");
+
+/* same: whether a and b hold equal values in the same order */
+template <class A, class B> static bool same(const A & a, const B & b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), b.end());
+}
+
+int main(void)
+{
+    long i, k, lost, failed;
+    bst::avl_map<long, long> m;
+    std::map<long, long> sm;
+    bst::avl_set<long> s;
+    std::set<long> ss;
+
+    srand(1);
+    failed = 0;
+
+    printf("------------------ begin avl_map of [%d] operations -----------------------\n", OPS);
+    for (lost = 0, i = 1; i <= OPS; i++) {
+	k = rand() % KEYS;
+	switch (rand() % 4) {
+	case 0:		/* insert or, if there, leave be */
+	    if (m.emplace(k, i).second != sm.emplace(k, i).second)
+		lost++;
+	    break;
+	case 1:		/* insert or assign */
+	    m[k] = i;
+	    sm[k] = i;
+	    break;
+	case 2:		/* erase by key */
+	    if (m.erase(k) != sm.erase(k))
+		lost++;
+	    break;
+	case 3:		/* erase by iterator, the one found or the one after it */
+	    {
+		auto it = m.lower_bound(k);
+		auto sit = sm.lower_bound(k);
+		if ((it == m.end()) != (sit == sm.end()))
+		    lost++;
+		else if (it != m.end()) {
+		    if (it->first != sit->first)
+			lost++;
+		    it = m.erase(it);
+		    sit = sm.erase(sit);
+		    if ((it == m.end()) != (sit == sm.end()) || (it != m.end() && it->first != sit->first))
+			lost++;
+		}
+	    }
+	    break;
+	}
+	if (i % CHECK == 0 && (!m.verify() || !same(m, sm)))
+	    lost++;
+    }
+    {
+	bst::avl_map<long, long> c(m);	/* a copy has the shape and values of m */
+	if (!c.verify() || !same(c, sm))
+	    lost++;
+    }
+    m.erase(m.begin(), m.lower_bound(KEYS / 2));
+    sm.erase(sm.begin(), sm.lower_bound(KEYS / 2));
+    if (!m.verify() || !same(m, sm) || m.stats().st_remove == 0)
+	lost++;
+    if (lost != 0) {
+	printf("\007  ### %ld CHECKS OF avl_map FAILED ###\n\n", lost);
+	failed++;
+    } else
+	printf("success: avl_map kept the values of std::map, balanced, through %d inserts and erases\n", OPS);
+    printf("------------------- end of avl_map -------------------------\n\n\n");
+
+    printf("------------------ begin avl_set of [%d] operations -----------------------\n", OPS);
+    for (lost = 0, i = 1; i <= OPS; i++) {
+	k = rand() % KEYS;
+	/* more inserts than erases first, so the set grows, then the other way round */
+	if (rand() % 8 < (i <= OPS / 2 ? 5 : 3)) {
+	    if (s.insert(k).second != ss.insert(k).second)
+		lost++;
+	} else if (s.erase(k) != ss.erase(k))
+	    lost++;
+	if (i % CHECK == 0 && (!s.verify() || !same(s, ss)))
+	    lost++;
+    }
+    s.clear();
+    if (!s.verify() || !s.empty())
+	lost++;
+    if (lost != 0) {
+	printf("\007  ### %ld CHECKS OF avl_set FAILED ###\n\n", lost);
+	failed++;
+    } else
+	printf("success: avl_set kept the values of std::set, balanced, through %d inserts and erases\n", OPS);
+    printf("------------------- end of avl_set -------------------------\n\n\n");
+
+    return ((int) failed);
+}
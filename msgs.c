@@ -24,7 +24,7 @@
 #endif
 
 #define BASE   100		/* lower bound on the error numbers for indexing */
-#define UPPER  125		/* last used error number in list of error msgs. */
+#define UPPER  148		/* last used error number in list of error msgs. */
 
 t_header *find_header(char *);
 
@@ -78,8 +78,32 @@ char *bst_errmsg(int n)
 	/* 122 */ "trying to compare 2 trees with different data structures",
 	/* 123 */ "tree name too short for first tree parameter",
 	/* 124 */ "tree name too short for second tree parameter",
-	/* 125 */ "undefined error number"
+	/* 125 */ "tree type is not AVL or BST",
+	/* 126 */ "tn_ulink of a node does not point to its parent",
+	/* 127 */ "keys in tree are out of order",
+	/* 128 */ "node count in tree header differs from the tree",
+	/* 129 */ "tree is frozen; bst_thaw it first",
+	/* 130 */ "key descriptor has a bad type, offset or length",
+	/* 131 */ "key prefix of a node is wrong or out of order",
+	/* 132 */ "tree has no built in key or key compare function (see bst_key_compare)",
+	/* 133 */ "leaf size is not 1 to the tree's leaf size or cuts off the built in key or aggregate",
+	/* 134 */ "cannot create, write, open or map the tree file",
+	/* 135 */ "file is not a tree file of this build of libbst",
+	/* 136 */ "tree dump is cut short, out of order or fails its checksum",
+	/* 137 */ "cannot open, write or sync the write ahead log",
+	/* 138 */ "tree has no write ahead log (see bst_wal_open)",
+	/* 139 */ "fragmentation to compact at is not from 0 up to 1 (see bst_compact_auto)",
+	/* 140 */ "allocator has only one of a pair of alloc and free functions (see bst_allocator)",
+	/* 141 */ "NUMA placement policy is not one of NumaPolicy (see bst_numa)",
+	/* 142 */ "tree changed since the cursor was made (see bst_equal_range)",
+	/* 143 */ "subtree node count of a node of a multimap is wrong",
+	/* 144 */ "aggregate is not within the leaf or is over AGG_MAX bytes (see bst_aggregate)",
+	/* 145 */ "tree has no aggregate function (see bst_aggregate)",
+	/* 146 */ "aggregate of a node is not that of its leaf and the aggregates of its sons",
+	/* 147 */ "subtree count is not a long aligned within the leaf, or overlaps the aggregate (see bst_multimap)",
+	/* 148 */ "a multimap can not have a write ahead log: replaying a record twice would change it twice",
+	/* --- */ "undefined error number"
     };
 
-    return (n < BASE || n > UPPER) ? bst_errmsgs[UPPER - BASE] : bst_errmsgs[n - BASE];
+    return (n < BASE || n > UPPER) ? bst_errmsgs[UPPER - BASE + 1] : bst_errmsgs[n - BASE];
 }
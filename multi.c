@@ -0,0 +1,484 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+static long tbelow(t_header * ph, void *pl, Boolean equal);
+static void tsub(t_header * ph, t_node * p);
+
+
+/* bst_multimap: let a tree keep equal keys, in the order they were put */
+Boolean bst_multimap(char *tname, Boolean on, int offset)
+{
+ /*******************************************************************************
+  *  A user acccessible function that lets a tree hold any number of nodes of
+  *  equal keys, e.g. events of a stream that share a timestamp, rather than
+  *  bst_put failing with BST_ERR_DUPLICATE_KEY, so no sequence number needs
+  *  to be made part of the key. Nodes of equal keys stay in the order they were
+  *  put: a new one goes after the others, bst_get, bst_find_key and bst_remove
+  *  take the first of them, so they come and go first in first out.
+  *  bst_equal_range hands back a cursor over all of them and bst_count_key
+  *  their number.
+  *
+  *  Each node of a multimap keeps the number of nodes in its subtree, set again
+  *  on the path up from an insert or remove and by the rotations, so
+  *  bst_count_key takes O(log n) and bst_put and bst_remove stay O(log n). The
+  *  count is a long at offset in each leaf, a field the library owns as it does
+  *  an aggregate (see bst_aggregate), so no other tree pays for it in its
+  *  nodes. Turning it on counts the subtrees of the nodes there already, O(n);
+  *  it can not be turned off while the tree holds equal keys. A tree with a
+  *  write ahead log can not be made a multimap, as the log could not be
+  *  replayed over a checkpoint (see bst_wal_open).
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *  on         : TRUE to keep equal keys, FALSE to refuse them again.
+  *  offset     : Offset of the subtree count in a leaf, a multiple of
+  *               sizeof(long); not used if on is FALSE.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree keeps equal keys, or refuses them.
+  *  FALSE      : Tree not defined, it has a write ahead log and on is TRUE,
+  *               the count is not within leafsize bytes, not aligned or
+  *               overlaps the aggregate, a leaf of the tree is too short for
+  *               it, or it holds equal keys and on is FALSE.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+    t_node *p, *prev;
+
+    extern t_header *find_header(char *);
+    extern void tmaplinks(t_header * ph);
+    extern void tsubcount(t_header * ph, t_node * root);
+    extern Boolean tleafmin(t_header * ph, int size);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    tmaplinks(ph);
+
+    if (on) {
+	if (ph->th_wal != NULL) {
+	    bst_errno = BST_ERR_WAL_MULTIMAP;
+	    return (FALSE);
+	}
+	if (offset < 0 || offset % sizeof(long) != 0 || offset > ph->th_usiz - (int) sizeof(long)
+	    || (ph->th_aggf != NULL && offset < ph->th_aoff + ph->th_asiz
+		&& ph->th_aoff < offset + (int) sizeof(long))) {
+	    bst_errno = BST_ERR_COUNT_FIELD;
+	    return (FALSE);
+	}
+	if (!tleafmin(ph, offset + sizeof(long))) {
+	    bst_errno = BST_ERR_LEAF_SIZE;
+	    return (FALSE);
+	}
+	ph->th_moff = offset;
+	ph->th_multi = TRUE;
+	if (ph->th_root != NULL)
+	    tsubcount(ph, ph->th_root);
+	return (TRUE);
+    }
+
+    /* no two keys next to each other in order may be equal: */
+    prev = NULL;
+    if ((p = ph->th_root) != NULL)
+	while (p->tn_llink != NULL)
+	    p = p->tn_llink;
+    while (p != NULL) {
+	if (prev != NULL && TCMP(ph, prev + 1, p + 1) == 0) {
+	    bst_errno = BST_ERR_DUPLICATE_KEY;
+	    return (FALSE);
+	}
+	prev = p;
+	if (p->tn_rlink != NULL)
+	    for (p = p->tn_rlink; p->tn_llink != NULL; p = p->tn_llink);
+	else {
+	    while (p->tn_tag == RIGHT_SON)
+		p = p->tn_ulink;
+	    p = p->tn_ulink;
+	}
+    }
+    ph->th_multi = FALSE;
+    return (TRUE);
+}
+
+/* bst_count_key: number of nodes of a tree with the key of a leaf */
+long bst_count_key(char *tname, void *pl)
+{
+ /*******************************************************************************
+  *  A user acccessible function that counts the nodes whose key is equal to
+  *  that of pl. In a multimap it is the number of nodes before the last of them
+  *  less the number before the first, each found by one descent adding up the
+  *  subtree counts of the nodes passed on the left: O(log n) however many there
+  *  are. In any other tree it is 0 or 1.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *  pl         : Pointer to a leaf of the tree holding the key, as for bst_get.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns the number of nodes with the key, or -1 if the tree
+  *  is not defined or pl is not of it.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+
+    extern t_header *find_header(char *);
+    extern void tmaplinks(t_header * ph);
+    extern t_node *tedge(t_header * ph, void *pl, Boolean last);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (-1);
+    }
+    if (ph->th_id != (((t_node *) pl) - 1)->tn_id) {
+	bst_errno = BST_ERR_TREE_NODE_MISMATCH;
+	return (-1);
+    }
+    tmaplinks(ph);
+
+    if (ph->th_multi)
+	return (tbelow(ph, pl, TRUE) - tbelow(ph, pl, FALSE));
+    return (tedge(ph, pl, FALSE) == NULL ? 0 : 1);
+}
+
+/* bst_equal_range: make a cursor over the nodes of a tree with the key of a leaf */
+Boolean bst_equal_range(char *tname, void *pl, t_cursor * pc)
+{
+ /*******************************************************************************
+  *  A user acccessible function that sets *pc to the run of nodes whose key is
+  *  equal to that of pl, in order: in a multimap, in the order they were put.
+  *  bst_cursor_next then hands back a copy of each in turn. tu_count is the
+  *  number of them. The cursor holds on to nodes of the tree, so any bst_put,
+  *  bst_remove, bst_freeze or bst_compact of the tree after it was made ends
+  *  it: bst_cursor_next fails with BST_ERR_CURSOR_STALE. It needs no freeing.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *  pl         : Pointer to a leaf of the tree holding the key, as for bst_get.
+  *
+  *  Output Parameters
+  *  =================
+  *  pc         : The cursor; at its end, with tu_count 0, if no node has the key.
+  *  Function name returns Boolean result:
+  *  TRUE       : At least one node has the key.
+  *  FALSE      : None has, tree not defined, or pl not of it.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+    t_node *first;
+
+    extern t_header *find_header(char *);
+    extern void tmaplinks(t_header * ph);
+    extern t_node *tedge(t_header * ph, void *pl, Boolean last);
+
+    bst_errno = BST_ERR_RESET;
+
+    pc->tu_next = pc->tu_last = NULL;
+    pc->tu_count = 0;
+    pc->tu_gen = 0;
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    if (ph->th_id != (((t_node *) pl) - 1)->tn_id) {
+	bst_errno = BST_ERR_TREE_NODE_MISMATCH;
+	return (FALSE);
+    }
+    tmaplinks(ph);
+    pc->tu_gen = ph->th_gen;
+
+    if ((first = tedge(ph, pl, FALSE)) == NULL) {
+	bst_errno = BST_ERR_KEY_NOT_FOUND;
+	return (FALSE);
+    }
+    pc->tu_next = first;
+    if (ph->th_multi) {
+	pc->tu_last = tedge(ph, pl, TRUE);
+	pc->tu_count = tbelow(ph, pl, TRUE) - tbelow(ph, pl, FALSE);
+    } else {
+	pc->tu_last = first;
+	pc->tu_count = 1;
+    }
+    return (TRUE);
+}
+
+/* bst_cursor_next: return a copy of the next node of a cursor to user */
+void *bst_cursor_next(char *tname, t_cursor * pc)
+{
+ /*******************************************************************************
+  *  A user acccessible function that hands back a copy of the node the cursor
+  *  from bst_equal_range is at, as bst_get would, and moves the cursor on to
+  *  the next node in order. The copy is given back with bst_release.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree the cursor was made for.
+  *  pc         : The cursor.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns pointer to a copy of the node or NULL at the end of
+  *  the run (BST_ERR_KEY_NOT_FOUND), if the tree has changed since the cursor
+  *  was made (BST_ERR_CURSOR_STALE), or on error.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+    t_node *p, *pcopy;
+
+    extern t_header *find_header(char *);
+    extern void *tallocm(MallocTypes mkind, ...);
+    extern void tcopym(t_header * ph, t_node * to, t_node * from);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (NULL);
+    }
+    if (pc->tu_gen != ph->th_gen) {
+	bst_errno = BST_ERR_CURSOR_STALE;
+	return (NULL);
+    }
+    if ((p = (t_node *) pc->tu_next) == NULL) {
+	bst_errno = BST_ERR_KEY_NOT_FOUND;
+	return (NULL);
+    }
+    if ((pcopy = (t_node *) tallocm(T_NODE, ph, p->tn_usiz)) == NULL) {
+	bst_errno = BST_ERR_MALLOC;
+	return (NULL);
+    }
+    tcopym(ph, pcopy, p);
+
+    /* on to the next node in order, unless this was the last of the run: */
+    if (p == (t_node *) pc->tu_last)
+	p = NULL;
+    else if (p->tn_rlink != NULL)
+	for (p = p->tn_rlink; p->tn_llink != NULL; p = p->tn_llink);
+    else {
+	while (p->tn_tag == RIGHT_SON)
+	    p = p->tn_ulink;
+	p = p->tn_ulink;
+    }
+    pc->tu_next = p;
+
+    return (pcopy + 1);
+}
+
+/* tedge: the first, or last, node of a tree with the key of pl, or NULL */
+t_node *tedge(t_header * ph, void *pl, Boolean last)
+{
+ /*******************************************************************************
+  *  A private library function that goes down the tree as find_node does, but
+  *  at a node with the key it notes the node and goes on left for the first,
+  *  right for the last, of a run of equal keys in a multimap.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record of the tree; its links must be
+  *               addresses (see tmaplinks).
+  *  pl         : Users data area with the key to find.
+  *  last       : TRUE for the last node with the key, FALSE for the first.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns the node or NULL if no node has the key.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    int cmpresult;
+    unsigned long ncmp, npfx, kp;
+    t_node *p, *r;
+
+    ncmp = npfx = 0;
+    kp = ph->th_pfx ? TPFX(ph, pl) : 0;
+    for (p = ph->th_root, r = NULL; p != NULL;) {
+	if ((cmpresult = tpcmp(ph, kp, pl, p, &ncmp, &npfx)) == 0) {
+	    r = p;
+	    if (!ph->th_multi)
+		break;
+	}
+	p = cmpresult < 0 || (cmpresult == 0 && !last) ? p->tn_llink : p->tn_rlink;
+    }
+    STAT_ADD(STATS(ph), st_cmp, ncmp);
+    STAT_ADD(STATS(ph), st_pfx, npfx);
+    return (r);
+}
+
+/* tbelow: number of nodes of a multimap before the key of pl, or not after it if equal */
+static long tbelow(t_header * ph, void *pl, Boolean equal)
+{
+    int cmpresult;
+    unsigned long ncmp, npfx, kp;
+    long n;
+    t_node *p;
+
+    ncmp = npfx = 0;
+    kp = ph->th_pfx ? TPFX(ph, pl) : 0;
+    for (p = ph->th_root, n = 0; p != NULL;) {
+	cmpresult = tpcmp(ph, kp, pl, p, &ncmp, &npfx);
+	if (cmpresult > 0 || (cmpresult == 0 && equal)) {
+	    n += NSUB(ph, p->tn_llink) + 1;
+	    p = p->tn_rlink;
+	} else
+	    p = p->tn_llink;
+    }
+    STAT_ADD(STATS(ph), st_cmp, ncmp);
+    STAT_ADD(STATS(ph), st_pfx, npfx);
+    return (n);
+}
+
+/* tsubup: set again the subtree counts and aggregates from node p up to the root */
+void tsubup(t_header * ph, t_node * p)
+{
+ /*******************************************************************************
+  *  A private library function for bst_put and bst_remove, called on the node
+  *  inserted, or the parent of the node unlinked, before any rotation. Each
+  *  node on the path gets the count of its sons plus one and, if the tree has
+  *  an aggregate (see bst_aggregate), that of its leaf and the aggregates of
+  *  its sons; the subtrees off the path have not changed. Then tsubtop puts
+  *  right the nodes each rotation moves. Nothing is done for a tree that is
+  *  neither a multimap nor has an aggregate.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record of the tree.
+  *  p          : Lowest node whose subtree has changed, or NULL.
+  *
+  *  Output Parameters
+  *  =================
+  *  None.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    if (!ph->th_multi && ph->th_aggf == NULL)
+	return;
+    for (; p != NULL; p = p->tn_ulink)
+	tsub(ph, p);
+}
+
+/* tsubtop: set again the subtree counts and aggregates of the top p of a rotated subtree and its sons */
+void tsubtop(t_header * ph, t_node * p)
+{
+    if (!ph->th_multi && ph->th_aggf == NULL)
+	return;
+    if (p->tn_llink != NULL)
+	tsub(ph, p->tn_llink);
+    if (p->tn_rlink != NULL)
+	tsub(ph, p->tn_rlink);
+    tsub(ph, p);
+}
+
+/* tsubcount: set the subtree counts and aggregates of every node of the subtree at root, in postorder */
+void tsubcount(t_header * ph, t_node * root)
+{
+    t_node *p;
+
+    for (p = root;;) {
+	/* down to the first node in postorder below p: */
+	while (p->tn_llink != NULL || p->tn_rlink != NULL)
+	    p = p->tn_llink != NULL ? p->tn_llink : p->tn_rlink;
+
+	/* then up, counting each node once its sons are, until a right subtree is left to do */
+	for (;;) {
+	    tsub(ph, p);
+	    if (p == root)
+		return;
+	    if (p->tn_tag == LEFT_SON && p->tn_ulink->tn_rlink != NULL) {
+		p = p->tn_ulink->tn_rlink;
+		break;
+	    }
+	    p = p->tn_ulink;
+	}
+    }
+}
+
+/* tleafmin: whether every leaf of a tree has at least size bytes */
+Boolean tleafmin(t_header * ph, int size)
+{
+    t_node *p;
+
+    /* only leaves of variable size can be short: */
+    if (!ph->th_var || (p = ph->th_root) == NULL)
+	return (size <= ph->th_usiz);
+    while (p->tn_llink != NULL)
+	p = p->tn_llink;
+    while (p != NULL) {
+	if (p->tn_usiz < size)
+	    return (FALSE);
+	if (p->tn_rlink != NULL)
+	    for (p = p->tn_rlink; p->tn_llink != NULL; p = p->tn_llink);
+	else {
+	    while (p->tn_tag == RIGHT_SON)
+		p = p->tn_ulink;
+	    p = p->tn_ulink;
+	}
+    }
+    return (TRUE);
+}
+
+/* tsub: set the subtree count of node p, if a multimap, and its aggregate if any, from those of its sons */
+static void tsub(t_header * ph, t_node * p)
+{
+    if (ph->th_multi)
+	TNSUB(ph, p) = NSUB(ph, p->tn_llink) + NSUB(ph, p->tn_rlink) + 1;
+    if (ph->th_aggf != NULL)
+	ph->th_aggf(TAGG(ph, p), TAGG(ph, p->tn_llink), p + 1, TAGG(ph, p->tn_rlink));
+}
@@ -69,7 +69,7 @@ void *bst_alloc(char *tname)
 
     /* check if any nodes for this tree is available from the th_flist */
     /* if not, make up a new one                                       */
-    if ((pn = (t_node *) tallocm(T_NODE, ph)) == NULL)
+    if ((pn = (t_node *) tallocm(T_NODE, ph, ph->th_usiz)) == NULL)
 	return (pn);
 
     /* Initialize header node */
@@ -81,3 +81,105 @@ void *bst_alloc(char *tname)
 
     return (void *) (pn + 1);	/* points to the users data area */
 }
+
+/* bst_alloc_size: allocate a tree node of size bytes back to the user */
+void *bst_alloc_size(char *tname, int size)
+{
+ /*******************************************************************************
+  *  A user acccessible function that is bst_alloc for a leaf of size bytes, up
+  *  to the leafsize the tree was created with, so a tree whose leaves vary in
+  *  length does not pad each one to the longest. A node smaller than leafsize
+  *  is carved from a slab of nodes of its size class; bst_put copies it into a
+  *  node of the same class and bst_get hands back a copy of the same size, and
+  *  bst_leaf_size tells what that size is. The slabs go back to the system by
+  *  bst_delete only, so such nodes held by the user are good until then. The
+  *  user's compare, prefix and print functions must read no more of a leaf
+  *  than its size; a built in key, and the aggregate of bst_aggregate, must
+  *  lie within it.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree to get a node from.
+  *  size       : Bytes of users data of the node, 1 to leafsize.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns zero-filled tree node, or NULL.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_node *pn;
+    t_header *ph;
+    t_key *pk;
+
+    extern void *tallocm(MallocTypes mkind, ...);
+    extern t_header *find_header(char *);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (TREE_NOT_DEFINED);
+    }
+    pk = &ph->th_key;
+    if (size <= 0 || size > ph->th_usiz || (pk->tk_type != KEY_USER && size < pk->tk_offset + tksize(pk))
+	|| (ph->th_aggf != NULL && size < ph->th_aoff + ph->th_asiz)
+	|| (ph->th_multi && size < ph->th_moff + (int) sizeof(long))) {
+	bst_errno = BST_ERR_LEAF_SIZE;
+	return (NULL);
+    }
+    if ((pn = (t_node *) tallocm(T_NODE, ph, size)) == NULL)
+	return (pn);
+
+    pn->tn_llink = NULL;
+    pn->tn_rlink = NULL;
+    pn->tn_ulink = NULL;
+    pn->tn_id = ph->th_id;	/* mark the tree owner of this node ! */
+    pn->tn_bf = 0;
+
+    return (void *) (pn + 1);	/* points to the users data area */
+}
+
+/* bst_leaf_size: bytes of users data of a node of a tree */
+int bst_leaf_size(char *tname, void *pl)
+{
+ /*******************************************************************************
+  *  A user acccessible function that gives the size of a leaf from bst_alloc,
+  *  bst_alloc_size or bst_get, for one the user's print function is handed
+  *  or, in a tree of varying leaf sizes, to know how much of a copy is there.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree of the node.
+  *  pl         : Pointer to the users data area of the node.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns the bytes of users data, or -1 on error.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_node *pn;
+    t_header *ph;
+
+    extern t_header *find_header(char *);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (-1);
+    }
+    pn = ((t_node *) pl) - 1;
+    if (ph->th_id != pn->tn_id) {
+	bst_errno = BST_ERR_TREE_NODE_MISMATCH;
+	return (-1);
+    }
+    return (pn->tn_usiz);
+}
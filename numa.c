@@ -0,0 +1,264 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <unistd.h>
+#include <limits.h>
+#ifdef BST_NUMA
+#include <numa.h>
+#include <numaif.h>
+#endif
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+void tnumaplace(t_header * ph, void *p, long bytes);
+void trepmake(t_header * ph);
+void trepfree(t_header * ph);
+extern void *tmalloc(t_header * ph, size_t size);
+extern void tmfree(t_header * ph, void *p);
+
+
+/* bst_numa: place the nodes of a tree on the NUMA nodes of the machine */
+Boolean bst_numa(char *tname, int policy)
+{
+ /*******************************************************************************
+  *  A user acccessible function that sets where the memory of a tree's nodes
+  *  is on a machine of more than one NUMA node, where memory of another node
+  *  is slower to reach than that of the node a thread runs on. A tree starts
+  *  out NUMA_LOCAL: each page is on the node of the thread that first touched
+  *  it, so a tree built by one thread is all on that thread's node and every
+  *  search from another node is a remote one.
+  *
+  *  NUMA_INTERLEAVE spreads the pages of the chunks and slabs of the tree over
+  *  all nodes in turn, those there now (they are moved) and those to come, so
+  *  a search from any node finds about as many of its nodes near as far. It
+  *  does not place nodes malloc'd by themselves (see bst_huge_pages) or the
+  *  memory of an allocator of the user (see bst_allocator).
+  *
+  *  NUMA_REPLICATE gives a frozen tree a copy of its frozen layout, and of the
+  *  keys of its key index (see bst_freeze_keys), on each node, and bst_get and
+  *  bst_find_key search the copy on the node of the calling thread, so every
+  *  search is local. The copies are made whenever the tree is frozen from now
+  *  on, and freed when it is thawed; they cost the bytes of the layout once
+  *  per node. A tree that is not frozen is placed as NUMA_LOCAL meanwhile.
+  *  Going back to NUMA_LOCAL frees the copies; pages already interleaved are
+  *  left where they are.
+  *
+  *  Placement is done with libnuma, where the library was built with it (see
+  *  LIB_NUMA in the Makefile) and the kernel supports it. Otherwise the policy
+  *  is kept but nothing is placed or copied, so a program need not know.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *  policy     : NumaPolicy: NUMA_LOCAL, NUMA_INTERLEAVE or NUMA_REPLICATE.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree is placed by policy.
+  *  FALSE      : Tree not defined or no such policy.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+    t_chunk *pc;
+
+    extern t_header *find_header(char *);
+    extern void tmaplinks(t_header * ph);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    if (policy != NUMA_LOCAL && policy != NUMA_INTERLEAVE && policy != NUMA_REPLICATE) {
+	bst_errno = BST_ERR_NUMA_POLICY;
+	return (FALSE);
+    }
+    trepfree(ph);
+    ph->th_numa = policy;
+
+    /* The pages the tree has now are moved; tallocm places those it gets later: */
+    if (policy == NUMA_INTERLEAVE) {
+	for (pc = ph->th_clist; pc != NULL; pc = pc->tc_link)
+	    tnumaplace(ph, pc, pc->tc_bytes);
+	if (ph->th_slab != NULL) {
+	    for (pc = ph->th_slab->ts_list; pc != NULL; pc = pc->tc_link)
+		tnumaplace(ph, pc, pc->tc_bytes);
+	    for (pc = ph->th_slab->ts_huge; pc != NULL; pc = pc->tc_link)
+		tnumaplace(ph, pc, pc->tc_bytes);
+	}
+    } else if (policy == NUMA_REPLICATE && ph->th_frozen) {
+	tmaplinks(ph);
+	trepmake(ph);
+    }
+    return (TRUE);
+}
+
+/* tnumaplace: interleave the whole pages of bytes at p over the NUMA nodes if the tree is NUMA_INTERLEAVE */
+void tnumaplace(t_header * ph, void *p, long bytes)
+{
+ /*******************************************************************************
+  *  A private library function for tallocm and bst_numa, given a chunk or slab
+  *  of a tree. Only the pages wholly within it are placed, since the others
+  *  are shared with whatever malloc put next to it. Pages already touched are
+  *  moved; the others go to their node as they are first touched.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record of the tree.
+  *  p          : The memory.
+  *  bytes      : Its length.
+  *
+  *  Output Parameters
+  *  =================
+  *  None. Failure leaves the pages where they are.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+#ifdef BST_NUMA
+    unsigned long page, a, b;
+
+    if (ph->th_numa != NUMA_INTERLEAVE || ph->th_alloc.ta_alloc != NULL || numa_available() < 0)
+	return;
+    page = sysconf(_SC_PAGESIZE);
+    a = ((unsigned long) p + page - 1) & ~(page - 1);
+    b = ((unsigned long) p + bytes) & ~(page - 1);
+    if (b > a)
+	mbind((void *) a, b - a, MPOL_INTERLEAVE, numa_all_nodes_ptr->maskp, numa_all_nodes_ptr->size + 1,
+	      MPOL_MF_MOVE);
+#endif
+}
+
+/* trepmake: copy the frozen layout of a NUMA_REPLICATE tree to each NUMA node */
+void trepmake(t_header * ph)
+{
+ /*******************************************************************************
+  *  A private library function for bst_freeze, bst_freeze_keys and bst_numa.
+  *  Each copy is the th_ncnt slots of the frozen layout as they are, links
+  *  and all, so a node of a copy still links to the nodes of th_frz; only the
+  *  searches by slot index go through a copy. The keys of th_fidx follow the
+  *  slots on the next 64 byte boundary. The copies are allocated on their node
+  *  by libnuma, not by the allocator of the tree, and are made again from
+  *  scratch each time. A node that can not be given its copy searches th_frz.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record of a frozen tree whose links
+  *               are addresses (see tmaplinks).
+  *
+  *  Output Parameters
+  *  =================
+  *  None. th_rep is set if any copy was made.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+#ifdef BST_NUMA
+    t_replicas *pr;
+    long nodes, keys, bytes;
+    int n, c, made;
+    char *p;
+
+    trepfree(ph);
+    if (ph->th_numa != NUMA_REPLICATE || !ph->th_frozen || ph->th_ncnt == 0 || numa_available() < 0)
+	return;
+
+    nodes = (ph->th_ncnt * ph->th_clist->tc_stride + 63) & ~63L;
+    keys = ph->th_fidx == NULL ? 0 : ph->th_fidx->tf_nblocks * FRZ_KEYS * sizeof(long);
+    n = numa_max_node() + 1;
+    c = numa_num_configured_cpus();
+    bytes = sizeof(t_replicas) + n * (sizeof(t_node *) + sizeof(long *)) + c * sizeof(int);
+    if ((pr = (t_replicas *) tmalloc(ph, bytes)) == NULL)
+	return;
+    memset(pr, 0, bytes);
+    pr->tr_bytes = nodes + keys;
+    pr->tr_count = n;
+    pr->tr_frz = (t_node **) (pr + 1);
+    pr->tr_keys = (long **) (pr->tr_frz + n);
+    pr->tr_ncpu = c;
+    pr->tr_cpu = (int *) (pr->tr_keys + n);
+    for (made = 0, n = 0; n < pr->tr_count; n++) {
+	if (!numa_bitmask_isbitset(numa_all_nodes_ptr, n) || (p = (char *) numa_alloc_onnode(pr->tr_bytes, n)) == NULL)
+	    continue;
+	memcpy(p, ph->th_frz, ph->th_ncnt * ph->th_clist->tc_stride);
+	pr->tr_frz[n] = (t_node *) p;
+	if (keys > 0) {
+	    memcpy(p + nodes, ph->th_fidx->tf_keys, keys);
+	    pr->tr_keys[n] = (long *) (p + nodes);
+	}
+	made++;
+    }
+
+    /* the node of each cpu, looked up once here rather than by each search: */
+    for (c = 0; c < pr->tr_ncpu; c++)
+	pr->tr_cpu[c] = (n = numa_node_of_cpu(c)) >= 0 && n < pr->tr_count && pr->tr_frz[n] != NULL ? n : -1;
+    if (made == 0)
+	tmfree(ph, pr);
+    else
+	ph->th_rep = pr;
+#endif
+}
+
+/* trepfree: free the copies of the frozen layout of a tree, if any */
+void trepfree(t_header * ph)
+{
+#ifdef BST_NUMA
+    int n;
+
+    if (ph->th_rep == NULL)
+	return;
+    for (n = 0; n < ph->th_rep->tr_count; n++)
+	if (ph->th_rep->tr_frz[n] != NULL)
+	    numa_free(ph->th_rep->tr_frz[n], ph->th_rep->tr_bytes);
+    tmfree(ph, ph->th_rep);
+#endif
+    ph->th_rep = NULL;
+}
+
+/* trepof: the copy of the frozen layout of a tree for the NUMA node of this thread, or -1 for th_frz */
+int trepof(t_header * ph)
+{
+#ifdef BST_NUMA
+    int cpu;
+
+    if ((cpu = sched_getcpu()) >= 0 && cpu < ph->th_rep->tr_ncpu)
+	return (ph->th_rep->tr_cpu[cpu]);
+#endif
+    return (-1);
+}
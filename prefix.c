@@ -0,0 +1,104 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+
+/* bst_key_prefix: keep a fixed width prefix of the key in each node of a tree */
+Boolean bst_key_prefix(char *tname, unsigned long (*pfxf) (void *))
+{
+ /*******************************************************************************
+  *  A user acccessible function that makes each node of a tree carry a prefix of
+  *  its key as an unsigned long in its header, next to the links. A search then
+  *  compares the prefix of the search key with that of each node it passes as
+  *  an integer and calls the compare function only where the two are equal, so
+  *  most levels do not read the users data at all. A compare decided by the
+  *  prefixes is counted in st_pfx of bst_stats, one that was not in st_cmp.
+  *
+  *  pfxf must give the same order as the compare function wherever it gives
+  *  different values: pfxf(a) < pfxf(b) only if a sorts before b. Keys may
+  *  share a prefix, e.g. the first 8 characters of a string key, big endian.
+  *  For a tree created by bst_create_key, pfxf may be NULL and the library takes
+  *  the leading 8 bytes of the built in key, or an integer key whole.
+  *
+  *  The prefix takes 8 bytes in every node header, so it is there only in a
+  *  library built with BST_KEY_PREFIX (LIB_PREFIX in the Makefile); without
+  *  it the nodes carry none, as for a NULL pfxf on a tree with a compare
+  *  function, and the searches go by the compare function alone.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *  pfxf       : Pointer to user written prefix function, or NULL: the prefix
+  *               of the built in key, or for a tree with a compare function,
+  *               no prefixes.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The nodes carry the prefixes given by pfxf, or none.
+  *  FALSE      : Tree not defined.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+    t_node *p;
+
+    extern t_header *find_header(char *);
+    extern void tmaplinks(t_header * ph);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    tmaplinks(ph);
+
+    ph->th_pfxf = pfxf;
+    ph->th_pfx = KEY_PREFIX && (pfxf != NULL || ph->th_key.tk_type != KEY_USER);
+    if (!ph->th_pfx || (p = ph->th_root) == NULL)
+	return (TRUE);
+
+    /* set the prefix of every node, walking the tree in order by its links: */
+    while (p->tn_llink != NULL)
+	p = p->tn_llink;
+    while (p != NULL) {
+	TNPFX_SET(p, TPFX(ph, p + 1));
+	if (p->tn_rlink != NULL)
+	    for (p = p->tn_rlink; p->tn_llink != NULL; p = p->tn_llink);
+	else {
+	    while (p->tn_tag == RIGHT_SON)
+		p = p->tn_ulink;
+	    p = p->tn_ulink;
+	}
+    }
+    return (TRUE);
+}
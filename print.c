@@ -24,6 +24,7 @@
 #endif
 
 t_header *find_header(char *);
+void tmaplinks(t_header * ph);
 
 static char *RCSid[] = { "$Id$" };
 
@@ -68,6 +69,7 @@ void bst_print(char *tname)
 	bst_errno = BST_ERR_TREE_NOT_DEFINED;
 	return;
     }
+    tmaplinks(ph);
 
     /* now check if user has passed a printing function for this tree */
     if (ph->th_upf == NULL) {
@@ -28,6 +28,7 @@
 static char *RCSid[] = { "$Id: put.c,v 2.2 1999/01/27 02:24:25 roger Exp $" };
 
 extern int bst_errno;
+static Boolean do_put(char *tname, void *pl, Boolean adopt);
 
 
 /* bst_put: insert a new node into the tree */
@@ -46,25 +47,84 @@ Boolean bst_put(char *tname, void *pl)
   *  Output Parameters
   *  =================
   *  Function name returns Boolean result:
-  *  TRUE       : User node added to tree.
-  *  FALSE      : Tree not defined, node mismatch, or malloc error.
+  *  TRUE       : User node added to tree; in a multimap after any nodes of an
+  *               equal key (see bst_multimap).
+  *  FALSE      : Tree not defined or frozen, node mismatch, leaf too short
+  *               for the aggregate (see bst_aggregate) or the subtree count
+  *               of a multimap, duplicate key, the write ahead log not
+  *               written (see bst_wal_open), or malloc error.
   *
   *  Global Variables
   *  =================
   *  bst_errno  : Global error variable; reset on entry.
   *******************************************************************************/
 
+    Boolean r;
+    unsigned long t;
+
+    HIST_START(t);
+    r = do_put(tname, pl, FALSE);
+    HIST_STOP(H_PUT, t);
+    return (r);
+}
+
+/* bst_put_adopt: insert the user's node itself into the tree */
+Boolean bst_put_adopt(char *tname, void *pl)
+{
+ /*******************************************************************************
+  *  A user acccessible function that inserts a node from bst_alloc, or bst_get,
+  *  into the tree as it is rather than a copy of it: no node is allocated and
+  *  no users data copied. If it succeeds, the node belongs to the tree and the
+  *  user must neither change, bst_put, nor bst_release it; bst_get and
+  *  bst_remove find it by its key as any other. If it fails, e.g. on a
+  *  duplicate key, the node is left to the user as it was.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *  pl         : Pointer to a tree node users Leaf area.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : User node linked into the tree.
+  *  FALSE      : Tree not defined or frozen, node mismatch, leaf too short
+  *               for the aggregate (see bst_aggregate) or the subtree count
+  *               of a multimap, duplicate key, or the write ahead log not
+  *               written (see bst_wal_open). No node is allocated, so there
+  *               is no malloc error.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    Boolean r;
+    unsigned long t;
+
+    HIST_START(t);
+    r = do_put(tname, pl, TRUE);
+    HIST_STOP(H_PUT, t);
+    return (r);
+}
+
+/* do_put: does the work of bst_put and, linking pl's own node, of bst_put_adopt */
+static Boolean do_put(char *tname, void *pl, Boolean adopt)
+{
     int d;
     t_header *ph;
     t_node *pcopy, *pn, *pr, *a, *f, *q, *b;
     t_header *find_header(char *);
 
     extern void *tallocm(MallocTypes mkind, ...);
-    extern void bst_stat(char *tname);
-    extern t_node *find_node(t_node * treeroot, void *keyrecord, int (*th_ucf) (void *, void *), t_node ** a, t_node ** f,
-			     t_node ** q);
-    extern Boolean put_node(t_header * ph, t_node * pcopy, int (*th_ucf) (), t_node * a, t_node * q, t_node ** b, int *d);
-    extern void rbal(t_node ** treeroot, t_node * a, t_node * f, t_node * q, t_node * b, int d);
+    extern void tcopym(t_header * ph, t_node * to, t_node * from);
+    extern void tstat(t_header * ph, t_node * start);
+    extern t_node *find_node(t_header * ph, void *keyrecord, t_node ** a, t_node ** f, t_node ** q);
+    extern Boolean put_node(t_header * ph, t_node * pcopy, t_node * a, t_node * q, t_node ** b, int *d);
+    extern void rbal(t_node ** treeroot, t_node * a, t_node * f, t_node * q, t_node * b, int d, t_stats * ps);
+    extern Boolean twallog(t_header * ph, int remove, t_node * pn);
+    extern void tsubup(t_header * ph, t_node * p);
+    extern void tsubtop(t_header * ph, t_node * p);
 
     bst_errno = BST_ERR_RESET;
 
@@ -73,6 +133,13 @@ Boolean bst_put(char *tname, void *pl)
 	bst_errno = BST_ERR_TREE_NOT_DEFINED;
 	return (FALSE);
     }
+    STAT_ADD(STATS(ph), st_put, 1);
+
+    /* A frozen tree is read only: */
+    if (ph->th_frozen) {
+	bst_errno = BST_ERR_TREE_FROZEN;
+	return (FALSE);
+    }
 
     /* Set the pointer from the users data area to the header of the node: */
     pn = ((t_node *) pl) - 1;
@@ -83,31 +150,54 @@ Boolean bst_put(char *tname, void *pl)
 	return (FALSE);
     }
 
-    /* Search tree and set pointers for place of insertion: */
-    if (find_node(ph->th_root, pl, ph->th_ucf, &a, &f, &q) != NULL) {
+    /* A leaf made before the tree had an aggregate or subtree count may be too short to hold it: */
+    if ((ph->th_aggf != NULL && pn->tn_usiz < ph->th_aoff + ph->th_asiz)
+	|| (ph->th_multi && pn->tn_usiz < ph->th_moff + (int) sizeof(long))) {
+	bst_errno = BST_ERR_LEAF_SIZE;
+	return (FALSE);
+    }
+
+    /* Search tree and set pointers for place of insertion; a multimap takes equal keys: */
+    if (find_node(ph, pl, &a, &f, &q) != NULL && !ph->th_multi) {
 	bst_errno = BST_ERR_DUPLICATE_KEY;
 	return (FALSE);
     }
+    bst_errno = BST_ERR_RESET;	/* the key not found is what an insert wants */
 
-    /* Make an exact copy of the structure the user is inserting; this will then become */
-    /* the node that is actually placed in the tree:                                    */
-    if ((pcopy = (t_node *) tallocm(T_NODE, ph)) == NULL)
+    /* The insert goes into the write ahead log, if the tree has one, before it is made: */
+    if (ph->th_wal != NULL && twallog(ph, FALSE, pn) == FALSE)
 	return (FALSE);
-    memcpy(pcopy, pn, sizeof(t_node) + ph->th_usiz);
-#ifdef DEBUG_MALLAC_USAGE
-    printf(">>> memcpy FROM LOCATION 0x%-5x TO LOCATION 0x%-5x; %i BYTES <<<\n", pn, pcopy, sizeof(t_node) + ph->th_usiz);
-#endif
 
-    /* Link in the the copy node and rebalance the tree if necessary: */
-    if (put_node(ph, pcopy, ph->th_ucf, a, q, &b, &d) == UNBALANCED)
-	if (ph->th_bsttype == AVL)
-	    rbal(&ph->th_root, a, f, q, b, d);
+    /* Make an exact copy of the structure the user is inserting; this will then become */
+    /* the node that is actually placed in the tree. One adopted is placed as it is,    */
+    /* with the links of a bst_get copy cleared:                                        */
+    if (adopt) {
+	pcopy = pn;
+	pcopy->tn_llink = pcopy->tn_rlink = NULL;
+	pcopy->tn_bf = 0;
+    } else if ((pcopy = (t_node *) tallocm(T_NODE, ph, pn->tn_usiz)) == NULL)
+	return (FALSE);
+    else
+	tcopym(ph, pcopy, pn);
+    if (ph->th_pfx)
+	TNPFX_SET(pcopy, TPFX(ph, pcopy + 1));
+
+    /* Link in the the copy node and rebalance the tree if necessary; the subtree */
+    /* counts of a multimap and the aggregates are set up the path, then for the  */
+    /* nodes rotated:                                                             */
+    if (put_node(ph, pcopy, a, q, &b, &d) == UNBALANCED && ph->th_bsttype == AVL) {
+	tsubup(ph, pcopy);
+	rbal(&ph->th_root, a, f, q, b, d, STATS(ph));
+	tsubtop(ph, a->tn_ulink);
+    } else
+	tsubup(ph, pcopy);
     ph->th_ncnt++;
+    ph->th_gen++;
 
     /* *_stat are left in for development purposes only; it verifies the condition of */
-    /* the tree by traversing the whole tree checking for accuracy:                   */
+    /* the tree, the whole tree or just the path down to the new node:                */
     if (ph->th_bsttype == AVL && ph->th_stat)
-	bst_stat(tname);
+	tstat(ph, pcopy);
 
     /* Successful node insertion: */
     return (TRUE);
@@ -59,7 +59,7 @@ Boolean qfind(t_header * ph, t_node * tnode)
 
     /* search ... */
     while (pn != NULL) {
-	cmpresult = ph->th_ucf(tnode + 1, pn + 1);
+	cmpresult = TCMP(ph, tnode + 1, pn + 1);
 	if (cmpresult < 0)
 	    pn = pn->tn_llink;
 	else if (cmpresult > 0)
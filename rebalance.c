@@ -26,7 +26,7 @@
 static char *RCSid[] = { "$Id: rebalance.c,v 2.2 1999/01/27 01:17:06 roger Exp $" };
 
 
-void rbal(t_node ** treeroot, t_node * a, t_node * f, t_node * q, t_node * b, int d)
+void rbal(t_node ** treeroot, t_node * a, t_node * f, t_node * q, t_node * b, int d, t_stats * ps)
 {
  /*******************************************************************************
   *  A private library function that will rbal the AVL tree to a balanced state 
@@ -45,6 +45,7 @@ void rbal(t_node ** treeroot, t_node * a, t_node * f, t_node * q, t_node * b, in
   *  f          : Pointer to pointer (t_node) to the parent of a.
   *  q          : Pointer to pointer (t_node) to the parent of new node.
   *  treeroot   : Pointer to pointer (t_node) to the current root tree.
+  *  ps         : Operation counters of the tree to count the rotation in.
   *
   *  Output Parameters
   *  =================
@@ -73,6 +74,7 @@ void rbal(t_node ** treeroot, t_node * a, t_node * f, t_node * q, t_node * b, in
 #ifdef DEBUG_SHOWREBALANCE
 	    printf(">> LL << rotation\n");
 #endif
+	    STAT_ADD(ps, st_ll, 1);
 	    /* LINKS */
 	    a->tn_llink = b->tn_rlink;
 	    b->tn_rlink = a;
@@ -90,6 +92,7 @@ void rbal(t_node ** treeroot, t_node * a, t_node * f, t_node * q, t_node * b, in
 	    b->tn_bf = 0;
 	} else {
 	    /* LR ROTATION */
+	    STAT_ADD(ps, st_lr, 1);
 	    /* LINKS */
 	    c = b->tn_rlink;
 	    b->tn_rlink = c->tn_llink;
@@ -168,6 +171,7 @@ void rbal(t_node ** treeroot, t_node * a, t_node * f, t_node * q, t_node * b, in
 #ifdef DEBUG_SHOWREBALANCE
 	printf(">> RR << rotation\n");
 #endif
+	STAT_ADD(ps, st_rr, 1);
 	/* LINKS */
 	a->tn_rlink = b->tn_llink;
 	b->tn_llink = a;
@@ -186,6 +190,7 @@ void rbal(t_node ** treeroot, t_node * a, t_node * f, t_node * q, t_node * b, in
 	b->tn_bf = 0;
     } else {
 	/* RL ROTATION */
+	STAT_ADD(ps, st_rl, 1);
 	/* LINKS */
 	c = b->tn_llink;
 	b->tn_llink = c->tn_rlink;
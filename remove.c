@@ -28,6 +28,8 @@ typedef enum { OFF, ON } BalancingSwitch;
 static char *RCSid[] = { "$Id: remove.c,v 2.2 1999/01/19 03:04:48 roger Exp $" };
 
 extern int bst_errno;
+static Boolean do_remove(char *tname, void *pl);
+static t_node *tplace(t_header * ph, t_node * r, t_node * p);
 
 
 /* bst_remove: non-recursive delete a node from the tree */
@@ -42,7 +44,8 @@ Boolean bst_remove(char *tname, void *pl)
   *  =================
   *  tname      : Name of the tree to delete node from.
   *  pl         : Pointer to the users structure that contains the key to remove
-  *               from the tree.
+  *               from the tree; of the nodes of a multimap with the key, the
+  *               first put is removed.
   *
   *  Output Parameters
   *  =================
@@ -55,22 +58,44 @@ Boolean bst_remove(char *tname, void *pl)
   *  bst_errno  : Global error variable; reset on entry.
   *******************************************************************************/
 
+    Boolean r;
+    unsigned long t;
+
+    HIST_START(t);
+    r = do_remove(tname, pl);
+    HIST_STOP(H_REMOVE, t);
+    return (r);
+}
+
+/* do_remove: does the work of bst_remove */
+static Boolean do_remove(char *tname, void *pl)
+{
     t_header *ph;		/* pointer to the tree header record */
     t_node *dp;			/* move through the tree with */
     t_node *p;			/* move through the tree with */
     t_node *pn;			/* pointer the header part of users leaf node */
     t_node **q;			/* hold the previous node */
+    t_node *up;			/* parent of the node unlinked; bottom of the path that changed */
     t_node *r;			/* pointer to the node to be deleted when found so that the leaf node in its left subtree, rightmost node can be copied to here at r. */
+    t_node *first;		/* first node of the key in a multimap */
     int tside;			/* value of the node LEFT_SON or RIGHT_SON */
     int cmpresult;		/* Integer result from the user written compare funtion to determe the key ordering. (neg. <.,0 =, pos. >) */
     Boolean found;
     BalancingSwitch rbalsw;
+    unsigned long ncmp;		/* compare function calls made */
+    unsigned long npfx;		/* compares the key prefixes decided */
+    unsigned long kp;		/* key prefix of pl */
 
     t_header *find_header(char *);
-    void balancer(t_node **, t_node **, BalancingSwitch *);
-    void balancel(t_node **, t_node **, BalancingSwitch *);
-    extern void bst_stat(char *);
+    void balancer(t_node **, t_node **, BalancingSwitch *, t_stats *);
+    void balancel(t_node **, t_node **, BalancingSwitch *, t_stats *);
+    extern void tstat(t_header * ph, t_node * start);
     extern void tfreem(MallocTypes mkind, ...);
+    extern Boolean twallog(t_header * ph, int remove, t_node * pn);
+    extern void tcmpauto(t_header * ph);
+    extern t_node *tedge(t_header * ph, void *pl, Boolean last);
+    extern void tsubup(t_header * ph, t_node * p);
+    extern void tsubtop(t_header * ph, t_node * p);
 
     bst_errno = BST_ERR_RESET;
 
@@ -79,6 +104,13 @@ Boolean bst_remove(char *tname, void *pl)
 	bst_errno = BST_ERR_TREE_NOT_DEFINED;
 	return (FALSE);
     }
+    STAT_ADD(STATS(ph), st_remove, 1);
+
+    /* A frozen tree is read only: */
+    if (ph->th_frozen) {
+	bst_errno = BST_ERR_TREE_FROZEN;
+	return (FALSE);
+    }
 
     /* check if node passed belongs to this tree */
     pn = ((t_node *) pl - 1);	/* pn is cast from user type to type t_node */
@@ -90,12 +122,17 @@ Boolean bst_remove(char *tname, void *pl)
 
     /* ok, on with initialization */
     found = FALSE;
+    ncmp = npfx = 0;
+    kp = ph->th_pfx ? TPFX(ph, pl) : 0;
 
     p = ph->th_root;		/* p and q both initially point to the address of the  */
     q = &ph->th_root;		/* location that contains the pointer to the tree root */
+    first = ph->th_multi ? tedge(ph, pl, FALSE) : NULL;
 
     while (p != NULL && !found) {	/* trace down through tree searching */
-	cmpresult = ph->th_ucf(pl, p + 1);	/* make the key comparision call     */
+	cmpresult = tpcmp(ph, kp, pl, p, &ncmp, &npfx);	/* make the key comparision call     */
+	if (cmpresult == 0 && first != NULL && p != first)
+	    cmpresult = -1;	/* the first of equal keys is left of the others */
 
 	if (cmpresult < 0) {	/* take left branch */
 	    q = &p->tn_llink;	/* q is the address of the structure   */
@@ -104,6 +141,9 @@ Boolean bst_remove(char *tname, void *pl)
 	    q = &p->tn_rlink;
 	    p = p->tn_rlink;
 	} else {		/* found the desired node */
+	    /* the remove goes into the write ahead log, if any, before it is made */
+	    if (ph->th_wal != NULL && twallog(ph, TRUE, pn) == FALSE)
+		return (FALSE);
 	    found = TRUE;
 	    rbalsw = ON;
 
@@ -137,41 +177,56 @@ Boolean bst_remove(char *tname, void *pl)
 		/* node pointed to by p:                              */
 		/* note: ONLY the data is copied, not the header part */
 		/* of the leaf involving the pointers, bf's etc */
-
-		memcpy(r + 1, p + 1, ph->th_usiz);
+		/* (the key prefix goes with the data)          */
+		/* A leaf of another size class than r is not   */
+		/* copied but takes r's place further below.    */
+
+		if (r->tn_slab == p->tn_slab) {
+		    memcpy(r + 1, p + 1, p->tn_usiz);
+		    r->tn_usiz = p->tn_usiz;
+		    TNPFX_SET(r, TNPFX(p));
 #ifdef DEBUG_MALLAC_USAGE
-		printf(">>> memcpy FROM LOCATION 0x%-5x TO LOCATION 0x%-5x; %i BYTES <<<\n", p + 1, r + 1, ph->th_usiz);
+		    printf(">>> memcpy FROM LOCATION 0x%-5x TO LOCATION 0x%-5x; %i BYTES <<<\n", p + 1, r + 1, p->tn_usiz);
 #endif
+		}
 		if (p->tn_llink != NULL) {
 		    p->tn_llink->tn_ulink = p->tn_ulink;
 		    if (r->tn_llink != p)
 			p->tn_llink->tn_tag = RIGHT_SON;
 		}
 		*q = p->tn_llink;
+		if (r->tn_slab != p->tn_slab)
+		    p = tplace(ph, r, p);
 	    }
 
 	}
     }				/* while not found */
 
+    STAT_ADD(STATS(ph), st_cmp, ncmp);
+    STAT_ADD(STATS(ph), st_pfx, npfx);
     if (!found) {
 	bst_errno = BST_ERR_KEY_NOT_FOUND;
 	return (FALSE);
     }
 
+    /* the subtree counts of a multimap and the aggregates are set up the path, then */
+    /* for the nodes rotated:                                                        */
     tside = p->tn_tag;
     dp = p;
+    tsubup(ph, dp->tn_ulink);
     for (p = dp->tn_ulink; p != NULL; p = p->tn_ulink) {
 	if (ph->th_bsttype == AVL) {
 	    switch (rbalsw) {
 	    case ON:
 		switch (tside) {
 		case LEFT_SON:
-		    balancel(&ph->th_root, &p, &rbalsw);
+		    balancel(&ph->th_root, &p, &rbalsw, STATS(ph));
 		    break;
 		case RIGHT_SON:
-		    balancer(&ph->th_root, &p, &rbalsw);
+		    balancer(&ph->th_root, &p, &rbalsw, STATS(ph));
 		    break;
 		}
+		tsubtop(ph, p);
 		break;
 	    case OFF:
 		break;
@@ -181,16 +236,54 @@ Boolean bst_remove(char *tname, void *pl)
     }
 
     /* add to the free list in the AVL header record for this tree */
+    up = dp->tn_ulink;
     tfreem(T_NODE, CHAIN, ph, dp);
     ph->th_ncnt--;
+    ph->th_gen++;
 
     if (ph->th_stat)
-	bst_stat(tname);
+	tstat(ph, up);
+
+    /* a tree given a fragmentation to compact at by bst_compact_auto is looked at, */
+    /* last since it may move every node:                                          */
+    if (ph->th_frag > 0)
+	tcmpauto(ph);
     return (TRUE);
 }
 
+/* tplace: put the unlinked leaf p in the place of r; r is left to be freed as p was */
+static t_node *tplace(t_header * ph, t_node * r, t_node * p)
+{
+    t_node *up;
+    int tside;
+
+    /* where p was unlinked from, for the rebalancing up from there: */
+    up = p->tn_ulink == r ? p : p->tn_ulink;
+    tside = p->tn_tag;
+
+    p->tn_llink = r->tn_llink;
+    p->tn_rlink = r->tn_rlink;
+    p->tn_ulink = r->tn_ulink;
+    p->tn_tag = r->tn_tag;
+    p->tn_bf = r->tn_bf;
+    if (p->tn_llink != NULL)
+	p->tn_llink->tn_ulink = p;
+    if (p->tn_rlink != NULL)
+	p->tn_rlink->tn_ulink = p;
+    if (p->tn_ulink == NULL)
+	ph->th_root = p;
+    else if (p->tn_tag == LEFT_SON)
+	p->tn_ulink->tn_llink = p;
+    else
+	p->tn_ulink->tn_rlink = p;
+
+    r->tn_ulink = up;
+    r->tn_tag = tside;
+    return (r);
+}
+
 /* balancel; perform a left rotation */
-void balancel(t_node ** root, t_node ** p, BalancingSwitch * bsw)
+void balancel(t_node ** root, t_node ** p, BalancingSwitch * bsw, t_stats * ps)
 {
     t_node *p1, *p2;
 
@@ -215,6 +308,7 @@ void balancel(t_node ** root, t_node ** p, BalancingSwitch * bsw)
 #ifdef DEBUG_SHOWREBALANCE
 	    printf(" (RR)");
 #endif
+	    STAT_ADD(ps, st_rmrr, 1);
 
 	    /* LINKS */
 	    (*p)->tn_rlink = p1->tn_llink;
@@ -261,6 +355,7 @@ void balancel(t_node ** root, t_node ** p, BalancingSwitch * bsw)
 #ifdef DEBUG_SHOWREBALANCE
 	    printf(" (RL)");
 #endif
+	    STAT_ADD(ps, st_rmrl, 1);
 	    /* LINKS */
 	    p2 = p1->tn_llink;
 	    p1->tn_llink = p2->tn_rlink;
@@ -318,7 +413,7 @@ void balancel(t_node ** root, t_node ** p, BalancingSwitch * bsw)
 }				/* balancel */
 
 /* balancer: perform a right rotation */
-void balancer(t_node ** root, t_node ** p, BalancingSwitch * bsw)
+void balancer(t_node ** root, t_node ** p, BalancingSwitch * bsw, t_stats * ps)
 {				/* balancer */
     t_node *p1, *p2;
 
@@ -342,6 +437,7 @@ void balancer(t_node ** root, t_node ** p, BalancingSwitch * bsw)
 #ifdef DEBUG_SHOWREBALANCE
 	    printf(" (LL)");
 #endif
+	    STAT_ADD(ps, st_rmll, 1);
 	    /* single LL */
 
 	    /* LINKS */
@@ -388,6 +484,7 @@ void balancer(t_node ** root, t_node ** p, BalancingSwitch * bsw)
 #ifdef DEBUG_SHOWREBALANCE
 	    printf(" (LR)");
 #endif
+	    STAT_ADD(ps, st_rmlr, 1);
 	    /* LINKS */
 	    p2 = p1->tn_rlink;
 	    p1->tn_rlink = p2->tn_llink;
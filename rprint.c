@@ -24,6 +24,7 @@
 #endif
 
 t_header *find_header(char *);
+void tmaplinks(t_header * ph);
 static t_header *ph;
 
 static char *RCSid[] = { "$Id$" };
@@ -70,6 +71,7 @@ void bst_rprint(char *tname)
 	bst_errno = BST_ERR_TREE_NOT_DEFINED;
 	return;
     }
+    tmaplinks(ph);
     /* now check if user has passed a printing function for this tree */
 
     if (ph->th_upf == NULL) {
@@ -97,6 +99,7 @@ void inorderprint(t_node * p, int *k, int th_usiz)
     t_node *pcopy;		/* pointer to a copy of the user node in tree */
 
     extern void *tallocm(MallocTypes mkind, ...);
+    extern void tcopym(t_header * ph, t_node * to, t_node * from);
 
     /* which is passed to the users print function */
 
@@ -105,14 +108,11 @@ void inorderprint(t_node * p, int *k, int th_usiz)
 	inorderprint(p->tn_rlink, k, th_usiz);	/* take right branch to leaf  */
 
 
-	if ((pcopy = (t_node *) tallocm(T_NODE, ph)) == NULL) {
+	if ((pcopy = (t_node *) tallocm(T_NODE, ph, p->tn_usiz)) == NULL) {
 	    bst_errno = BST_ERR_MALLOC;
 	    return;
 	}
-	memcpy(pcopy, p, sizeof(t_node) + th_usiz);
-#ifdef DEBUG_MALLAC_USAGE
-	printf(">>> memcpy FROM LOCATION 0x%-5x TO LOCATION 0x%-5x; %i BYTES <<<\n", p, pcopy, sizeof(t_node) + th_usiz);
-#endif
+	tcopym(ph, pcopy, p);
 
 	/* make call to user node print function */
 
@@ -0,0 +1,196 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+
+/* bst_stats: hand back the operation counters of a tree */
+Boolean bst_stats(char *tname, t_stats * ps)
+{
+ /*******************************************************************************
+  *  A user acccessible function that returns what the library has done to a tree
+  *  since it was created: calls to bst_put, bst_get and bst_remove, the compare
+  *  function calls they made and the compares the key prefixes decided without
+  *  one (see bst_key_prefix), the rotations done on insert and on remove, and
+  *  how many nodes came from the free list rather than malloc and back.
+  *
+  *  The counters cost one add each and are always kept. Built with
+  *  BST_STATS_SHARDED, each thread adds atomically into its own set of counters
+  *  and the sets are summed here, so threads reading a tree at the same time
+  *  neither lose counts nor fight over one cache line.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *
+  *  Output Parameters
+  *  =================
+  *  ps         : Counters of the tree.
+  *  Function name returns Boolean result:
+  *  TRUE       : Counters returned.
+  *  FALSE      : Tree not defined.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    int i, j;
+    unsigned long *to, *from;
+    t_header *ph;
+
+    extern t_header *find_header(char *);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+
+    /* every counter is an unsigned long, so each set is summed as an array: */
+    memset(ps, 0, sizeof(t_stats));
+    to = (unsigned long *) ps;
+    for (i = 0; i < STATS_SHARDS; i++) {
+	from = (unsigned long *) STATS_SHARD(ph, i);
+	for (j = 0; j < sizeof(t_stats) / sizeof(unsigned long); j++)
+#ifdef BST_STATS_SHARDED
+	    to[j] += __atomic_load_n(&from[j], __ATOMIC_RELAXED);
+#else
+	    to[j] += from[j];
+#endif
+    }
+    return (TRUE);
+}
+
+/* bst_mem_stats: hand back how full the chunks and slabs of a tree are */
+Boolean bst_mem_stats(char *tname, t_memstats * pm)
+{
+ /*******************************************************************************
+  *  A user acccessible function that tells how well a tree uses its memory,
+  *  to judge whether bst_compact is worth running: how many nodes the chunks
+  *  and slabs of the tree have room for against the nodes in the tree, how many
+  *  of the rest are on free lists for the next puts or never handed out, and
+  *  the bytes of it all, those in huge pages besides. ms_frag is the share of
+  *  the slots not holding a node of the tree: free, not handed out, held by the
+  *  user from bst_alloc or bst_get, or removed from a chunk and not reused.
+  *  ms_distance, the average bytes between a node and its parent, tells how
+  *  scattered the tree is: it is least when the tree is laid out as bst_freeze
+  *  or bst_compact lays it out. The tree is walked for it, in time linear in its
+  *  size.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *
+  *  Output Parameters
+  *  =================
+  *  pm         : Memory use of the tree.
+  *  Function name returns Boolean result:
+  *  TRUE       : Memory use returned.
+  *  FALSE      : Tree not defined.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+    t_chunk *pc;
+    t_node *p;
+    int c;
+    double d;
+
+    extern t_header *find_header(char *);
+    extern void tmaplinks(t_header * ph);
+    extern long tslots(t_header * ph);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    tmaplinks(ph);
+    memset(pm, 0, sizeof(t_memstats));
+    pm->ms_nodes = ph->th_ncnt;
+    pm->ms_slots = tslots(ph);
+    pm->ms_free = ph->th_flcnt;
+    for (pc = ph->th_clist; pc != NULL; pc = pc->tc_link) {
+	pm->ms_chunked += pc->tc_nnodes;
+	pm->ms_bytes += sizeof(t_chunk) + pc->tc_nnodes * pc->tc_stride;
+    }
+    if (ph->th_slab != NULL) {
+	for (pc = ph->th_slab->ts_list; pc != NULL; pc = pc->tc_link)
+	    pm->ms_bytes += sizeof(t_chunk) + pc->tc_nnodes * pc->tc_stride;
+	for (pc = ph->th_slab->ts_huge; pc != NULL; pc = pc->tc_link)
+	    pm->ms_huge += HUGE_BYTES;
+	pm->ms_bytes += pm->ms_huge;
+	for (c = 0; c <= SLAB_CLASSES; c++) {
+	    for (p = ph->th_slab->ts_free[c]; p != NULL; p = p->tn_ulink)
+		pm->ms_free++;
+	    pm->ms_unused += ph->th_slab->ts_left[c];
+	}
+    }
+
+    /* the nodes in order, walking the tree by its links: */
+    d = 0;
+    if ((p = ph->th_root) != NULL)
+	while (p->tn_llink != NULL)
+	    p = p->tn_llink;
+    while (p != NULL) {
+	if (!p->tn_chunk && !p->tn_slab)
+	    pm->ms_malloced++;
+	if (p->tn_ulink != NULL)
+	    d += p > p->tn_ulink ? (char *) p - (char *) p->tn_ulink : (char *) p->tn_ulink - (char *) p;
+	if (p->tn_rlink != NULL)
+	    for (p = p->tn_rlink; p->tn_llink != NULL; p = p->tn_llink);
+	else {
+	    while (p->tn_tag == RIGHT_SON)
+		p = p->tn_ulink;
+	    p = p->tn_ulink;
+	}
+    }
+    if (pm->ms_slots > 0)
+	pm->ms_frag = 1 - (double) (pm->ms_nodes - pm->ms_malloced) / pm->ms_slots;
+    if (pm->ms_nodes > 1)
+	pm->ms_distance = d / (pm->ms_nodes - 1);
+    return (TRUE);
+}
+
+#ifdef BST_STATS_SHARDED
+/* tshard: set of counters this thread adds into */
+int tshard(void)
+{
+    static int next;
+    static __thread int shard = -1;
+
+    if (shard < 0)
+	shard = __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED) % STATS_SHARDS;
+    return (shard);
+}
+#endif
@@ -26,6 +26,7 @@
 static char *RCSid[] = { "$Id: tcp.c,v 2.1 1999/01/02 17:06:31 roger Exp $" };
 
 extern int bst_errno;
+static Boolean do_copy(char *from, char *to);
 
 
 /* bst_copy: make a copy of an existing tree */
@@ -33,7 +34,9 @@ Boolean bst_copy(char *from, char *to)
 {
  /*******************************************************************************
   *  A user acccessible function that creates an exact copy of an existing
-  *  tree.
+  *  tree. Trees of PCOPY_MIN_NODES nodes or more are cloned in parallel into
+  *  one chunk of nodes by tpcopy; smaller ones, or when no chunk that large
+  *  can be had, are copied node by node by twalk.
   *
   *  Input Parameters
   *  =================
@@ -51,10 +54,24 @@ Boolean bst_copy(char *from, char *to)
   *  bst_errno  : Global error variable; reset on entry.
   *******************************************************************************/
 
+    Boolean r;
+    unsigned long t;
+
+    HIST_START(t);
+    r = do_copy(from, to);
+    HIST_STOP(H_COPY, t);
+    return (r);
+}
+
+/* do_copy: does the work of bst_copy */
+static Boolean do_copy(char *from, char *to)
+{
     t_header *ph;
     t_header *find_header(char *);	/* to retrieve the tree header record */
+    void tmaplinks(t_header * ph);
 
     Boolean twalk(TWalkOps op, Traversals order, ...);
+    Boolean tpcopy(t_header * ph, char *ntn);
 
 
     /* Initialization */
@@ -71,6 +88,7 @@ Boolean bst_copy(char *from, char *to)
 	bst_errno = BST_ERR_COPY_FROM_NON_EXISTANT;
 	return (FALSE);
     }
+    tmaplinks(ph);
 
     /* Verify the length of the 'to' tree name: */
     if (strlen(to) < MIN_TREE_NAME_LEN) {
@@ -84,6 +102,13 @@ Boolean bst_copy(char *from, char *to)
 	return (FALSE);
     }
 
-    /* Copy the tree: */
+    /* Copy the tree; one of varying leaf sizes by twalk, each copy in its size class: */
+    if (ph->th_ncnt >= PCOPY_MIN_NODES && !ph->th_var) {
+	if (tpcopy(ph, to))
+	    return (TRUE);
+	if (bst_errno != BST_ERR_MALLOC)
+	    return (FALSE);
+	bst_errno = BST_ERR_RESET;
+    }
     return (twalk(COPY, PREORDER, ph, to));
 }
@@ -53,19 +53,33 @@ void tdispose(t_header * ph)
 
     extern void tfreem(MallocTypes mkind, ...);
     extern Boolean twalk(TWalkOps op, Traversals order, ...);
+    extern Boolean twalclose(t_header * ph);
+    extern void tcmpfree(t_header * ph);
 
+    /* Its write ahead log is committed and closed first: */
+    twalclose(ph);
 
-    /* Traverse the tree freeing all nodes: */
-    twalk(DELETE, POSTORDER, ph->th_root);
+    /* Traverse the tree freeing all nodes; those of a tree file unused since */
+    /* bst_open_mapped are all in the file, their links not yet addresses:    */
+    if (!ph->th_mrel)
+	twalk(DELETE, POSTORDER, ph->th_root, ph);
 
     //printf("tdispose: tree nodes freed\n");
     /* Traverse the list of free nodes in the header, freeing all nodes: */
     for (pn = ph->th_flist; pn != EMPTY_LIST;) {
 	qn = pn;
 	pn = pn->tn_ulink;
-	tfreem(T_NODE, FREE, qn);
+	tfreem(T_NODE, FREE, ph, qn);
     }
 
+    /* Nodes laid out in chunks (see tpcopy, bst_freeze) go back with their chunks, */
+    /* and nodes of a size class (see bst_alloc_size) with their slabs:             */
+    tfreem(T_CHUNK, ph);
+    tfreem(T_SLAB, ph);
+    tfreem(T_FRZIDX, ph);
+    tfreem(T_MAP, ph);
+    tcmpfree(ph);
+
     //printf("tdispose: free list in header freed\n");
     /* Find the header record position in the list of defined trees: */
     for (p = t_head, q = NULL, found = FALSE; p != NULL && !found;)
@@ -26,6 +26,7 @@
 static char *RCSid[] = { "$Id: tequal.c,v 2.1 1999/01/02 17:07:31 roger Exp $" };
 
 extern int bst_errno;
+static Boolean do_equal(char *t1, char *t2);
 
 
 /* bst_equal: are the values in tree 1 in tree 2 */
@@ -66,9 +67,22 @@ Boolean bst_equal(char *t1, char *t2)
   *  bst_errno  : Global error variable; reset on entry.
   *******************************************************************************/
 
+    Boolean r;
+    unsigned long t;
+
+    HIST_START(t);
+    r = do_equal(t1, t2);
+    HIST_STOP(H_EQUAL, t);
+    return (r);
+}
+
+/* do_equal: does the work of bst_equal */
+static Boolean do_equal(char *t1, char *t2)
+{
     t_header *ph1, *ph2;
 
     t_header *find_header(char *);	/* to retrieve the tree header record */
+    void tmaplinks(t_header * ph);
     Boolean twalk(TWalkOps op, Traversals order, ...);
 
 
@@ -86,6 +100,7 @@ Boolean bst_equal(char *t1, char *t2)
 	bst_errno = BST_ERR_FIRST_TREE_UNDEF;
 	return (FALSE);
     }
+    tmaplinks(ph1);
 
     /* Verify the length of the 2nd tree name: */
     if (strlen(t2) < MIN_TREE_NAME_LEN) {
@@ -98,6 +113,7 @@ Boolean bst_equal(char *t1, char *t2)
 	bst_errno = BST_ERR_SECOND_TREE_UNDEF;
 	return (FALSE);
     }
+    tmaplinks(ph2);
 
     /* Check if the users data size is the same for both trees. If so, there is still no  */
     /* guarentee that the structures are really the same -- which can cause a segmentaion */
@@ -30,14 +30,16 @@
  *  2. insert ARRSIZ random keys into the tree.
  *  3. peform a check tree to see that the tree is still in balance.
  *  4. read/search for each key in the tree noting any not founds.
- *  5. print upto MAX_DISPLAY records in doing a tree print.
- *  6. delete each key in the tree
- *  7. delete the tree.
- *  8. print a report summary
+ *  5. copy the tree and check the copy is identical to it.
+ *  6. print upto MAX_DISPLAY records in doing a tree print.
+ *  7. delete each key in the tree
+ *  8. delete the tree.
+ *  9. print a report summary
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #ifdef __GNUC__
 #include <time.h>
@@ -68,6 +70,7 @@
  ************************************************************************/
 #ifdef DEBUG_EXPLOIT_TREE_HDR
 #define  MAX_ID_LEN          32	/* defined in bst.h */
+#define  SLAB_CLASSES        48	/* defined in bst.h */
 /* included only for debugging or temp TODO on treewalk */
 #include "struct.h"
 typedef struct header t_header;
@@ -91,12 +94,81 @@ typedef struct node t_node;
 /*#define ARRSIZ (256 * 1024)*/
 /*#define ARRSIZ (384 * 1024) segmentation fault */
 
+/* nodes of the large tree: 2^17 - 1, more than PCOPY_MIN_NODES and PVERIFY_MIN_NODES, */
+/* and put in order so that AVL makes it a perfect tree with key BIGSIZ / 2 at the root */
+#define BIGSIZ 131071
+
+/* BST_ERR_KEY_ORDER of inc/errno.h, which bst_verify gives for keys out of order */
+#define KEY_ORDER_ERR 127
+
+/* BST_ERR_ULINK and BST_ERR_OUT_OF_BALANCE of inc/errno.h, found on a changed path */
+#define ULINK_ERR 126
+#define BALANCE_ERR 108
+
+/* nodes of the tree checked along each changed path, and the changes made to it */
+#define PATHSIZ 1000
+
 /* output in here will display one less than this, ie MAX_DISPLAY+1 */
 #define MAX_DISPLAY 26
 
+/* bytes of leaf i of the variable leaves past a Leaf, under VAR_TAIL */
+#define VAR_TAIL 200
+#define VSIZE(i) ((i) * 37 % VAR_TAIL)
+
+/* files the variable leaf tree is saved to and mapped back from, and dumped to and restored from */
+#define MAP_FILE "test.tree"
+#define DUMP_FILE "test.dump"
+
+/* write ahead log of the built in key tree */
+#define WAL_FILE "test.wal"
+
+/* sum and number of the data of a subtree, kept in a leaf of the aggregate tree past a Leaf */
+struct sums {
+    long sum;
+    long n;
+};
+#define SUMS_OFF ((sizeof(Leaf) + sizeof(long) - 1) / sizeof(long) * sizeof(long))
+
+/* subtree count of a node of the multimap, kept in a leaf past a Leaf */
+#define COUNT_OFF SUMS_OFF
+
 static char *RCSid[] = { "$Id$" };
 
 int f(Leaf *, Leaf *);
+int fkey(const void *, Leaf *);
+int vleaf(char *tn, char *key, int i);
+unsigned long prefix(Leaf *);
+void sums(void *, const void *, const Leaf *, const void *);
+
+/* vleaf: 0 if leaf i of key is in tn with its size and tail, else 1 */
+int vleaf(char *tn, char *key, int i)
+{
+    Leaf *l;
+    char *c;
+    int k, bad;
+
+    if ((l = (Leaf *) bst_find_key(tn, key)) == NULL)
+	return (1);
+    bad = bst_leaf_size(tn, l) != sizeof(Leaf) + VSIZE(i);
+    for (c = (char *) (l + 1), k = 0; k < VSIZE(i); k++)
+	bad |= c[k] != (char) i;
+    bst_release(tn, l);
+    return (bad);
+}
+
+/* what the allocator of the allocator test has handed out and not had back */
+struct counts {
+    long out;			/* pieces of ta_alloc */
+    long bulk;			/* pieces of ta_bulk_alloc */
+    long bytes;			/* bytes of those */
+    long calls;			/* calls of either */
+    size_t most;		/* largest piece ta_bulk_alloc hands out; 0 for any */
+};
+
+void *count_alloc(void *ctx, size_t size);
+void count_free(void *ctx, void *p);
+void *count_bulk_alloc(void *ctx, size_t size);
+void count_bulk_free(void *ctx, void *p, size_t size);
 
 void reverse(char s[]);
 void itoa(int, char s[]);
@@ -109,9 +181,19 @@ int main(int argc, char *argv[])
 {
     int randnum, i, j, missing, lost;
     int rand1, rand2;
-    char cmd[100], tn[] = "t", kn[100], chari[LEAF_KEYLEN + 1];
-    Leaf *l, *pk, *pnl;
-    char *pc, arrkey[ARRSIZ][LEAF_KEYLEN + 1];
+    long left;
+    Leaf *pkeep[PATHSIZ];
+    char cmd[100], tnp[] = "tpath", tn[] = "t", tncp[] = "tcopy", tna[] = "tagg", tnb[] = "tbig", tnk[] = "tkey", tnv[] = "tvar", tnm[] = "tmapped", kn[100], chari[LEAF_KEYLEN + 1];
+    BstStats st, st0;
+    BstMemStats ms;
+    BstAllocator ba;
+    BstCursor cur;
+    struct sums sg, sb;
+    struct counts cnt;
+    BstKey bk;
+    Leaf *l, *pk, *pnl, *pb, *pv;
+    BstVerify vr;
+    char *pc, arrkey[ARRSIZ][LEAF_KEYLEN + 1], found[ARRSIZ][2];
     unsigned int seed;
 
 
@@ -124,6 +206,7 @@ int main(int argc, char *argv[])
 	return 0;
     }
     printf("--- tree defined: '%s' ---\n\n", tn);
+    bst_stats_timing(TRUE);
 
     pk = (Leaf *) bst_alloc(tn);
 
@@ -192,6 +275,595 @@ int main(int argc, char *argv[])
     }
     printf("------------------- end of find -------------------------\n\n\n");
 
+    if (bst_stats(tn, &st) == TRUE)
+	printf("operation counters: put %lu get %lu compares %lu rotations LL %lu LR %lu RR %lu RL %lu\n\n\n", st.st_put,
+	       st.st_get, st.st_cmp, st.st_ll, st.st_lr, st.st_rr, st.st_rl);
+    bst_stats_dump(tn, stdout);
+    printf("\n\n");
+
+    /* compact a few nodes at a time, taking a key out and back in on the way */
+    printf("------------------ begin compact of [%d] records -----------------------\n", ARRSIZ);
+    for (lost = 0, i = 0; (left = bst_compact(tn, 3)) > 0; i++)
+	if (i == 1) {
+	    memset(pk->key, '\0', LEAF_KEYLEN + 1);
+	    strcpy(pk->key, arrkey[0]);
+	    if (bst_remove(tn, pk) == FALSE || bst_put(tn, pk) == FALSE)
+		lost++;
+	}
+    if (left < 0 || bst_verify(tn, NULL) == FALSE)
+	printf("\007  ### COMPACTED TREE IS NOT SOUND: %s: %s ###\n\n", tn, bst_errmsg(bst_errno));
+    else {
+	for (i = 0; i < ARRSIZ; i++) {
+	    memset(pk->key, '\0', LEAF_KEYLEN + 1);
+	    strcpy(pk->key, arrkey[i]);
+	    if ((l = (Leaf *) bst_get(tn, pk)) == NULL)
+		lost++;
+	    else
+		bst_release(tn, l);
+	}
+	/* every node is in the one chunk, and a fragmentation of 1 or more is refused: */
+	if (bst_mem_stats(tn, &ms) == FALSE || ms.ms_chunked != ms.ms_nodes || ms.ms_malloced != 0
+	    || bst_compact_auto(tn, 1.0) == TRUE || bst_compact_auto(tn, 0.5) == FALSE)
+	    lost++;
+	if (lost != 0)
+	    printf("\007  ### %d KEYS LOST IN COMPACTED TREE ###\n\n", lost);
+	else
+	    printf("success: compacted tree '%s' finds all keys, all %li in one chunk\n", tn, ms.ms_chunked);
+    }
+    printf("------------------- end of compact -------------------------\n\n\n");
+
+    printf("------------------ begin copy of [%d] records -----------------------\n", ARRSIZ);
+    if (bst_copy(tn, tncp) == FALSE)
+	printf("\007  ### CANNOT COPY TREE: %s: %s ###\n\n", tn, bst_errmsg(bst_errno));
+    else {
+	if (bst_ident(tn, tncp) == FALSE)
+	    printf("\007  ### COPY IS NOT IDENTICAL: '%s' ###\n\n", tncp);
+	else if (bst_verify(tncp, NULL) == FALSE)
+	    printf("\007  ### COPY IS NOT SOUND: %s: %s ###\n\n", tncp, bst_errmsg(bst_errno));
+	else
+	    printf("success: copy '%s' is identical\n", tncp);
+	bst_delete(tncp);
+    }
+    printf("------------------- end of copy -------------------------\n\n\n");
+
+    /* a tree large enough to be copied in parallel into one chunk, then copied again */
+    /* by an allocator that refuses a chunk that large, so bst_copy falls back on twalk */
+    printf("------------------ begin copy of [%d] records -----------------------\n", BIGSIZ);
+    if (bst_create(tnb, AVL, sizeof(Leaf), FALSE, f, NULL, TREE_VERIFY_NO) == FALSE)
+	printf("\007  ### CANNOT CREATE TREE: %s: %s ###\n\n", tnb, bst_errmsg(bst_errno));
+    else {
+	pb = (Leaf *) bst_alloc(tnb);
+	for (lost = 0, i = 0; i < BIGSIZ; i++) {
+	    sprintf(pb->key, "%010d", i);
+	    pb->data = i;
+	    if (bst_put(tnb, pb) == FALSE)
+		lost++;
+	}
+	bst_release(tnb, pb);
+	if (bst_copy(tnb, tncp) == FALSE || bst_ident(tnb, tncp) == FALSE || bst_verify(tncp, NULL) == FALSE
+	    || bst_mem_stats(tncp, &ms) == FALSE || ms.ms_chunked != BIGSIZ)
+	    lost++;		/* not the one chunk of tpcopy */
+	bst_delete(tncp);
+	memset(&cnt, 0, sizeof(cnt));
+	memset(&ba, 0, sizeof(ba));
+	ba.ta_alloc = count_alloc;
+	ba.ta_free = count_free;
+	ba.ta_bulk_alloc = count_bulk_alloc;
+	ba.ta_bulk_free = count_bulk_free;
+	ba.ta_ctx = &cnt;
+	cnt.most = 1 << 20;	/* slabs, but not a chunk of every node */
+	if (bst_allocator(&ba) == FALSE || bst_copy(tnb, tncp) == FALSE || bst_allocator(NULL) == FALSE
+	    || bst_ident(tnb, tncp) == FALSE || bst_verify(tncp, NULL) == FALSE
+	    || bst_mem_stats(tncp, &ms) == FALSE || ms.ms_chunked != 0)
+	    lost++;		/* not node by node */
+	bst_delete(tncp);
+	bst_delete(tnb);
+	if (lost != 0 || cnt.out != 0 || cnt.bulk != 0)
+	    printf("\007  ### LARGE COPY IS NOT IDENTICAL: %d ###\n\n", lost);
+	else
+	    printf("success: copy of '%s' is identical, in parallel and node by node\n", tnb);
+    }
+    printf("------------------- end of copy -------------------------\n\n\n");
+
+    /* the same large tree, verified in parallel, with the first key of the right subtree */
+    /* of the root made to sort before the root: only the top nodes can tell it is wrong  */
+    printf("------------------ begin verify of [%d] records -----------------------\n", BIGSIZ);
+    if (bst_create(tnb, AVL, sizeof(Leaf), FALSE, f, NULL, TREE_VERIFY_NO) == FALSE)
+	printf("\007  ### CANNOT CREATE TREE: %s: %s ###\n\n", tnb, bst_errmsg(bst_errno));
+    else {
+	for (lost = 0, pv = NULL, i = 0; i < BIGSIZ; i++)
+	    if ((l = (Leaf *) bst_alloc(tnb)) == NULL)
+		lost++;
+	    else {
+		sprintf(l->key, "%010d", i);
+		if (bst_put_adopt(tnb, l) == FALSE) {
+		    lost++;
+		    bst_release(tnb, l);
+		} else if (i == BIGSIZ / 2 + 1)
+		    pv = l;	/* adopted, so still the node in the tree */
+	    }
+	if (pv == NULL || bst_verify(tnb, &vr) == FALSE)
+	    lost++;
+	else {
+	    sprintf(pv->key, "%010d", BIGSIZ / 2 - 1);
+	    if (bst_verify(tnb, &vr) == TRUE || vr.tv_errno != KEY_ORDER_ERR || vr.tv_leaf != (void *) pv)
+		lost++;
+	    sprintf(pv->key, "%010d", BIGSIZ / 2 + 1);
+	    if (bst_verify(tnb, &vr) == FALSE)
+		lost++;
+	}
+	bst_delete(tnb);
+	if (lost != 0)
+	    printf("\007  ### PARALLEL VERIFY MISSED A KEY OUT OF ORDER: %d ###\n\n", lost);
+	else
+	    printf("success: parallel verify of '%s' finds a key out of order under the root\n", tnb);
+    }
+    printf("------------------- end of verify -------------------------\n\n\n");
+
+    /* a tree checked along the path of each bst_put and bst_remove, churned, then with */
+    /* a parent link and a balance factor next to the root made wrong in turn          */
+    printf("------------------ begin path verify of [%d] records -----------------------\n", PATHSIZ);
+    if (bst_create(tnp, AVL, sizeof(Leaf), FALSE, f, NULL, TREE_VERIFY_PATH) == FALSE)
+	printf("\007  ### CANNOT CREATE TREE: %s: %s ###\n\n", tnp, bst_errmsg(bst_errno));
+    else {
+	/* the nodes of keys below PATHSIZ are adopted and kept, those above come and go */
+	for (lost = 0, i = 0; i < PATHSIZ; i++)
+	    if ((pkeep[i] = (Leaf *) bst_alloc(tnp)) == NULL)
+		lost++;
+	    else {
+		sprintf(pkeep[i]->key, "%06d", i * 7 % PATHSIZ);
+		if (bst_put_adopt(tnp, pkeep[i]) == FALSE || bst_errno != 0)
+		    lost++;
+	    }
+	pb = (Leaf *) bst_alloc(tnp);
+	for (j = 0; j < 4 * PATHSIZ && lost == 0; j++) {
+	    sprintf(pb->key, "%06d", PATHSIZ + rand() % PATHSIZ);
+	    if ((rand() % 2 == 0 ? bst_put(tnp, pb) : bst_remove(tnp, pb)) == TRUE && bst_errno != 0)
+		lost++;
+	}
+	if (bst_verify(tnp, NULL) == FALSE)
+	    lost++;
+
+#ifdef DEBUG_EXPLOIT_TREE_HDR
+	/* user space should not know about this detail, how to get to the tree header record */
+	{
+	    t_node *root, *s, *u;
+	    int bf;
+
+	    printf("two errors are to be reported below:\n");
+	    for (root = ((t_node *) pkeep[0]) - 1; root->tn_ulink != NULL; root = root->tn_ulink);
+
+	    /* the right son taken for a son of the left: the next bst_put finds it */
+	    if ((s = root->tn_rlink) != NULL && root->tn_llink != NULL) {
+		u = s->tn_ulink;
+		s->tn_ulink = root->tn_llink;
+		strcpy(pb->key, "999999");
+		if (bst_put(tnp, pb) == FALSE || bst_errno != ULINK_ERR)
+		    lost++;
+		s->tn_ulink = u;
+		if (bst_remove(tnp, pb) == FALSE || bst_errno != 0)
+		    lost++;
+	    }
+
+	    /* the balance factor of the son of the root the next bst_remove does not pass: */
+	    /* the removal is on the side that is not the shorter, so the root keeps its sons */
+	    strcpy(pb->key, root->tn_bf > 0 ? "000003" : "000999");
+	    if ((s = root->tn_bf > 0 ? root->tn_rlink : root->tn_llink) != NULL) {
+		bf = s->tn_bf;
+		s->tn_bf = bf == 0 ? 1 : 0;
+		if (bst_remove(tnp, pb) == FALSE || bst_errno != BALANCE_ERR)
+		    lost++;
+		s->tn_bf = bf;
+	    }
+	}
+#endif
+	bst_release(tnp, pb);
+	bst_delete(tnp);
+	if (lost != 0)
+	    printf("\007  ### %d CHANGES OF PATH VERIFIED TREE WRONGLY CHECKED ###\n\n", lost);
+	else
+	    printf("success: path verified tree '%s' churns cleanly and reports a bad link and balance\n", tnp);
+    }
+    printf("------------------- end of path verify -------------------------\n\n\n");
+
+    /* frozen with a copy of its layout on each NUMA node, searched on that of this thread */
+    printf("------------------ begin freeze of [%d] records -----------------------\n", ARRSIZ);
+    if (bst_numa(tn, NUMA_REPLICATE + 1) == TRUE || bst_numa(tn, NUMA_REPLICATE) == FALSE || bst_freeze(tn) == FALSE)
+	printf("\007  ### CANNOT FREEZE TREE: %s: %s ###\n\n", tn, bst_errmsg(bst_errno));
+    else if (bst_verify(tn, NULL) == FALSE)
+	printf("\007  ### FROZEN TREE IS NOT SOUND: %s: %s ###\n\n", tn, bst_errmsg(bst_errno));
+    else {
+	for (lost = 0, i = 0; i < ARRSIZ; i++) {
+	    memset(pk->key, '\0', LEAF_KEYLEN + 1);
+	    strcpy(pk->key, arrkey[i]);
+	    if ((l = (Leaf *) bst_get(tn, pk)) == NULL)
+		lost++;
+	    else
+		bst_release(tn, l);
+	}
+	if (lost != 0)
+	    printf("\007  ### %d KEYS NOT FOUND IN FROZEN TREE ###\n\n", lost);
+	else if (bst_put(tn, pk) == TRUE)
+	    printf("\007  ### FROZEN TREE TOOK A bst_put ###\n\n");
+	else
+	    printf("success: frozen tree '%s' finds all keys and is read only\n", tn);
+    }
+    bst_thaw(tn);
+    printf("------------------- end of freeze -------------------------\n\n\n");
+
+    /* the key index must find just what find_node finds: each key and each key with a '0' added */
+    printf("------------------ begin keyed freeze of [%d] records -----------------------\n", ARRSIZ);
+    for (j = 0; j < 2; j++) {
+	if (j == 1 && bst_freeze_keys(tn, prefix) == FALSE) {
+	    printf("\007  ### CANNOT FREEZE TREE WITH KEYS: %s: %s ###\n\n", tn, bst_errmsg(bst_errno));
+	    break;
+	}
+	for (missing = 0, i = 0; i < 2 * ARRSIZ; i++) {
+	    memset(pk->key, '\0', LEAF_KEYLEN + 1);
+	    strcpy(pk->key, arrkey[i / 2]);
+	    if (i % 2)
+		strcat(pk->key, "0");
+	    if ((l = (Leaf *) bst_get(tn, pk)) != NULL)
+		bst_release(tn, l);
+	    if (j == 0)
+		found[i / 2][i % 2] = l != NULL;
+	    else if (found[i / 2][i % 2] != (l != NULL)) {
+		printf("\007  ### KEY INDEX AND find_node DIFFER ON '%s' ###\n\n", pk->key);
+		missing++;
+	    }
+	}
+    }
+    if (j == 2 && missing == 0)
+	printf("success: key index of '%s' finds what find_node finds\n", tn);
+    bst_thaw(tn);
+    bst_numa(tn, NUMA_INTERLEAVE);	/* its pages spread over the NUMA nodes from here on */
+    printf("------------------- end of keyed freeze -------------------------\n\n\n");
+
+    /* the same keys in a tree ordered by a built in string key rather than by f */
+    printf("------------------ begin built in key of [%d] records -----------------------\n", ARRSIZ);
+    bk.tk_type = KEY_STRING;
+    bk.tk_offset = offsetof(Leaf, key);
+    bk.tk_len = LEAF_KEYLEN + 1;
+    if (bst_create_key(tnk, AVL, sizeof(Leaf), FALSE, &bk, Print_Node, TREE_VERIFY_NO) == FALSE)
+	printf("\007  ### CANNOT CREATE TREE: %s: %s ###\n\n", tnk, bst_errmsg(bst_errno));
+    else {
+	bst_key_prefix(tnk, NULL);
+	pb = (Leaf *) bst_alloc(tnk);
+	for (lost = 0, j = 0; j < 3; j++) {
+	    if (j == 1 && ((l = (Leaf *) bst_get(tnk, pb)) == NULL || bst_put_adopt(tnk, l) == TRUE))
+		lost++;		/* pb holds a key already in the tree */
+	    else if (j == 1)
+		bst_release(tnk, l);
+	    if (j == 1 && (bst_verify(tnk, NULL) == FALSE || bst_freeze(tnk) == FALSE)) {
+		printf("\007  ### BUILT IN KEY TREE IS NOT SOUND: %s: %s ###\n\n", tnk, bst_errmsg(bst_errno));
+		lost++;
+		break;
+	    }
+	    if (j == 2)
+		bst_thaw(tnk);
+	    for (i = 0; i < ARRSIZ; i++) {
+		memset(pb->key, '\0', LEAF_KEYLEN + 1);
+		strcpy(pb->key, arrkey[i]);
+		if (j == 0) {
+		    /* every other leaf goes in itself rather than a copy of it, and every */
+		    /* other pair of nodes is malloc'd by itself rather than slabbed:      */
+		    bst_huge_pages(i % 4 < 2);
+		    if (i % 2 == 0 && bst_put(tnk, pb) == FALSE)
+			lost++;
+		    else if (i % 2 == 1 && (l = (Leaf *) bst_alloc(tnk)) != NULL) {
+			strcpy(l->key, arrkey[i]);
+			if (bst_put_adopt(tnk, l) == FALSE) {
+			    lost++;
+			    bst_release(tnk, l);
+			}
+		    }
+		} else if (j == 1 && (l = (Leaf *) bst_get(tnk, pb)) != NULL) {
+		    bst_release(tnk, l);
+		    if ((l = (Leaf *) bst_find_key(tnk, arrkey[i])) == NULL)
+			lost++;
+		    else if (strcmp(l->key, arrkey[i]) != 0 || bst_release(tnk, l) == FALSE)
+			lost++;
+		} else if (j == 1 || (j == 2 && bst_remove(tnk, pb) == FALSE))
+		    lost++;
+	    }
+	}
+	bst_huge_pages(TRUE);
+	if (lost != 0 || bst_empty(tnk) == FALSE)
+	    printf("\007  ### %d KEYS LOST IN BUILT IN KEY TREE ###\n\n", lost);
+	else
+	    printf("success: built in key tree '%s' adds, finds and removes all keys\n", tnk);
+	bst_release(tnk, pb);
+	bst_delete(tnk);
+    }
+    printf("------------------- end of built in key -------------------------\n\n\n");
+
+    /* the same keys in leaves of a Leaf and a tail of VSIZE(i) bytes, each its own size */
+    printf("------------------ begin variable leaves of [%d] records -----------------------\n", ARRSIZ);
+    if (bst_create_key(tnv, AVL, sizeof(Leaf) + VAR_TAIL, FALSE, &bk, Print_Node, TREE_VERIFY_NO) == FALSE)
+	printf("\007  ### CANNOT CREATE TREE: %s: %s ###\n\n", tnv, bst_errmsg(bst_errno));
+    else {
+	lost = bst_alloc_size(tnv, LEAF_KEYLEN) != NULL;	/* would cut the key off */
+	for (i = 0; i < ARRSIZ; i++)
+	    if ((l = (Leaf *) bst_alloc_size(tnv, sizeof(Leaf) + VSIZE(i))) == NULL)
+		lost++;
+	    else {
+		strcpy(l->key, arrkey[i]);
+		memset(l + 1, i, VSIZE(i));
+		if (i % 2 == 0) {
+		    if (bst_put(tnv, l) == FALSE)
+			lost++;
+		    bst_release(tnv, l);
+		} else if (bst_put_adopt(tnv, l) == FALSE) {
+		    lost++;
+		    bst_release(tnv, l);
+		}
+	    }
+
+	/* every key, then the odd ones after the even ones go, frozen and thawed */
+	for (i = 0; i < ARRSIZ; i++)
+	    lost += vleaf(tnv, arrkey[i], i);
+	for (i = 0; i < ARRSIZ; i += 2)
+	    if ((l = (Leaf *) bst_find_key(tnv, arrkey[i])) == NULL || bst_remove(tnv, l) == FALSE)
+		lost++;
+	    else
+		bst_release(tnv, l);
+	for (j = 0; j < 2; j++) {
+	    if (bst_verify(tnv, NULL) == FALSE || (j == 1 && bst_freeze(tnv) == FALSE))
+		lost++;
+	    for (i = 1; i < ARRSIZ; i += 2)
+		lost += vleaf(tnv, arrkey[i], i);
+	}
+
+	/* the frozen tree saved to a file and mapped back in as another tree */
+	if (bst_save(tnv, MAP_FILE) == FALSE || bst_open_mapped(tnm, MAP_FILE, NULL, Print_Node) == FALSE
+	    || bst_verify(tnm, NULL) == FALSE || bst_count(tnm) != bst_count(tnv))
+	    lost++;
+	else
+	    for (i = 1; i < ARRSIZ; i += 2)
+		lost += vleaf(tnm, arrkey[i], i);
+	bst_delete(tnm);
+	remove(MAP_FILE);
+
+	/* and its leaves dumped and restored as another tree */
+	if (bst_dump(tnv, DUMP_FILE) == FALSE || bst_restore(tnm, DUMP_FILE, NULL, Print_Node) == FALSE
+	    || bst_verify(tnm, NULL) == FALSE || bst_equal(tnv, tnm) == FALSE)
+	    lost++;
+	else
+	    for (i = 1; i < ARRSIZ; i += 2)
+		lost += vleaf(tnm, arrkey[i], i);
+	bst_delete(tnm);
+	remove(DUMP_FILE);
+	bst_thaw(tnv);
+	for (i = 1; i < ARRSIZ; i += 2)
+	    if ((l = (Leaf *) bst_find_key(tnv, arrkey[i])) == NULL || bst_remove(tnv, l) == FALSE)
+		lost++;
+	    else
+		bst_release(tnv, l);
+	if (lost != 0 || bst_empty(tnv) == FALSE)
+	    printf("\007  ### %d KEYS LOST IN VARIABLE LEAF TREE ###\n\n", lost);
+	else
+	    printf("success: variable leaf tree '%s' keeps the size and data of each leaf, saved and dumped too\n", tnv);
+	bst_delete(tnv);
+    }
+    printf("------------------- end of variable leaves -------------------------\n\n\n");
+
+    /* the keys logged as they go into a tree and half of them out again after a */
+    /* checkpoint, then the checkpoint restored and the log replayed into another */
+    printf("------------------ begin write ahead log of [%d] records -----------------------\n", ARRSIZ);
+    remove(WAL_FILE);
+    if (bst_create_key(tnk, AVL, sizeof(Leaf), FALSE, &bk, Print_Node, TREE_VERIFY_NO) == FALSE
+	|| bst_wal_open(tnk, WAL_FILE, WAL_FSYNC) == FALSE)
+	printf("\007  ### CANNOT LOG TREE: %s: %s ###\n\n", tnk, bst_errmsg(bst_errno));
+    else {
+	lost = 0;
+	for (j = 0; j < 2; j++) {
+	    if (j == 1 && bst_checkpoint(tnk, DUMP_FILE) == FALSE)
+		lost++;
+	    for (i = j; i < ARRSIZ; i += j + 1)
+		if ((l = (Leaf *) bst_find_key(tnk, arrkey[i])) != NULL) {
+		    if (j == 0 || bst_remove(tnk, l) == FALSE)
+			lost++;
+		    bst_release(tnk, l);
+		} else if (j == 0 && (l = (Leaf *) bst_alloc(tnk)) != NULL) {
+		    strcpy(l->key, arrkey[i]);
+		    if (bst_put(tnk, l) == FALSE)
+			lost++;
+		    bst_release(tnk, l);
+		} else
+		    lost++;
+	}
+	if (bst_wal_close(tnk) == FALSE || bst_restore(tnm, DUMP_FILE, NULL, Print_Node) == FALSE
+	    || bst_count(tnm) != ARRSIZ || bst_wal_open(tnm, WAL_FILE, WAL_NONE) == FALSE
+	    || bst_count(tnm) != ARRSIZ / 2 || bst_equal(tnk, tnm) == FALSE)
+	    lost++;
+	if (lost != 0)
+	    printf("\007  ### %d KEYS LOST IN WRITE AHEAD LOG ###\n\n", lost);
+	else
+	    printf("success: log of '%s' replayed over its checkpoint gives the same tree\n", tnk);
+	bst_delete(tnm);
+	remove(DUMP_FILE);
+	remove(WAL_FILE);
+    }
+    bst_delete(tnk);
+    printf("------------------- end of write ahead log -------------------------\n\n\n");
+
+    /* a copy of the tree, changed, frozen and thawed in the memory of an allocator */
+    /* that counts what it hands out, all of which must come back with the copy   */
+    printf("------------------ begin allocator of [%d] records -----------------------\n", ARRSIZ);
+    memset(&cnt, 0, sizeof(cnt));
+    memset(&ba, 0, sizeof(ba));
+    ba.ta_bulk_alloc = count_bulk_alloc;
+    ba.ta_bulk_free = count_bulk_free;
+    lost = bst_allocator(&ba) == TRUE;	/* bulk functions need ta_alloc */
+    ba.ta_alloc = count_alloc;
+    ba.ta_free = count_free;
+    ba.ta_ctx = &cnt;
+    if (lost != 0 || bst_allocator(&ba) == FALSE || bst_copy(tn, tncp) == FALSE || bst_allocator(NULL) == FALSE)
+	printf("\007  ### CANNOT COPY TREE TO AN ALLOCATOR: %s: %s ###\n\n", tncp, bst_errmsg(bst_errno));
+    else {
+	pb = (Leaf *) bst_alloc(tncp);
+	for (i = 0; i < ARRSIZ; i += 2) {
+	    strcpy(pb->key, arrkey[i]);
+	    if (bst_remove(tncp, pb) == FALSE)
+		lost++;
+	}
+	bst_release(tncp, pb);
+	for (i = 0; i < ARRSIZ; i += 2)
+	    if ((l = (Leaf *) bst_alloc_size(tncp, offsetof(Leaf, data))) == NULL)
+		lost++;
+	    else {
+		strcpy(l->key, arrkey[i]);
+		if (bst_put_adopt(tncp, l) == FALSE) {
+		    lost++;
+		    bst_release(tncp, l);
+		}
+	    }
+	if (bst_verify(tncp, NULL) == FALSE || bst_count(tncp) != ARRSIZ || bst_freeze_keys(tncp, NULL) == FALSE
+	    || bst_thaw(tncp) == FALSE || bst_compact(tncp, 0) != 0 || bst_verify(tncp, NULL) == FALSE)
+	    lost++;
+	if (cnt.out == 0 || cnt.bulk == 0)
+	    lost++;		/* the copy is not in the allocator */
+	bst_delete(tncp);
+	if (lost != 0 || cnt.out != 0 || cnt.bulk != 0 || cnt.bytes != 0)
+	    printf("\007  ### %d KEYS LOST IN ALLOCATOR, %li PIECES NOT BACK ###\n\n", lost, cnt.out + cnt.bulk);
+	else
+	    printf("success: copy '%s' took all of its %li pieces of memory from the allocator and gave them back\n",
+		   tncp, cnt.calls);
+    }
+    printf("------------------- end of allocator -------------------------\n\n\n");
+
+    /* a tree of the keys made a multimap, its subtree counts past a Leaf, with two more */
+    /* leaves of each key put in; a count not aligned in the leaf is refused             */
+    printf("------------------ begin multimap of [%d] records -----------------------\n", ARRSIZ);
+    if (bst_create(tncp, AVL, COUNT_OFF + sizeof(long), FALSE, f, NULL, TREE_VERIFY_NO) == FALSE)
+	printf("\007  ### CANNOT MAKE A MULTIMAP: %s: %s ###\n\n", tncp, bst_errmsg(bst_errno));
+    else {
+	pb = (Leaf *) bst_alloc(tncp);
+	for (lost = 0, j = 0; j <= 2; j++)
+	    for (i = 0; i < ARRSIZ; i++) {
+		strcpy(pb->key, arrkey[i]);
+		pb->data = j;
+		if (bst_put(tncp, pb) == FALSE)
+		    lost++;
+		if (j == 0 && i == ARRSIZ - 1
+		    && (bst_multimap(tncp, TRUE, COUNT_OFF + 1) == TRUE || bst_multimap(tncp, TRUE, COUNT_OFF) == FALSE))
+		    lost++;
+	    }
+	if (bst_verify(tncp, NULL) == FALSE || bst_count(tncp) != 3 * ARRSIZ || bst_multimap(tncp, FALSE, 0) == TRUE)
+	    lost++;
+	/* a log replayed over a checkpoint would put the leaves of a multimap in twice */
+	if (bst_wal_open(tncp, WAL_FILE, WAL_NONE) == TRUE)
+	    lost++;
+	/* the leaves of a key come in the order they were put, and the first goes first */
+	for (i = 0; i < ARRSIZ; i++) {
+	    strcpy(pb->key, arrkey[i]);
+	    if (bst_count_key(tncp, pb) != 3 || bst_equal_range(tncp, pb, &cur) == FALSE)
+		lost++;
+	    for (j = 0; (l = (Leaf *) bst_cursor_next(tncp, &cur)) != NULL; j++) {
+		if (strcmp(l->key, arrkey[i]) != 0 || l->data != j)
+		    lost++;
+		bst_release(tncp, l);
+	    }
+	    if (j != 3 || bst_remove(tncp, pb) == FALSE || (l = (Leaf *) bst_get(tncp, pb)) == NULL)
+		lost++;
+	    else {
+		if (l->data != 1)
+		    lost++;
+		bst_release(tncp, l);
+	    }
+	}
+	if (bst_verify(tncp, NULL) == FALSE || bst_count(tncp) != 2 * ARRSIZ)
+	    lost++;
+	bst_release(tncp, pb);
+	bst_delete(tncp);
+	if (lost != 0)
+	    printf("\007  ### %d KEYS OUT OF ORDER IN MULTIMAP ###\n\n", lost);
+	else
+	    printf("success: multimap '%s' keeps the leaves of each key in the order they were put\n", tncp);
+    }
+    printf("------------------- end of multimap -------------------------\n\n\n");
+
+    /* the sum of the data of any range of keys, from the sums each node keeps of its subtree */
+    printf("------------------ begin aggregate of [%d] records -----------------------\n", ARRSIZ);
+    if (bst_create(tna, AVL, SUMS_OFF + sizeof(struct sums), FALSE, f, NULL, TREE_VERIFY_NO) == FALSE
+	|| bst_aggregate(tna, SUMS_OFF, sizeof(struct sums), sums) == FALSE)
+	printf("\007  ### CANNOT GIVE A TREE AN AGGREGATE: %s: %s ###\n\n", tna, bst_errmsg(bst_errno));
+    else {
+	pb = (Leaf *) bst_alloc(tna);
+	l = (Leaf *) bst_alloc(tna);
+	for (lost = 0, i = 0; i < ARRSIZ; i++) {
+	    strcpy(pb->key, arrkey[i]);
+	    pb->data = i;
+	    if (bst_put(tna, pb) == FALSE)
+		lost++;
+	}
+	for (j = 0; j < 2 * ARRSIZ; j++) {
+	    /* keys from that of arrkey[rand1] to that of arrkey[rand2], either way round */
+	    rand1 = rand() % ARRSIZ;
+	    rand2 = rand() % ARRSIZ;
+	    strcpy(pb->key, arrkey[rand1]);
+	    strcpy(l->key, arrkey[rand2]);
+	    for (sb.sum = sb.n = 0, i = 0; i < ARRSIZ; i++)
+		if (strcmp(arrkey[i], pb->key) >= 0 && strcmp(arrkey[i], l->key) <= 0) {
+		    sb.sum += i;
+		    sb.n++;
+		}
+	    if (bst_aggregate_range(tna, pb, l, &sg) == FALSE || sg.sum != sb.sum || sg.n != sb.n)
+		lost++;
+	}
+	for (i = 0; i < ARRSIZ; i += 2) {
+	    strcpy(pb->key, arrkey[i]);
+	    if (bst_remove(tna, pb) == FALSE)
+		lost++;
+	}
+	if (bst_aggregate_range(tna, NULL, NULL, &sg) == FALSE || sg.n != ARRSIZ / 2
+	    || sg.sum != (long) (ARRSIZ / 2) * (ARRSIZ / 2) || bst_verify(tna, NULL) == FALSE)
+	    lost++;
+	bst_release(tna, pb);
+	bst_release(tna, l);
+	if (lost != 0)
+	    printf("\007  ### %d RANGES WITH THE WRONG SUM ###\n\n", lost);
+	else
+	    printf("success: aggregate tree '%s' sums the data of any range of keys\n", tna);
+    }
+    bst_delete(tna);
+    printf("------------------- end of aggregate -------------------------\n\n\n");
+
+    /* key prefixes are kept from here on, so the deletions below go by them as well */
+    printf("------------------ begin key prefix of [%d] records -----------------------\n", ARRSIZ);
+    bst_stats(tn, &st0);
+    if (bst_key_prefix(tn, prefix) == FALSE || bst_verify(tn, NULL) == FALSE)
+	printf("\007  ### KEY PREFIXES ARE NOT SOUND: %s: %s ###\n\n", tn, bst_errmsg(bst_errno));
+    else {
+	for (lost = 0, i = 0; i < ARRSIZ; i++) {
+	    memset(pk->key, '\0', LEAF_KEYLEN + 1);
+	    strcpy(pk->key, arrkey[i]);
+	    if ((l = (Leaf *) bst_get(tn, pk)) == NULL)
+		lost++;
+	    else
+		bst_release(tn, l);
+	}
+	bst_stats(tn, &st);
+
+	/* the same keys by themselves, with no leaf, and one that is not there */
+	if (bst_find_key(tn, arrkey[0]) != NULL)
+	    lost++;
+	bst_key_compare(tn, fkey);
+	for (i = 0; i < ARRSIZ; i++)
+	    if ((l = (Leaf *) bst_find_key(tn, arrkey[i])) == NULL || strcmp(l->key, arrkey[i]) != 0)
+		lost++;
+	    else
+		bst_release(tn, l);
+	if (bst_find_key(tn, "") != NULL)
+	    lost++;
+	if (lost != 0)
+	    printf("\007  ### %d KEYS NOT FOUND BY PREFIX ###\n\n", lost);
+	else
+	    printf("success: key prefixes of '%s' decided %lu compares, %lu went to f\n", tn, st.st_pfx - st0.st_pfx,
+		   st.st_cmp - st0.st_cmp);
+    }
+    printf("------------------- end of key prefix -------------------------\n\n\n");
+
     printf("------------------ begin tree print of [%d] records -----------------------\n", ARRSIZ);
     if (ARRSIZ < MAX_DISPLAY) {
 	bst_print(tn);
@@ -225,6 +897,40 @@ int main(int argc, char *argv[])
 
 }
 
+/* count_alloc: malloc, counted in the struct counts at ctx */
+void *count_alloc(void *ctx, size_t size)
+{
+    ((struct counts *) ctx)->out++;
+    ((struct counts *) ctx)->calls++;
+    return (malloc(size));
+}
+
+/* count_free: free, counted */
+void count_free(void *ctx, void *p)
+{
+    ((struct counts *) ctx)->out--;
+    free(p);
+}
+
+/* count_bulk_alloc: malloc of a chunk or slab, counted with its bytes; NULL if over most */
+void *count_bulk_alloc(void *ctx, size_t size)
+{
+    if (((struct counts *) ctx)->most != 0 && size > ((struct counts *) ctx)->most)
+	return (NULL);
+    ((struct counts *) ctx)->bulk++;
+    ((struct counts *) ctx)->bytes += size;
+    ((struct counts *) ctx)->calls++;
+    return (malloc(size));
+}
+
+/* count_bulk_free: free of a chunk or slab, counted with the bytes it is said to be */
+void count_bulk_free(void *ctx, void *p, size_t size)
+{
+    ((struct counts *) ctx)->bulk--;
+    ((struct counts *) ctx)->bytes -= size;
+    free(p);
+}
+
 void itoa(int n, char s[])
 {
     int i, sign;
@@ -263,6 +969,38 @@ int f(Leaf * r1, Leaf * r2)
 	return 1;
 }
 
+/* fkey: compare a bare key to the key of a leaf as f does, for bst_find_key */
+int fkey(const void *key, Leaf * r)
+{
+    int c;
+
+    c = strcmp(key, r->key);
+    return ((c > 0) - (c < 0));
+}
+
+/* sums: the sum and number of the data of a leaf and of the subtrees either side of it */
+void sums(void *agg, const void *left, const Leaf * pl, const void *right)
+{
+    struct sums *s = agg;
+    const struct sums *l = left, *r = right;
+
+    s->sum = (l == NULL ? 0 : l->sum) + (pl == NULL ? 0 : pl->data) + (r == NULL ? 0 : r->sum);
+    s->n = (l == NULL ? 0 : l->n) + (pl == NULL ? 0 : 1) + (r == NULL ? 0 : r->n);
+}
+
+/* prefix: first 8 bytes of the key read big endian, which sort as the keys do */
+unsigned long prefix(Leaf * pl)
+{
+    int i, end;
+    unsigned long u;
+
+    for (i = 0, u = 0, end = 0; i < 8; i++) {
+	end = end || pl->key[i] == '\0';
+	u = u << 8 | (end ? 0 : (unsigned char) pl->key[i]);
+    }
+    return (u);
+}
+
 
 /*
 #define TAB_COL   30
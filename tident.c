@@ -70,6 +70,7 @@ Boolean bst_ident(char *t1, char *t2)
 
     t_header *ph1, *ph2;
     t_header *find_header(char *);	/* to retrieve the tree header record */
+    void tmaplinks(t_header * ph);
 
     Boolean twalk(TWalkOps op, Traversals order, ...);
 
@@ -87,6 +88,7 @@ Boolean bst_ident(char *t1, char *t2)
 	bst_errno = BST_ERR_FIRST_TREE_UNDEF;
 	return (FALSE);
     }
+    tmaplinks(ph1);
 
     /* Verify the length of the 2nd tree name: */
     if (strlen(t2) < MIN_TREE_NAME_LEN) {
@@ -99,6 +101,7 @@ Boolean bst_ident(char *t1, char *t2)
 	bst_errno = BST_ERR_SECOND_TREE_UNDEF;
 	return (FALSE);
     }
+    tmaplinks(ph2);
 
     /* Check if the users data size is the same for both trees. If so, there is still no  */
     /* guarentee that the structures are really the same -- which can cause a segmentaion */
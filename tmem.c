@@ -20,6 +20,8 @@
 */
 
 #include <stdarg.h>
+#include <stdint.h>
+#include <sys/mman.h>
 
 #ifndef BST_HDR
 #include "bst.h"
@@ -27,9 +29,30 @@
 
 #define  OUT_OF_MEM  NULL
 
+/* a slab of a tree and how many of its nodes are free, for tslabtrim */
+struct slabuse {
+    t_chunk *pc;		/* the slab */
+    long nfree;			/* its free nodes; -1 once it is to go */
+    int huge;			/* it is on ts_huge */
+};
+
 static char *RCSid[] = { "$Id: tmem.c,v 2.1 1999/01/02 17:08:43 roger Exp $" };
 
 extern int bst_errno;
+extern Boolean thuge_on;
+extern t_alloc talloc_def;
+
+void *tmalloc(t_header * ph, size_t size);
+void tmfree(t_header * ph, void *p);
+extern void tnumaplace(t_header * ph, void *p, long bytes);
+extern void trepfree(t_header * ph);
+static int tslabclass(int size);
+static int tslabsize(int c);
+static t_chunk *tslabnew(t_header * ph, long stride);
+static void *tbulk(t_header * ph, long size);
+static void tbulkfree(t_header * ph, t_chunk * pc);
+static int tslabcmp(const void *a, const void *b);
+static long tslabof(struct slabuse *pu, long n, void *p);
 
 
 /* tallocm: central memory allocator for the library */
@@ -40,25 +63,79 @@ void *tallocm(MallocTypes mkind, ...)
   *  that need to make a dynamic memory allocataion is perfomed with tallocm. 
   *  Exceptions to this are the library calls to strdup. All tree nodes returned
   *  whether new or used are  zeroed out via memset to guarentee a blank node.
+  *  A node of fewer bytes than th_usiz is carved from a slab of nodes of its
+  *  size class rather than malloc'd at th_usiz; see T_NODE below. "malloc"
+  *  below is the allocator of the tree (see bst_allocator and tmalloc).
   *
   *  Input Parameters
   *  =================
   *  tallocm uses a variable argument list
-  *  USAGE: ph = (t_header *) tallocm(T_HEADER, sizeof(t_header);
-  *         pn = (t_node *) tallocm(T_NODE, ph);
+  *  USAGE: ph = (t_header *) tallocm(T_HEADER, sizeof(t_header));
+  *         pn = (t_node *) tallocm(T_NODE, ph, size);
+  *         pn = (t_node *) tallocm(T_CHUNK, ph, nnodes);
+  *         pn = (t_node *) tallocm(T_TRYCHUNK, ph, nnodes);
+  *         pf = (t_frzidx *) tallocm(T_FRZIDX, ph, nblocks);
+  *         pn = (t_node *) tallocm(T_MAP, ph, fd, size, offset, nnodes, stride);
   *
   *  If mkind is T_HEADER, then allocate a new tree header record:
   *        mkind : Is T_Header
   *        size  : Number of bytes to allocate
+  *  The header's zeroed operation counters, th_stats, are allocated with it.
+  *  The header comes from the allocator of new trees, talloc_def, which is
+  *  copied into th_alloc for all else the tree allocates.
   *
   *  If mkind is T_NODE, then allocate a new tree node:
   *        mkind : Is T_NODE
   *        ph    : Is pointer to the header record for this tree
+  *        size  : Bytes (int) of users data in the node; at most th_usiz
+  *  If size rounded up to its size class is still less than th_usiz, the node
+  *  comes from the free nodes of that class or from a slab of SLAB_BYTES, both
+  *  in ph->th_slab, and tn_slab is set to 1 + the class. Such a node is never
+  *  freed by itself; the slabs go back with tfreem(T_SLAB, ph). Otherwise the
+  *  node has th_usiz bytes; while thuge_on it is slabbed the same way as one
+  *  of class SLAB_CLASSES, else malloc'd by itself as ever. Once the slabs of
+  *  a tree come to HUGE_BYTES, each new one is a huge page (see tslabnew).
+  *  tn_usiz is set to size in every case.
+  *
+  *  If mkind is T_CHUNK, then allocate nnodes tree nodes in one piece:
+  *        mkind : Is T_CHUNK
+  *        ph    : Is pointer to the header record for this tree
+  *        nnodes: Number of nodes (long) to lay out in the chunk
+  *  The chunk is linked into ph->th_clist and is only freed as a whole by
+  *  tfreem(T_CHUNK, ph). The nodes are NOT zeroed; the caller fills in each
+  *  node, including tn_chunk, as it hands them out.
+  *  While thuge_on the huge pages within a chunk of more than HUGE_BYTES are
+  *  madvise'd to be backed by transparent huge pages, unless the chunk is of
+  *  an allocator of the user.
+  *
+  *  If mkind is T_TRYCHUNK, the same as T_CHUNK, but a chunk that can not be
+  *  had is not told of on stderr: the caller has another way to do without.
+  *
+  *  If mkind is T_FRZIDX, then allocate the key index of a frozen tree in one piece:
+  *        mkind : Is T_FRZIDX
+  *        ph    : Is pointer to the header record for this tree
+  *        nblocks: Number of blocks (long) of FRZ_KEYS keys
+  *  tf_keys starts on a 64 byte boundary so each block is one cache line.
+  *
+  *  If mkind is T_MAP, then map a tree file of bst_save copy on write:
+  *        mkind : Is T_MAP
+  *        ph    : Is pointer to the header record for this tree
+  *        fd    : Open file descriptor (int) of the file
+  *        size  : Bytes (long) of the file to map
+  *        offset: Bytes (long) from the start of the file to its first node
+  *        nnodes: Number of nodes (long) in the file
+  *        stride: Bytes (long) from one node to the next
+  *  The mapping is kept in ph->th_map and ph->th_mlen. A chunk with no nodes
+  *  of its own, telling the number and stride of those in the file, is linked
+  *  into ph->th_clist as for T_CHUNK. If mmap fails bst_errno is BST_ERR_MAP_IO.
   *
   *  Output Parameters
   *  =================
   *  p : If mkind is T_HEADER, p is pointing to a newly allocated header record
   *      If mkind is T_NODE, p pointing to to a newly allocated tree node
+  *      If mkind is T_CHUNK or T_TRYCHUNK, p pointing to the first node of the chunk
+  *      If mkind is T_FRZIDX, p pointing to the index with its arrays set
+  *      If mkind is T_MAP, p pointing to the first node in the mapped file
   *
   *  p is NULL, pointer to a header record, or pointer to a tree node on exit
   *
@@ -71,11 +148,23 @@ void *tallocm(MallocTypes mkind, ...)
   *  bst_errno  : Global error varible. Set only if an error occurs
   *******************************************************************************/
 
-    int size;			/* bytes to allocate */
+    long size;			/* bytes to allocate */
+    int usiz;			/* bytes of users data in a new node */
+    int c;			/* size class of a new node */
+    int fd;			/* file descriptor of a tree file */
+    long offset;		/* bytes from the start of a tree file to its nodes */
+    long stride;		/* bytes from one node to the next in a slab */
+    long nnodes;		/* nodes to lay out in a chunk */
+    long nblocks;		/* blocks of keys in a frozen key index */
+    t_frzidx *pf;		/* pointer to a new frozen key index */
+    void *base;			/* memory of a frozen key index, tf_keys aligned in it */
     void *p;			/* generic pointer to a t_header or a t_node */
+    t_chunk *pc;		/* pointer to a new chunk of nodes */
     va_list ap;			/* formal function argument pointer */
     Boolean error;		/* routine error flag */
+    Boolean quiet;		/* an error is not told of on stderr */
     t_header *ph;		/* pointer to a defined tree header record */
+    t_slabs *ps;		/* size classed nodes of a tree */
 
 #ifdef DEBUG_SHOWGRAPHS
     extern void gheader(t_header * ph);
@@ -83,13 +172,27 @@ void *tallocm(MallocTypes mkind, ...)
 #endif
 
     error = FALSE;		/* initalize */
+    quiet = FALSE;
     va_start(ap, mkind);	/* ap points to 1st argument now */
 
     switch (mkind) {
     case T_HEADER:		/* return a NEW tree header record */
 	size = (int) va_arg(ap, int);
-	if ((p = (void *) malloc(size)) == OUT_OF_MEM)
+
+	/* the zeroed operation counters of the tree follow the header in the same piece, */
+	/* each set on a cache line of its own:                                           */
+	if (talloc_def.ta_alloc == NULL)
+	    p = (void *) malloc(size + STATS_LINE - 1 + STATS_SHARDS * STATS_STRIDE);
+	else
+	    p = talloc_def.ta_alloc(talloc_def.ta_ctx, size + STATS_LINE - 1 + STATS_SHARDS * STATS_STRIDE);
+	if (p == OUT_OF_MEM)
 	    error = TRUE;
+	else {
+	    ((t_header *) p)->th_alloc = talloc_def;
+	    ((t_header *) p)->th_stats =
+		(t_stats *) (((uintptr_t) p + size + STATS_LINE - 1) / STATS_LINE * STATS_LINE);
+	    memset(((t_header *) p)->th_stats, 0, STATS_SHARDS * STATS_STRIDE);
+	}
 #ifdef DEBUG_MALLAC_USAGE
 	printf(">>> ALLOCATING MEMORY FOR T_HEADER AT 0x%-5x; %i BYTES <<<\n", p, size);
 #endif
@@ -100,6 +203,55 @@ void *tallocm(MallocTypes mkind, ...)
 	break;
     case T_NODE:		/* return a NEW or USED node */
 	ph = (t_header *) va_arg(ap, t_header *);	/* next arg */
+	usiz = va_arg(ap, int);
+
+	/* a node that is smaller than th_usiz, even rounded up to its size class, is */
+	/* taken from the free nodes of the class, else carved from a slab of them;   */
+	/* so is any other node, as one of class SLAB_CLASSES, while thuge_on:        */
+	if (usiz < ph->th_usiz && (c = tslabclass(usiz)) >= 0 && tslabsize(c) < ph->th_usiz)
+	    stride = sizeof(t_node) + tslabsize(c);
+	else if (thuge_on) {
+	    c = SLAB_CLASSES;
+	    stride = (sizeof(t_node) + ph->th_usiz + NODE_ALIGN - 1) / NODE_ALIGN * NODE_ALIGN;
+	} else
+	    c = -1;
+	if (c >= 0) {
+	    if ((ps = ph->th_slab) == NULL) {
+		if ((ps = ph->th_slab = (t_slabs *) tmalloc(ph, sizeof(t_slabs))) == NULL) {
+		    size = sizeof(t_slabs);
+		    p = NULL;
+		    error = TRUE;
+		    break;
+		}
+		memset(ps, 0, sizeof(t_slabs));
+	    }
+	    if ((p = ps->ts_free[c]) != NULL) {
+		ps->ts_free[c] = ((t_node *) p)->tn_ulink;
+		STAT_ADD(STATS(ph), st_flist, 1);
+	    } else {
+		if (ps->ts_left[c] == 0) {
+		    if ((pc = tslabnew(ph, stride)) == NULL) {
+			size = sizeof(t_chunk) + SLAB_BYTES;
+			p = NULL;
+			error = TRUE;
+			break;
+		    }
+		    ps->ts_next[c] = (char *) (pc + 1);
+		    ps->ts_left[c] = pc->tc_nnodes;
+		}
+		p = (void *) ps->ts_next[c];
+		ps->ts_next[c] += stride;
+		ps->ts_left[c]--;
+		STAT_ADD(STATS(ph), st_malloc, 1);
+	    }
+	    ((t_node *) p)->tn_chunk = 0;
+	    ((t_node *) p)->tn_slab = c + 1;
+	    ((t_node *) p)->tn_usiz = usiz;
+	    memset(((t_node *) p) + 1, 0, usiz);
+	    if (c < SLAB_CLASSES)
+		ph->th_var = TRUE;
+	    break;
+	}
 
 	/* first check and see if there are any used nodes in the free list;  if there is, */
 	/* get one from the list; else  malloc a new one. In either case zero out the node */
@@ -107,8 +259,13 @@ void *tallocm(MallocTypes mkind, ...)
 
 	if (ph->th_flist == NULL) {
 	    size = sizeof(t_node) + ph->th_usiz;
-	    if ((p = (t_node *) malloc(size)) == OUT_OF_MEM)
+	    if ((p = (t_node *) tmalloc(ph, size)) == OUT_OF_MEM)
 		error = TRUE;
+	    else {
+		((t_node *) p)->tn_chunk = 0;
+		((t_node *) p)->tn_slab = 0;
+		STAT_ADD(STATS(ph), st_malloc, 1);
+	    }
 #ifdef DEBUG_MALLAC_USAGE
 	    printf(">>> ALLOCATING MEMORY FOR T_NODE AT 0x%-5x; %i BYTES <<<\n", p, size);
 #endif
@@ -119,6 +276,7 @@ void *tallocm(MallocTypes mkind, ...)
 	    p = (t_node *) ph->th_flist;
 	    ph->th_flist = ((t_node *) p)->tn_ulink;
 	    ph->th_flcnt--;
+	    STAT_ADD(STATS(ph), st_flist, 1);
 #ifdef DEBUG_MALLAC_USAGE
 	    printf(">>> RE-USING MEMORY FOR T_NODE AT 0x%-5x; %i BYTES <<<\n", p, ph->th_usiz);
 #endif
@@ -127,19 +285,115 @@ void *tallocm(MallocTypes mkind, ...)
 #endif
 	}
 	if (!error) {
-	    memset(((t_node *) p) + 1, 0, ph->th_usiz);
+	    ((t_node *) p)->tn_usiz = usiz;
+	    memset(((t_node *) p) + 1, 0, usiz);
 	    p = (void *) p;
 #ifdef DEBUG_MALLAC_USAGE
-	    printf(">>> memset AT LOCATION 0x%-5x to 0; %i BYTES <<<\n", ((t_node *) p) + 1, ph->th_usiz);
+	    printf(">>> memset AT LOCATION 0x%-5x to 0; %i BYTES <<<\n", ((t_node *) p) + 1, usiz);
+#endif
+	}
+	break;
+    case T_TRYCHUNK:		/* as T_CHUNK, quietly NULL if it can not be had */
+	quiet = TRUE;
+	/* FALLTHROUGH */
+    case T_CHUNK:		/* return a NEW chunk of nnodes nodes */
+	ph = (t_header *) va_arg(ap, t_header *);
+	nnodes = va_arg(ap, long);
+
+	/* nodes in a chunk are NODE_ALIGN'ed so that the pointers in each t_node stay aligned: */
+	size = (sizeof(t_node) + ph->th_usiz + NODE_ALIGN - 1) / NODE_ALIGN * NODE_ALIGN;
+	if ((pc = (t_chunk *) tbulk(ph, sizeof(t_chunk) + nnodes * size)) == OUT_OF_MEM) {
+	    size = sizeof(t_chunk) + nnodes * size;
+	    p = NULL;
+	    error = TRUE;
+	    break;
+	}
+#ifdef DEBUG_MALLAC_USAGE
+	printf(">>> ALLOCATING MEMORY FOR T_CHUNK AT 0x%-5x; %li NODES OF %li BYTES <<<\n", pc, nnodes, size);
 #endif
+#ifdef MADV_HUGEPAGE
+	if (thuge_on && ph->th_alloc.ta_alloc == NULL && nnodes * size > HUGE_BYTES) {
+	    c = (((unsigned long) pc + HUGE_BYTES - 1) & ~(HUGE_BYTES - 1)) - (unsigned long) pc;
+	    madvise((char *) pc + c, (sizeof(t_chunk) + nnodes * size - c) & ~(HUGE_BYTES - 1), MADV_HUGEPAGE);
 	}
+#endif
+	pc->tc_nnodes = nnodes;
+	pc->tc_stride = size;
+	pc->tc_bytes = sizeof(t_chunk) + nnodes * size;
+	tnumaplace(ph, pc, pc->tc_bytes);
+	pc->tc_link = ph->th_clist;
+	ph->th_clist = pc;
+	p = (void *) (pc + 1);
+	break;
+    case T_FRZIDX:		/* return a NEW frozen key index */
+	ph = (t_header *) va_arg(ap, t_header *);
+	nblocks = va_arg(ap, long);
+
+	/* keys (one cache line per block) first, then the node of each key and the index; */
+	/* 63 bytes more than that, the keys being put on the first 64 byte boundary:     */
+	size = nblocks * FRZ_KEYS * (sizeof(long) + sizeof(t_node *)) + sizeof(t_frzidx);
+	if ((p = tmalloc(ph, size + 63)) == OUT_OF_MEM) {
+	    size += 63;
+	    error = TRUE;
+	    break;
+	}
+#ifdef DEBUG_MALLAC_USAGE
+	printf(">>> ALLOCATING MEMORY FOR T_FRZIDX AT 0x%-5x; %li BYTES <<<\n", p, size);
+#endif
+	base = p;
+	p = (void *) (((unsigned long) p + 63) & ~63UL);
+	pf = (t_frzidx *) ((char *) p + size - sizeof(t_frzidx));
+	pf->tf_base = base;
+	pf->tf_keys = (long *) p;
+	pf->tf_node = (t_node **) (pf->tf_keys + nblocks * FRZ_KEYS);
+	pf->tf_nblocks = nblocks;
+	p = (void *) pf;
+	break;
+    case T_MAP:		/* return the first node of a MAPPED tree file */
+	ph = (t_header *) va_arg(ap, t_header *);
+	fd = va_arg(ap, int);
+	size = va_arg(ap, long);
+	offset = va_arg(ap, long);
+	nnodes = va_arg(ap, long);
+	stride = va_arg(ap, long);
+
+	/* private, so a thawed tree can change its nodes without writing the file: */
+	if ((p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+	    bst_errno = BST_ERR_MAP_IO;
+	    p = NULL;
+	    break;
+	}
+	if ((pc = (t_chunk *) tbulk(ph, sizeof(t_chunk))) == OUT_OF_MEM) {
+	    munmap(p, size);
+	    size = sizeof(t_chunk);
+	    p = NULL;
+	    error = TRUE;
+	    break;
+	}
+#ifdef DEBUG_MALLAC_USAGE
+	printf(">>> MAPPING T_MAP AT 0x%-5x; %li BYTES <<<\n", p, size);
+#endif
+	ph->th_map = p;
+	ph->th_mlen = size;
+	pc->tc_nnodes = nnodes;
+	pc->tc_stride = stride;
+	pc->tc_bytes = sizeof(t_chunk);
+	pc->tc_link = ph->th_clist;
+	ph->th_clist = pc;
+	p = (void *) ((char *) p + offset);
+	break;
+    case T_SLAB:		/* slabs are made by tslabnew as nodes are asked for, never here */
+	size = 0;
+	p = NULL;
+	error = TRUE;
 	break;
     }
 
     va_end(ap);			/* this call is required before leaving the function */
     if (error) {
 	bst_errno = BST_ERR_MALLOC;
-	fprintf(stderr, "malloc error: cannot allocate memory %i\n", size);
+	if (!quiet)
+	    fprintf(stderr, "malloc error: cannot allocate memory %li\n", size);
     }
 
     return (p);
@@ -157,7 +411,11 @@ void tfreem(MallocTypes mkind, ...)
   *  tfreem uses a variable argument list
   *  USAGE: tfreem(T_HEADER, ph);
   *         tfreem(T_NODE, CHAIN, ph, p);
-  *         tfreem(T_NODE, FREE, p); *                                                                              |
+  *         tfreem(T_NODE, FREE, ph, p);
+  *         tfreem(T_CHUNK, ph);
+  *         tfreem(T_FRZIDX, ph);
+  *         tfreem(T_SLAB, ph);
+  *         tfreem(T_MAP, ph);
   *  if mkind is T_HEADER, then deallocate a tree header record:
   *       mkind : Is T_HEADER
   *       ph    : Is a pointer to the header record to deallocate
@@ -168,8 +426,32 @@ void tfreem(MallocTypes mkind, ...)
   *               If op is CHAIN, then the next 2 arg's are:
   *                     ph : Pointer to the tree header record to return the node
   *                     p  : Pointer to the tree ode to return
-  *               If op is FREE, then the next arg is
-  *                     p : Pointer to the node to free
+  *               If op is FREE, then the next 2 arg's are:
+  *                     ph : Pointer to the tree header record of the node
+  *                     p  : Pointer to the node to free
+  *       A node that lives in a chunk (tn_chunk) is never freed or chained by
+  *       itself; its memory goes back with the chunk. A node from a slab (tn_slab)
+  *       is chained to the free nodes of its size class, however many, and not
+  *       freed by itself; its memory goes back with the slabs.
+  *
+  *  if mkind is T_CHUNK, then deallocate all node chunks of a tree:
+  *       mkind : Is T_CHUNK (or T_TRYCHUNK, the same)
+  *       ph    : Is a pointer to the header record owning the chunks
+  *
+  *  if mkind is T_FRZIDX, then deallocate the key index of a frozen tree, if any:
+  *       mkind : Is T_FRZIDX
+  *       ph    : Is a pointer to the header record owning the index; th_fidx is set to NULL
+  *       The copies of the frozen layout and index on the NUMA nodes go too (see bst_numa).
+  *
+  *  if mkind is T_SLAB, then deallocate the slabs of the size classed nodes of a tree:
+  *       mkind : Is T_SLAB
+  *       ph    : Is a pointer to the header record owning the slabs; th_slab is set to NULL
+  *       Slabs in huge pages are unmapped, the others freed.
+  *
+  *  if mkind is T_MAP, then unmap the tree file of a tree, if any:
+  *       mkind : Is T_MAP
+  *       ph    : Is a pointer to the header record owning the mapping; th_map is set to NULL
+  *       The chunk telling the nodes of the file goes with T_CHUNK.
   *
   *  Output Parameters
   *  =================
@@ -184,14 +466,20 @@ void tfreem(MallocTypes mkind, ...)
     va_list ap;			/* points to each argument in turn */
     t_header *ph;		/* pointer to tree header record */
     t_node *pn;			/* pointer to tree node */
+    t_chunk *pc;		/* pointer to node chunk */
     FreeOpts op;		/* operation to perform on node: FREE it or CHAIN it */
+    t_alloc a;			/* allocator of a header being freed */
 
     va_start(ap, mkind);	/* initialize arg pointer */
 
     switch (mkind) {
     case T_HEADER:		/* free a tree header record */
 	ph = (t_header *) va_arg(ap, t_header *);
-	free(ph);
+	a = ph->th_alloc;
+	if (a.ta_free == NULL)
+	    free(ph);
+	else
+	    a.ta_free(a.ta_ctx, ph);
 #ifdef DEBUG_MALLAC_USAGE
 	printf(">>> FREEING MEMORY FOR T_HEADER AT 0x%-5x <<<\n", ph);
 #endif
@@ -207,10 +495,21 @@ void tfreem(MallocTypes mkind, ...)
 	    /* list defined by MAX_FLIST. If the free list is max'd out, then free the node; */
 	    /* else chain it into the the free list maintained in the header record:         */
 
+	    /* A node living in a chunk is never chained: its memory must not be handed */
+	    /* out again by tallocm, since bst_freeze frees the chunks of a tree:       */
+	    if (pn->tn_chunk)
+		break;
+	    if (pn->tn_slab) {
+		pn->tn_ulink = ph->th_slab->ts_free[pn->tn_slab - 1];
+		ph->th_slab->ts_free[pn->tn_slab - 1] = pn;
+		STAT_ADD(STATS(ph), st_chain, 1);
+		break;
+	    }
 	    if (ph->th_flcnt < MAX_FLIST - 1) {
 		pn->tn_ulink = ph->th_flist;
 		ph->th_flist = pn;
 		ph->th_flcnt++;
+		STAT_ADD(STATS(ph), st_chain, 1);
 #ifdef DEBUG_MALLAC_USAGE
 		printf(">>> CHAINING T_NODE AT LOCATION 0x%-5x TO HEADER <<<\n", pn);
 #endif
@@ -218,18 +517,427 @@ void tfreem(MallocTypes mkind, ...)
 #ifdef DEBUG_MALLAC_USAGE
 		printf(">>> (case T_NODE/CHAIN (th_flist too many) FREEING T_NODE AT LOCATION 0x%-5x <<<\n", pn);
 #endif
-		free(pn);
+		tmfree(ph, pn);
+		STAT_ADD(STATS(ph), st_free, 1);
 	    }
 	    break;
 	case FREE:		/* free it up */
+	    ph = (t_header *) va_arg(ap, t_header *);
 	    pn = (t_node *) va_arg(ap, t_node *);
+	    if (pn->tn_chunk || pn->tn_slab)
+		break;
 #ifdef DEBUG_MALLAC_USAGE
 	    printf(">>> (case T_NODE/FREE) FREEING T_NODE AT LOCATION 0x%-5x <<<\n", pn);
 #endif
-	    free(pn);
+	    tmfree(ph, pn);
 	    break;
 	}
 	break;
+    case T_CHUNK:		/* free every node chunk of a tree */
+    case T_TRYCHUNK:
+	ph = (t_header *) va_arg(ap, t_header *);
+	while ((pc = ph->th_clist) != NULL) {
+	    ph->th_clist = pc->tc_link;
+#ifdef DEBUG_MALLAC_USAGE
+	    printf(">>> FREEING T_CHUNK AT LOCATION 0x%-5x <<<\n", pc);
+#endif
+	    tbulkfree(ph, pc);
+	}
+	break;
+    case T_FRZIDX:		/* free the key index of a frozen tree */
+	ph = (t_header *) va_arg(ap, t_header *);
+	if (ph->th_fidx != NULL) {
+#ifdef DEBUG_MALLAC_USAGE
+	    printf(">>> FREEING T_FRZIDX AT LOCATION 0x%-5x <<<\n", ph->th_fidx->tf_keys);
+#endif
+	    tmfree(ph, ph->th_fidx->tf_base);
+	    ph->th_fidx = NULL;
+	}
+	trepfree(ph);
+	break;
+    case T_SLAB:		/* free the slabs of the size classed nodes of a tree */
+	ph = (t_header *) va_arg(ap, t_header *);
+	if (ph->th_slab == NULL)
+	    break;
+	while ((pc = ph->th_slab->ts_list) != NULL) {
+	    ph->th_slab->ts_list = pc->tc_link;
+#ifdef DEBUG_MALLAC_USAGE
+	    printf(">>> FREEING SLAB AT LOCATION 0x%-5x <<<\n", pc);
+#endif
+	    tbulkfree(ph, pc);
+	}
+	while ((pc = ph->th_slab->ts_huge) != NULL) {
+	    ph->th_slab->ts_huge = pc->tc_link;
+#ifdef DEBUG_MALLAC_USAGE
+	    printf(">>> UNMAPPING HUGE SLAB AT LOCATION 0x%-5x <<<\n", pc);
+#endif
+	    munmap(pc, HUGE_BYTES);
+	}
+	tmfree(ph, ph->th_slab);
+	ph->th_slab = NULL;
+	break;
+    case T_MAP:			/* unmap the tree file of a tree */
+	ph = (t_header *) va_arg(ap, t_header *);
+	if (ph->th_map != NULL) {
+#ifdef DEBUG_MALLAC_USAGE
+	    printf(">>> UNMAPPING T_MAP AT LOCATION 0x%-5x <<<\n", ph->th_map);
+#endif
+	    munmap(ph->th_map, ph->th_mlen);
+	    ph->th_map = NULL;
+	}
+	break;
     }
     va_end(ap);			/* required call before exiting */
 }
+
+/* tcopym: central tree node copier for the library */
+void tcopym(t_header * ph, t_node * to, t_node * from)
+{
+ /*******************************************************************************
+  *  A private library function that copies a whole tree node, header part and
+  *  users data area, from one node to another. The storage bits tn_chunk and
+  *  tn_slab of the destination node are kept since they tell how that node's
+  *  memory is owned. Only the tn_usiz bytes of users data of from are copied;
+  *  to must have room for them.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record for this tree
+  *  to         : Pointer to the node to copy into
+  *  from       : Pointer to the node to copy from
+  *
+  *  Output Parameters
+  *  =================
+  *  to         : Exact copy of from except for tn_chunk and tn_slab
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    unsigned int chunk, slab;
+
+    chunk = to->tn_chunk;
+    slab = to->tn_slab;
+    memcpy(to, from, sizeof(t_node) + from->tn_usiz);
+    to->tn_chunk = chunk;
+    to->tn_slab = slab;
+#ifdef DEBUG_MALLAC_USAGE
+    printf(">>> memcpy FROM LOCATION 0x%-5x TO LOCATION 0x%-5x; %i BYTES <<<\n", from, to, sizeof(t_node) + from->tn_usiz);
+#endif
+}
+
+/* tslabclass: size class of a node of size bytes of users data; -1 if too big for one */
+static int tslabclass(int size)
+{
+    int c, base, step;
+
+    /* 8 byte steps up to 64 bytes, then 4 steps to each power of two: */
+    if (size <= 64)
+	return (size <= 0 ? 0 : (size + 7) / 8 - 1);
+    for (c = 8, base = 64, step = 16; c < SLAB_CLASSES; c += 4, base *= 2, step *= 2)
+	if (size <= 2 * base)
+	    return (c + (size - base + step - 1) / step - 1);
+    return (-1);
+}
+
+/* tslabsize: bytes of users data of the nodes of size class c */
+static int tslabsize(int c)
+{
+    if (c < 8)
+	return ((c + 1) * 8);
+    return ((64 << (c - 8) / 4) + ((c - 8) % 4 + 1) * (16 << (c - 8) / 4));
+}
+
+/* tslabnew: link a new slab of nodes stride bytes apart into the slabs of a tree */
+static t_chunk *tslabnew(t_header * ph, long stride)
+{
+ /*******************************************************************************
+  *  A slab is malloc'd of SLAB_BYTES, or of one node if that is larger, until
+  *  the slabs of the tree come to HUGE_BYTES. From then on, while thuge_on, a
+  *  slab is a huge page of its own, so that a large tree spends a data TLB
+  *  entry per HUGE_BYTES of nodes rather than per page: with BST_HUGETLB one
+  *  of the reserved pages of hugetlbfs (MAP_HUGETLB) if there is one, else an
+  *  aligned HUGE_BYTES of anonymous memory madvise'd for a transparent huge
+  *  page. Where the kernel gives neither, the memory is just mapped in pages,
+  *  and where it can not be mapped at all the slab is malloc'd as before. A
+  *  tree with an allocator of the user gets every slab from ta_bulk_alloc.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record of the tree; th_slab is set.
+  *  stride     : Bytes from one node of the slab to the next.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns pointer to the new slab, on ts_huge or ts_list with
+  *  tc_nnodes set, or NULL if it can not be malloc'd.
+  *
+  *  Global Variables
+  *  =================
+  *  thuge_on   : Slabs may be huge pages.
+  *******************************************************************************/
+
+    t_slabs *ps;
+    t_chunk *pc;
+    char *p, *a;
+    long size;
+
+    ps = ph->th_slab;
+    pc = NULL;
+    if (thuge_on && ph->th_alloc.ta_alloc == NULL && ps->ts_bytes >= HUGE_BYTES
+	&& stride <= HUGE_BYTES - (long) sizeof(t_chunk)) {
+#if defined(BST_HUGETLB) && defined(MAP_HUGETLB)
+	if ((p = mmap(NULL, HUGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0)) != MAP_FAILED)
+	    pc = (t_chunk *) p;
+#endif
+	/* twice the bytes are mapped so that the aligned huge page within them can be kept: */
+	if (pc == NULL
+	    && (p = mmap(NULL, 2 * HUGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) != MAP_FAILED) {
+	    a = (char *) (((unsigned long) p + HUGE_BYTES - 1) & ~(HUGE_BYTES - 1));
+	    if (a > p)
+		munmap(p, a - p);
+	    munmap(a + HUGE_BYTES, p + HUGE_BYTES - a);
+#ifdef MADV_HUGEPAGE
+	    madvise(a, HUGE_BYTES, MADV_HUGEPAGE);
+#endif
+	    pc = (t_chunk *) a;
+	}
+	if (pc != NULL) {
+	    size = HUGE_BYTES;
+	    pc->tc_link = ps->ts_huge;
+	    ps->ts_huge = pc;
+	}
+    }
+    if (pc == NULL) {
+	size = sizeof(t_chunk) + (SLAB_BYTES > stride ? SLAB_BYTES / stride : 1) * stride;
+	if ((pc = (t_chunk *) tbulk(ph, size)) == OUT_OF_MEM)
+	    return (NULL);
+	pc->tc_link = ps->ts_list;
+	ps->ts_list = pc;
+    }
+#ifdef DEBUG_MALLAC_USAGE
+    printf(">>> ALLOCATING MEMORY FOR SLAB AT 0x%-5x; %li BYTES <<<\n", pc, size);
+#endif
+    pc->tc_nnodes = (size - sizeof(t_chunk)) / stride;
+    pc->tc_stride = stride;
+    pc->tc_bytes = size;
+    tnumaplace(ph, pc, size);
+    ps->ts_bytes += size;
+    return (pc);
+}
+
+/* tslabtrim: free the slabs of a tree none of whose nodes is in use */
+long tslabtrim(t_header * ph)
+{
+ /*******************************************************************************
+  *  A private library function that gives back the slabs of a tree in which
+  *  every node is free: on the free list of its size class, or not yet carved
+  *  (ts_left). The nodes of those slabs are taken off the free lists and the
+  *  slabs freed or unmapped; the other slabs are left as they are. Each free
+  *  node is found in its slab by a binary search of the slabs by address.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record for this tree.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns the bytes of slabs given back; 0 as well if the
+  *  table of slabs could not be malloc'd.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    t_slabs *ps;
+    t_chunk *pc, **pp;
+    t_node **pl;
+    struct slabuse *pu;
+    long n, i, bytes;
+    int c;
+
+    if ((ps = ph->th_slab) == NULL)
+	return (0);
+    for (n = 0, pc = ps->ts_list; pc != NULL; pc = pc->tc_link, n++);
+    for (pc = ps->ts_huge; pc != NULL; pc = pc->tc_link, n++);
+    if (n == 0 || (pu = (struct slabuse *) tmalloc(ph, n * sizeof(struct slabuse))) == NULL)
+	return (0);
+    for (i = 0, pc = ps->ts_list; pc != NULL; pc = pc->tc_link, i++) {
+	pu[i].pc = pc;
+	pu[i].huge = FALSE;
+    }
+    for (pc = ps->ts_huge; pc != NULL; pc = pc->tc_link, i++) {
+	pu[i].pc = pc;
+	pu[i].huge = TRUE;
+    }
+    for (i = 0; i < n; i++)
+	pu[i].nfree = 0;
+    qsort(pu, n, sizeof(struct slabuse), tslabcmp);
+
+    /* count the free nodes of each slab, then mark those with no other: */
+    for (c = 0; c <= SLAB_CLASSES; c++) {
+	for (pl = &ps->ts_free[c]; *pl != NULL; pl = &(*pl)->tn_ulink)
+	    pu[tslabof(pu, n, *pl)].nfree++;
+	if (ps->ts_left[c] > 0)
+	    pu[tslabof(pu, n, ps->ts_next[c])].nfree += ps->ts_left[c];
+    }
+    for (bytes = 0, i = 0; i < n; i++)
+	if (pu[i].nfree == pu[i].pc->tc_nnodes) {
+	    pu[i].nfree = -1;
+	    bytes += pu[i].pc->tc_bytes;
+	}
+    if (bytes == 0) {
+	tmfree(ph, pu);
+	return (0);
+    }
+
+    /* take the nodes of the marked slabs off the free lists, then free the slabs: */
+    for (c = 0; c <= SLAB_CLASSES; c++) {
+	for (pl = &ps->ts_free[c]; *pl != NULL;)
+	    if (pu[tslabof(pu, n, *pl)].nfree < 0)
+		*pl = (*pl)->tn_ulink;
+	    else
+		pl = &(*pl)->tn_ulink;
+	if (ps->ts_left[c] > 0 && pu[tslabof(pu, n, ps->ts_next[c])].nfree < 0)
+	    ps->ts_left[c] = 0;
+    }
+    for (i = 0; i < n; i++)
+	if (pu[i].nfree < 0)
+	    pu[i].pc->tc_nnodes = 0;
+    for (pp = &ps->ts_list; (pc = *pp) != NULL;)
+	if (pc->tc_nnodes == 0) {
+	    *pp = pc->tc_link;
+#ifdef DEBUG_MALLAC_USAGE
+	    printf(">>> FREEING SLAB AT LOCATION 0x%-5x <<<\n", pc);
+#endif
+	    tbulkfree(ph, pc);
+	} else
+	    pp = &pc->tc_link;
+    for (pp = &ps->ts_huge; (pc = *pp) != NULL;)
+	if (pc->tc_nnodes == 0) {
+	    *pp = pc->tc_link;
+#ifdef DEBUG_MALLAC_USAGE
+	    printf(">>> UNMAPPING HUGE SLAB AT LOCATION 0x%-5x <<<\n", pc);
+#endif
+	    munmap(pc, HUGE_BYTES);
+	} else
+	    pp = &pc->tc_link;
+    ps->ts_bytes -= bytes;
+    tmfree(ph, pu);
+    return (bytes);
+}
+
+/* tslabcmp: order two slabs by address for qsort */
+static int tslabcmp(const void *a, const void *b)
+{
+    char *x = (char *) ((struct slabuse *) a)->pc, *y = (char *) ((struct slabuse *) b)->pc;
+
+    return (x < y ? -1 : x > y);
+}
+
+/* tslabof: index of the slab in the n slabs at pu, by address, that p is in */
+static long tslabof(struct slabuse *pu, long n, void *p)
+{
+    long lo, hi, mid;
+
+    /* the last slab starting at or before p: */
+    for (lo = 0, hi = n - 1; lo < hi;) {
+	mid = (lo + hi + 1) / 2;
+	if ((char *) pu[mid].pc <= (char *) p)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    return (lo);
+}
+
+/* tslots: nodes the chunks and slabs of a tree have room for */
+long tslots(t_header * ph)
+{
+    t_chunk *pc;
+    long n;
+
+    for (n = 0, pc = ph->th_clist; pc != NULL; pc = pc->tc_link)
+	n += pc->tc_nnodes;
+    if (ph->th_slab != NULL) {
+	for (pc = ph->th_slab->ts_list; pc != NULL; pc = pc->tc_link)
+	    n += pc->tc_nnodes;
+	for (pc = ph->th_slab->ts_huge; pc != NULL; pc = pc->tc_link)
+	    n += pc->tc_nnodes;
+    }
+    return (n);
+}
+
+/* tmalloc: size bytes from the allocator of a tree */
+void *tmalloc(t_header * ph, size_t size)
+{
+ /*******************************************************************************
+  *  A private library function that allocates memory of a tree other than its
+  *  chunks and slabs: a node by itself, or scratch of an operation on the tree.
+  *  It is malloc unless the tree was defined with an allocator of the user
+  *  (see bst_allocator), and is given back with tmfree.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record for this tree.
+  *  size       : Bytes to allocate.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns pointer to the memory, or NULL.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    if (ph->th_alloc.ta_alloc == NULL)
+	return (malloc(size));
+    return (ph->th_alloc.ta_alloc(ph->th_alloc.ta_ctx, size));
+}
+
+/* tmfree: give back memory of tmalloc; NULL is let be */
+void tmfree(t_header * ph, void *p)
+{
+    if (p == NULL)
+	return;
+    if (ph->th_alloc.ta_free == NULL)
+	free(p);
+    else
+	ph->th_alloc.ta_free(ph->th_alloc.ta_ctx, p);
+}
+
+/* tmrealloc: grow or shrink memory of tmalloc of old bytes to size bytes */
+void *tmrealloc(t_header * ph, void *p, size_t old, size_t size)
+{
+    void *q;
+
+    /* the allocator of the user has no realloc: the bytes are copied to new memory */
+    if (ph->th_alloc.ta_alloc == NULL)
+	return (realloc(p, size));
+    if ((q = ph->th_alloc.ta_alloc(ph->th_alloc.ta_ctx, size)) == NULL)
+	return (NULL);
+    if (p != NULL)
+	memcpy(q, p, old < size ? old : size);
+    tmfree(ph, p);
+    return (q);
+}
+
+/* tbulk: size bytes for a chunk or slab from the allocator of a tree; tc_bytes is for the caller to set */
+static void *tbulk(t_header * ph, long size)
+{
+    if (ph->th_alloc.ta_bulk_alloc == NULL)
+	return (tmalloc(ph, size));
+    return (ph->th_alloc.ta_bulk_alloc(ph->th_alloc.ta_ctx, size));
+}
+
+/* tbulkfree: give back a chunk or slab of tbulk, which is tc_bytes long */
+static void tbulkfree(t_header * ph, t_chunk * pc)
+{
+    if (ph->th_alloc.ta_bulk_free != NULL)
+	ph->th_alloc.ta_bulk_free(ph->th_alloc.ta_ctx, pc, pc->tc_bytes);
+    else
+	tmfree(ph, pc);
+}
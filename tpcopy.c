@@ -0,0 +1,233 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+/* work shared by the copy threads */
+typedef struct {
+    t_split *ts;		/* tree split into top nodes and subtrees */
+    t_node **dst;		/* copy of each top node; first slot of each subtree */
+    long *cnt;			/* number of nodes in each subtree */
+    t_header *ph_dup;		/* tree being built */
+    long stride;		/* bytes from one node to the next in the chunk */
+} pc_work;
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+static void pccount(void *arg, long i);
+static void pcclone(void *arg, long i);
+static long pcwalk(t_node * root, t_node * dst, long stride, t_node * up, t_header * ph_dup);
+static t_node *pcnode(t_node * p, t_node * d, t_node * up, t_header * ph_dup);
+
+
+/* tpcopy: copy a large tree by cloning its subtrees in parallel into one chunk of nodes */
+Boolean tpcopy(t_header * ph, char *ntn)
+{
+ /*******************************************************************************
+  *  A private library function that makes an exact copy of a tree, the same copy
+  *  twalk(COPY, PREORDER) makes: same shape, keys, balance factors and tags. All
+  *  nodes of the new tree are allocated at once as a single chunk of th_ncnt nodes
+  *  instead of one tallocm per node.
+  *
+  *  The tree is split by tsplit into its top nodes and the subtrees below them.
+  *  The subtrees are counted in parallel so each gets its own run of slots in the
+  *  chunk, the top nodes are copied here, then the subtrees are cloned in parallel
+  *  and hooked under the copies of their parents. No recursion is used; each
+  *  subtree is walked with its parent links just like twalk does.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to source tree header record.
+  *  ntn        : New Tree Name - name of the new tree (must not be defined).
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The new tree was created.
+  *  FALSE      : Malloc error or copy counts wrong; no new tree is left defined.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; *NOT* reset on entry.
+  *******************************************************************************/
+
+    long i, head, tail, slot;
+    t_node *base;
+    t_header *ph_dup;
+    pc_work work;
+
+    extern t_header *cp_header(t_header *, char *);
+    extern void tdispose(t_header *);
+    extern void *tallocm(MallocTypes mkind, ...);
+    extern t_split *tsplit(t_header * ph, t_node * root, long *head, long *tail);
+    extern void *tmalloc(t_header * ph, size_t size);
+    extern void tmfree(t_header * ph, void *p);
+    extern void tpool(long first, long last, void (*job) (void *, long), void *arg);
+
+    if ((ph_dup = cp_header(ph, ntn)) == NULL)
+	return (FALSE);
+    if (ph->th_root == NULL)
+	return (TRUE);
+
+    work.dst = NULL;
+    work.cnt = NULL;
+    if ((work.ts = tsplit(ph, ph->th_root, &head, &tail)) == NULL
+	|| (work.dst = (t_node **) tmalloc(ph, tail * sizeof(t_node *))) == NULL
+	|| (work.cnt = (long *) tmalloc(ph, tail * sizeof(long))) == NULL) {
+	bst_errno = BST_ERR_MALLOC;
+	tmfree(ph, work.ts);
+	tmfree(ph, work.dst);
+	tdispose(ph_dup);
+	return (FALSE);
+    }
+    work.ph_dup = ph_dup;
+    work.stride = 0;
+
+    /* Count each subtree in parallel: */
+    tpool(head, tail, pccount, &work);
+
+    /* The copy must hold exactly th_ncnt nodes, the top nodes plus every subtree: */
+    for (slot = head, i = head; i < tail; i++)
+	slot += work.cnt[i];
+    if (slot != ph->th_ncnt)
+	bst_errno = BST_ERR_COPY_CNT;
+    if (slot != ph->th_ncnt || (base = (t_node *) tallocm(T_TRYCHUNK, ph_dup, ph->th_ncnt)) == NULL) {
+	tmfree(ph, work.ts);
+	tmfree(ph, work.dst);
+	tmfree(ph, work.cnt);
+	tdispose(ph_dup);
+	return (FALSE);
+    }
+    work.stride = ph_dup->th_clist->tc_stride;
+
+    /* Copy the top nodes; a parent always comes before its sons breadth first: */
+    for (i = 0; i < head; i++)
+	work.dst[i] = pcnode(work.ts[i].ts_node, SLOT(base, i, work.stride),
+			     work.ts[i].ts_up < 0 ? NULL : work.dst[work.ts[i].ts_up], ph_dup);
+
+    /* then each subtree in preorder in the slots following them: */
+    for (slot = head, i = head; i < tail; i++) {
+	work.dst[i] = SLOT(base, slot, work.stride);
+	slot += work.cnt[i];
+    }
+    ph_dup->th_root = base;
+
+    /* Clone the subtrees in parallel, each hooking itself under its parent's copy: */
+    tpool(head, tail, pcclone, &work);
+
+    tmfree(ph, work.ts);
+    tmfree(ph, work.dst);
+    tmfree(ph, work.cnt);
+    return (TRUE);
+}
+
+/* pccount: count the nodes of subtree i */
+static void pccount(void *arg, long i)
+{
+    pc_work *w;
+
+    w = (pc_work *) arg;
+    w->cnt[i] = pcwalk(w->ts[i].ts_node, NULL, 0, NULL, NULL);
+}
+
+/* pcclone: clone subtree i into its slots */
+static void pcclone(void *arg, long i)
+{
+    pc_work *w;
+
+    w = (pc_work *) arg;
+    pcwalk(w->ts[i].ts_node, w->dst[i], w->stride, w->ts[i].ts_up < 0 ? NULL : w->dst[w->ts[i].ts_up], w->ph_dup);
+}
+
+/* pcwalk: walk a subtree in preorder counting its nodes, cloning them if dst is given */
+static long pcwalk(t_node * root, t_node * dst, long stride, t_node * up, t_header * ph_dup)
+{
+ /*******************************************************************************
+  *  A private local function that walks the subtree at root in preorder using the
+  *  parent links, no stack, no recursion. If dst is given each node is cloned
+  *  into the next slot from dst on, so the subtree copy is laid out in preorder.
+  *
+  *  Input Parameters
+  *  =================
+  *  root       : Root of the subtree to walk.
+  *  dst        : First slot for the copy or NULL to only count.
+  *  stride     : Bytes from one slot to the next.
+  *  up         : Copy of root's parent the copy of root hangs under.
+  *  ph_dup     : Header record of the tree being built.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns the number of nodes in the subtree.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    long cnt;
+    t_node *p, *d, *next;
+
+    p = root;
+    d = dst != NULL ? pcnode(p, dst, up, ph_dup) : NULL;
+    for (cnt = 1;; cnt++) {
+	if (p->tn_llink != NULL)
+	    next = p->tn_llink;
+	else if (p->tn_rlink != NULL)
+	    next = p->tn_rlink;
+	else {
+	    /* at a leaf: go back up until a left son with a right brother is left */
+	    for (next = NULL; next == NULL && p != root; p = p->tn_ulink) {
+		if (p->tn_tag == LEFT_SON)
+		    next = p->tn_ulink->tn_rlink;
+		if (d != NULL)
+		    d = d->tn_ulink;
+	    }
+	    if (next == NULL)
+		return (cnt);
+	}
+	p = next;
+	if (d != NULL)
+	    d = pcnode(p, SLOT(dst, cnt, stride), d, ph_dup);
+    }
+}
+
+/* pcnode: clone one node into its slot and hook it under the copy of its parent */
+static t_node *pcnode(t_node * p, t_node * d, t_node * up, t_header * ph_dup)
+{
+    memcpy(d, p, sizeof(t_node) + p->tn_usiz);
+    d->tn_chunk = 1;
+    d->tn_slab = 0;
+    d->tn_id = ph_dup->th_id;
+    d->tn_ulink = up;
+    d->tn_llink = NULL;
+    d->tn_rlink = NULL;
+    if (up != NULL) {
+	if (p->tn_tag == LEFT_SON)
+	    up->tn_llink = d;
+	else
+	    up->tn_rlink = d;
+    }
+    return (d);
+}
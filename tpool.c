@@ -0,0 +1,190 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#include <pthread.h>
+#include <unistd.h>
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+/* jobs shared by the threads of one tpool call */
+typedef struct {
+    pthread_mutex_t lock;	/* guards next */
+    long next, last;		/* next job not yet taken, one past the last job */
+    void (*job) (void *, long);	/* function doing job i */
+    void *arg;			/* first argument to job */
+} pool_work;
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+static void *poolworker(void *arg);
+
+
+/* tncpu: number of cpus to spread work over */
+long tncpu(void)
+{
+    long ncpu;
+
+    if ((ncpu = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+	ncpu = 1;
+    return (ncpu);
+}
+
+/* tsplit: split a tree into its top nodes and the subtrees below them */
+t_split *tsplit(t_header * ph, t_node * root, long *head, long *tail)
+{
+ /*******************************************************************************
+  *  A private library function that takes a tree a level at a time, breadth first,
+  *  until the last level taken holds TASKS_PER_CPU subtrees per cpu, enough to
+  *  keep every cpu busy when the subtrees are handed out by tpool. A parent always
+  *  comes before its sons in the returned array.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record of the tree, whose allocator
+  *               the array comes from.
+  *  root       : Root of the tree to split; must not be NULL.
+  *
+  *  Output Parameters
+  *  =================
+  *  head       : ts[0..head) are the top nodes of the tree.
+  *  tail       : ts[head..tail) are the roots of the subtrees below them.
+  *  Function name returns the array ts of tmalloc or NULL; the caller frees it
+  *  with tmfree.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; *NOT* reset on entry.
+  *******************************************************************************/
+
+    long level, size, target;
+    t_split *ts, *p;
+
+    extern void *tmalloc(t_header * ph, size_t size);
+    extern void tmfree(t_header * ph, void *p);
+    extern void *tmrealloc(t_header * ph, void *p, size_t old, size_t size);
+
+    target = tncpu() * TASKS_PER_CPU;
+    size = 2 * target;
+    if ((ts = (t_split *) tmalloc(ph, size * sizeof(t_split))) == NULL) {
+	bst_errno = BST_ERR_MALLOC;
+	return (NULL);
+    }
+    ts[0].ts_node = root;
+    ts[0].ts_up = -1;
+    *head = 0;
+    *tail = 1;
+    while (*tail > *head && *tail - *head < target) {
+	for (level = *tail; *head < level; (*head)++) {
+	    if (*tail + 2 > size) {
+		size *= 2;
+		if ((p = (t_split *) tmrealloc(ph, ts, size / 2 * sizeof(t_split), size * sizeof(t_split))) == NULL) {
+		    tmfree(ph, ts);
+		    bst_errno = BST_ERR_MALLOC;
+		    return (NULL);
+		}
+		ts = p;
+	    }
+	    if (ts[*head].ts_node->tn_llink != NULL) {
+		ts[*tail].ts_node = ts[*head].ts_node->tn_llink;
+		ts[(*tail)++].ts_up = *head;
+	    }
+	    if (ts[*head].ts_node->tn_rlink != NULL) {
+		ts[*tail].ts_node = ts[*head].ts_node->tn_rlink;
+		ts[(*tail)++].ts_up = *head;
+	    }
+	}
+    }
+    return (ts);
+}
+
+/* tpool: run jobs first..last-1 on one thread per cpu, this one included */
+void tpool(long first, long last, void (*job) (void *, long), void *arg)
+{
+ /*******************************************************************************
+  *  A private library function that hands jobs out one at a time to a pool of
+  *  threads until all are done and returns when the last one has finished. The
+  *  calling thread works too, so if no thread can be created the whole job is
+  *  still done here.
+  *
+  *  Input Parameters
+  *  =================
+  *  first      : First job number.
+  *  last       : One past the last job number.
+  *  job        : Function called as job(arg, i) for each job number i.
+  *  arg        : First argument passed to job.
+  *
+  *  Output Parameters
+  *  =================
+  *  None. Whatever job leaves behind through arg.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    long i, n, nthreads;
+    pthread_t *tids;
+    pool_work w;
+
+    w.next = first;
+    w.last = last;
+    w.job = job;
+    w.arg = arg;
+    pthread_mutex_init(&w.lock, NULL);
+
+    if ((nthreads = tncpu()) > last - first)
+	nthreads = last - first;
+
+    n = 0;
+    tids = NULL;
+    if (nthreads > 1 && (tids = (pthread_t *) malloc((nthreads - 1) * sizeof(pthread_t))) != NULL)
+	for (i = 0; i < nthreads - 1; i++)
+	    if (pthread_create(&tids[n], NULL, poolworker, &w) == 0)
+		n++;
+
+    poolworker(&w);
+
+    for (i = 0; i < n; i++)
+	pthread_join(tids[i], NULL);
+    free(tids);
+    pthread_mutex_destroy(&w.lock);
+}
+
+/* poolworker: take jobs one at a time until there are none left */
+static void *poolworker(void *arg)
+{
+    long i;
+    pool_work *w;
+
+    w = (pool_work *) arg;
+    for (;;) {
+	pthread_mutex_lock(&w->lock);
+	i = w->next < w->last ? w->next++ : -1;
+	pthread_mutex_unlock(&w->lock);
+	if (i < 0)
+	    return (NULL);
+	w->job(w->arg, i);
+    }
+}
@@ -23,12 +23,6 @@
 #include "bst.h"
 #endif
 
-#define DEB_FULL   1
-#define DBG_VERIFY 1
-
-static int ncount;		/* local global to this module only */
-static int maxdepth;		/* local global to this module only */
-
 static char *RCSid[] = { "$Id$" };
 
 extern int bst_errno;
@@ -49,6 +43,9 @@ void bst_stat(char *tname)
   *  header record is set when bst_create was invoked to th_stat the condition 
   *  after *every* call to bst_put and bst_remove.   
   *
+  *  The checking is done by tverify in one pass over the tree, the same check
+  *  bst_verify makes; see verify.c.
+  *
   *  Input Parameters
   *  =================
   *  tname       : Name of the tree to check.
@@ -64,11 +61,12 @@ void bst_stat(char *tname)
   *******************************************************************************/
 
     t_header *ph;
-
-    void checkbalance(t_node * p);
+    t_verify v;
 
     extern t_header *find_header(char *);
-    extern void bst_print(char *);
+    extern void tmaplinks(t_header * ph);
+    extern Boolean tverify(t_header * ph, t_verify * pv);
+    extern char *bst_errmsg(int);
 
     bst_errno = BST_ERR_RESET;
 
@@ -76,6 +74,7 @@ void bst_stat(char *tname)
 	bst_errno = BST_ERR_TREE_NOT_DEFINED;
 	return;
     }
+    tmaplinks(ph);
 
     if (ph->th_bsttype == BST) {
 	printf("checking status of tree: nothing to check, tree is type BST, not AVL: OK\n");
@@ -84,171 +83,52 @@ void bst_stat(char *tname)
     }
     printf("********** VERIFYING **********");
 
-    ncount = 0;
-    checkbalance(ph->th_root);
-
-    if (bst_errno == 0)
+    if (tverify(ph, &v))
 	printf("...........................................OK\n");
-    else
+    else {
+	bst_errno = v.tv_errno;
 	printf("\n\n\007\007...................................*** ERROR %3i! ***\n\n", bst_errno);
-
-    if (ph->th_ncnt != ncount)
-	printf("\007.................. node miscount: ph->th_ncnt %i  run time count %i\n", ph->th_ncnt, ncount);
+	if (bst_errno == BST_ERR_NODE_COUNT)
+	    printf("\007.................. node miscount: ph->th_ncnt %li  run time count %li\n", ph->th_ncnt,
+		   v.tv_ncnt);
+	else
+	    printf("%s! node (%p)\n", bst_errmsg(bst_errno), v.tv_leaf == NULL ? NULL : (t_node *) v.tv_leaf - 1);
+    }
 }				/* bst_stat */
 
-
-/* checkbalance: does the actual work */
-void checkbalance(t_node * p)
+/* tstat: verify a tree after bst_put or bst_remove as asked for when it was created */
+void tstat(t_header * ph, t_node * start)
 {
  /*******************************************************************************
-  *  A user acccessible function that creates a new AVL or BST search tree.
-  *  Creates a new tree header node, initializes it and adds it to the global
-  *  link list pointed to by t_head.
+  *  A private library function called by bst_put and bst_remove when th_stat is
+  *  set. TREE_VERIFY_YES checks the whole tree with bst_stat; TREE_VERIFY_PATH
+  *  only the path that changed with tverifypath, printing nothing unless it
+  *  finds something wrong.
   *
   *  Input Parameters
   *  =================
-  *  tname      : Name of the new tree to define.
-  *  ttype      : Type of bst to use: AVL or BST.
-  *  leafsize   : sizeof(Leaf) of the _user's_ data record.
-  *  fixedrec   : TRUE if users Leaf data record contains no pointers.
-  *               FALSE if users Leaf data record contains pointers.
-  *               (2018 rpj: unknown what the idea of this was)
-  *  compf      : Pointer to the user written compare function needed to
-  *               compare any two keys for this particular tree.
-  *  prntf      : Pointer to user written print function that will print
-  *               the users key (and any other info)  for that node.
-  *               No big deal if user passed NULL to it.
-  *  th_stat    : After each bst_put() or bst_remove() should we check (i.e.
-  *               verify) the tree balanced state? Meaninful for only AVL trees.
+  *  ph         : Pointer to the header record of the tree.
+  *  start      : Node inserted, or parent of the node removed (NULL for the root).
   *
   *  Output Parameters
   *  =================
-  *  Function name returns Boolean result:
-  *  TRUE       : A new tree was created.
-  *  FALSE      : Tree is already defined or malloc error.
+  *  None.
   *
   *  Global Variables
   *  =================
-  *  t_head     : A linked list of defined AVL trees.
-  *  bst_errno  : Global error variable; reset on entry.
+  *  bst_errno  : Global error variable; set if a violation is found.
   *******************************************************************************/
 
-    int depth(t_node *);
-
-    /* checkbalance  -- compute ACTUAL balance factors of the tree. At each   */
-    /* node in the tree decend in it's left an right subtree */
-    /* and find the actual height of each subtree.           */
-    int bf;
+    t_verify v;
 
-    if ((p == NULL) || (bst_errno == BST_ERR_OUT_OF_BALANCE))
-	return;
+    extern Boolean tverifypath(t_header * ph, t_node * start, t_verify * pv);
+    extern char *bst_errmsg(int);
 
-    ncount++;
-    if (p->tn_llink != NULL) {
-	if (p->tn_llink->tn_tag != LEFT_SON) {
-	    printf("p->left->tn_tag is incorrect! node (0x%-5x)\n", p->tn_llink);
-	    bst_errno = BST_ERR_TAG;
-	}
-	if (p->tn_llink->tn_ulink != p) {
-	    printf("p->left->tn_ulink is astray! node (0x%-5x)\n", p->tn_llink);
-	    bst_errno = BST_ERR_TAG;
-	}
-    }
-    checkbalance(p->tn_llink);
-
-    bf = depth(p->tn_llink) - depth(p->tn_rlink);
-
-    if (p->tn_bf != bf) {
-	printf("tree is out of balance! node (0x%-5x)\n", p);
-	bst_errno = BST_ERR_OUT_OF_BALANCE;
-	return;
-    }
-    if (p->tn_rlink != NULL) {
-	if (p->tn_rlink->tn_tag != RIGHT_SON) {
-	    printf("p->right->tn_tag is incorrect! node (0x%-5x)\n", p->tn_rlink);
-	    bst_errno = BST_ERR_TAG;
-	}
-	if (p->tn_rlink->tn_ulink != p) {
-	    printf("p->right->tn_ulink is astray! node (0x%-5x)\n", p->tn_rlink);
-	    bst_errno = BST_ERR_TAG;
-	}
+    if (ph->th_stat == TREE_VERIFY_YES)
+	bst_stat(ph->th_name);
+    else if (ph->th_stat == TREE_VERIFY_PATH && !tverifypath(ph, start, &v)) {
+	bst_errno = v.tv_errno;
+	printf("\n\n\007\007...................................*** ERROR %3i! ***\n\n", bst_errno);
+	printf("%s! node (%p)\n", bst_errmsg(bst_errno), v.tv_leaf == NULL ? NULL : (t_node *) v.tv_leaf - 1);
     }
-    checkbalance(p->tn_rlink);
-
-}				/* checkbalance */
-
-
-/* depth: compute the depth or height current tree where we are currently at. */
-int depth(t_node * p1)
-{
- /*******************************************************************************
-  *  A private local function that compute the depth or height current tree now.
-  *  Now we're in either the node above left or right subtree. Find actual
-  *  depth with searchall.
-  *
-  *  From our current position in the tree, we call searchall() 
-  *
-  *  Input Parameters
-  *  =================
-  *  p1         : Current tree node we are at in the tree.
-  *
-  *  Output Parameters
-  *  =================
-  *  Function name returns int result: the longest path encountered
-  *
-  *  Global Variables
-  *  =================
-  *  maxdepth   :  maxdepth was the longest path encountered
-  *******************************************************************************/
-
-    int d;
-
-    void searchall(t_node *, int *);
-
-    /* initialize */
-
-    d = 0;
-    maxdepth = d;		/* maxdepth is global */
-
-    searchall(p1, &d);		/* search all possible paths to the leafs */
-
-    return maxdepth;		/* maxdepth was the longest path encountered */
-}				/* depth */
-
-/* searchall():  take all possible paths in this tree to the leaves and keep track of the maximum height encountered in this tree */
-void searchall(t_node * p2, int *d1)
-{
- /*******************************************************************************
-  *  A private local function that take all possible paths in this tree to the leaves and
-  *  keep track of the maximum height encountered in this tree.
-  *
-  *  Input Parameters
-  *  =================
-  *  p2         : Current tree node we are at.
-  *  d1         : current depth of tree.
-  *
-  *  Output Parameters
-  *  =================
-  *  d1         : depth of tree encountered in this call
-  *
-  *  Global Variables
-  *  =================
-  *  maxdepth   : Current max depth encountered in tree from the node being visited
-  *******************************************************************************/
-
-    /* searchall -- take all possible paths in this tree to the leaves and    */
-    /* keep track of the maximum height encountered in this tree */
-
-    if (p2 == NULL)		/* end of the trail for this path. */
-	return;
-
-    (*d1)++;			/* increment depth var one more level that we're at    */
-
-    if (*d1 > maxdepth)		/* retain the depth level if this is the longest path  */
-	maxdepth = *d1;		/* encountered thus far.                            */
-
-    searchall(p2->tn_llink, d1);	/* take the left branch... */
-    searchall(p2->tn_rlink, d1);	/* now take the right branch... */
-
-    (*d1)--;			/* decrease the level we're on as popping back upwards */
-}				/* searchall */
+}				/* tstat */
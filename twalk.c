@@ -57,7 +57,7 @@ Boolean twalk(TWalkOps op, Traversals order, ...)
   *          twalk(VISIT, PREORDER,  ph->th_root, Print_Node);
   *          twalk(VISIT, POSTORDER, ph->th_root, Print_Node)
   *
-  *          twalk(DELETE, POSTORDER, ph->th_root);
+  *          twalk(DELETE, POSTORDER, ph->th_root, ph);
   *          twalk(COPY, COPYORDER, ph, ntn);
   *          twalk(IDENT, PREORDER, ph1, ph2);
   *          twalk(EQUAL, PREORDER, ph1, ph2);
@@ -140,6 +140,10 @@ Boolean twalk(TWalkOps op, Traversals order, ...)
 	/* root tree node */
 	p = (t_node *) va_arg(ap, t_node *);
 
+	/* the header of the tree, whose allocator takes the nodes back: */
+	if (op == DELETE)
+	    ph = (t_header *) va_arg(ap, t_header *);
+
 	if (op == VISIT) {
 	    /* printf("op = VISIT\n\n"); */
 	    /* next arg is the user definded function to do something with this leaf node */
@@ -276,7 +280,7 @@ Boolean twalk(TWalkOps op, Traversals order, ...)
 			    pp_dup = pp_dup->tn_ulink;
 
 			if (op == DELETE && dp != NULL) {
-			    tfreem(T_NODE, FREE, dp);
+			    tfreem(T_NODE, FREE, ph, dp);
 			    dp = NULL;
 			}
 		    }
@@ -296,6 +300,7 @@ Boolean twalk(TWalkOps op, Traversals order, ...)
 	return (TRUE);
     }
     /* printf("twalk EXIT: @ end of function\n"); */
+    return (TRUE);
 }
 
 /* setflags: initialize the traversal structure */
@@ -372,14 +377,39 @@ t_header *cp_header(t_header * ph, char *ntn)
 
     ph_dup->th_root = NULL;
     ph_dup->th_flist = NULL;
+    ph_dup->th_clist = NULL;
+    ph_dup->th_slab = NULL;
+    ph_dup->th_frz = NULL;
+    ph_dup->th_fidx = NULL;
+    ph_dup->th_map = NULL;
+    ph_dup->th_wal = NULL;
+    ph_dup->th_cmp = NULL;
+    ph_dup->th_gen = 0;
+    ph_dup->th_frag = ph->th_frag;
+    ph_dup->th_rep = NULL;
+    ph_dup->th_numa = ph->th_numa;
+    ph_dup->th_rmcnt = 0;
+    ph_dup->th_mlen = 0;
     ph_dup->th_id = tid();
     ph_dup->th_ncnt = ph->th_ncnt;
     ph_dup->th_usiz = ph->th_usiz;
     ph_dup->th_ucf = ph->th_ucf;
+    ph_dup->th_key = ph->th_key;
+    ph_dup->th_pfxf = ph->th_pfxf;
+    ph_dup->th_kcf = ph->th_kcf;
+    ph_dup->th_aggf = ph->th_aggf;	/* the leaves are copied with their aggregates */
+    ph_dup->th_aoff = ph->th_aoff;
+    ph_dup->th_asiz = ph->th_asiz;
+    ph_dup->th_pfx = ph->th_pfx;	/* the nodes are copied with their prefixes */
     ph_dup->th_upf = ph->th_upf;
     ph_dup->th_flcnt = 0;
     ph_dup->th_np = ph->th_np;
     ph_dup->th_stat = ph->th_stat;
+    ph_dup->th_frozen = FALSE;	/* a copy of a frozen tree can be changed */
+    ph_dup->th_var = ph->th_var;
+    ph_dup->th_multi = ph->th_multi;	/* and with their subtree counts */
+    ph_dup->th_moff = ph->th_moff;
+    ph_dup->th_mrel = FALSE;
     strcpy(ph_dup->th_version_id, ph->th_version_id);
     ph_dup->th_reserved1 = ph->th_reserved1;
     ph_dup->th_reserved2 = ph->th_reserved2;
@@ -422,6 +452,7 @@ operation_status action(TWalkOps op, void (*compf) (), int depth, t_node * p, t_
     Boolean qfind(t_header *, t_node *);
     extern void *tallocm(MallocTypes mkind, ...);
     extern void tfreem(MallocTypes mkind, ...);
+    extern void tcopym(t_header * ph, t_node * to, t_node * from);
 
     /* VISIT can occur at any node in the tree
      * DELETE will execute ONLY on a postorder traversal
@@ -460,13 +491,9 @@ operation_status action(TWalkOps op, void (*compf) (), int depth, t_node * p, t_
 	break;
     case COPY:
 	(*count)++;
-	if ((p_dup = (t_node *) tallocm(T_NODE, ph_dup)) == NULL)
+	if ((p_dup = (t_node *) tallocm(T_NODE, ph_dup, p->tn_usiz)) == NULL)
 	    return (ERROR);
-	memcpy(p_dup, p, sizeof(t_node) + ph_dup->th_usiz);
-#ifdef DEBUG_MALLAC_USAGE
-	printf(">>> memcpy FROM LOCATION 0x%-5x TO LOCATION 0x%-5x; %i BYTES <<<\n", p, p_dup,
-	       sizeof(t_header) + ph_dup->th_usiz);
-#endif
+	tcopym(ph_dup, p_dup, p);
 	p_dup->tn_id = ph_dup->th_id;
 	if (*pp_dup != NULL)
 	    switch (p_dup->tn_tag) {
@@ -489,7 +516,7 @@ operation_status action(TWalkOps op, void (*compf) (), int depth, t_node * p, t_
 	    return (OK);
 	break;
     case IDENT:
-	if (ph_dup->th_ucf(p + 1, p_dup + 1) == 0)
+	if (TCMP(ph_dup, p + 1, p_dup + 1) == 0)
 	    return (OK);
 	else
 	    return (NOT_IDENT);
@@ -0,0 +1,587 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+#define  HEIGHTS_INIT  64	/* levels of subtree heights kept before growing */
+#define  PATH_INIT     64	/* nodes of a changed path kept without tmalloc */
+
+/* result of verifying a subtree */
+typedef struct {
+    int error;			/* BST_ERR_* of the first violation; 0 if none */
+    t_node *bad;		/* node with the violation */
+    t_node *min, *max;		/* first and last node inorder */
+    long cnt;			/* number of nodes in the subtree */
+    int height;			/* height of the subtree */
+} v_result;
+
+/* work shared by the verify threads */
+typedef struct {
+    t_header *ph;		/* tree being verified */
+    t_split *ts;		/* tree split into top nodes and subtrees */
+    v_result *r;		/* result for each entry of ts */
+} v_work;
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+static void vjob(void *arg, long i);
+static void vwalk(t_header * ph, t_node * root, v_result * r);
+static Boolean vlinks(t_node * p, v_result * r);
+static Boolean vbalance(t_header * ph, t_node * p, int lh, int rh, v_result * r);
+static Boolean verror(v_result * r, int error, t_node * p);
+static Boolean vsons(t_header * ph, t_node * p, t_node * lo, t_node * hi, v_result * r);
+static int vbeside(t_header * ph, t_node * s, v_result * r);
+static Boolean vbound(t_header * ph, t_node * p, t_node * lo, t_node * hi, v_result * r);
+static int vheight(t_node * p);
+
+
+/* bst_verify: verify the structure of a tree returning the first violation found */
+Boolean bst_verify(char *tname, t_verify * pv)
+{
+ /*******************************************************************************
+  *  A user acccessible function that verifies a tree in one pass: parent links,
+  *  tags, key order, node count, the subtree counts of a multimap, the
+  *  aggregates of bst_aggregate and, for AVL trees, every balance factor
+  *  against the real heights of its subtrees. Nothing is printed; what is
+  *  wrong, if any, is handed back in *pv. Trees of PVERIFY_MIN_NODES nodes or
+  *  more are verified on one thread per cpu, so the user compare and aggregate
+  *  functions must be safe to call from several threads at once.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree to verify.
+  *
+  *  Output Parameters
+  *  =================
+  *  pv         : If not NULL, gets the kind of violation (a bst_errno number),
+  *               the users data area of the bad node, the node count and the
+  *               height of the tree.
+  *  Function name returns Boolean result:
+  *  TRUE       : Tree is sound.
+  *  FALSE      : Tree not defined or a violation was found.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry, set to the violation.
+  *******************************************************************************/
+
+    t_header *ph;
+    t_verify v;
+
+    extern t_header *find_header(char *);
+    extern void tmaplinks(t_header * ph);
+    Boolean tverify(t_header * ph, t_verify * pv);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    tmaplinks(ph);
+
+    if (pv == NULL)
+	pv = &v;
+    if (tverify(ph, pv))
+	return (TRUE);
+
+    bst_errno = pv->tv_errno;
+    return (FALSE);
+}
+
+/* tverify: verify a tree, serially or over its subtrees in parallel */
+Boolean tverify(t_header * ph, t_verify * pv)
+{
+ /*******************************************************************************
+  *  A private library function that does the work of bst_verify and bst_stat.
+  *  Small trees are walked once in postorder by vwalk, heights coming back up
+  *  from the leaves, O(n). Large trees are split by tsplit, the subtrees walked
+  *  by vwalk on tpool threads, and the top nodes then checked here bottom up
+  *  from the results of their sons.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record of the tree.
+  *
+  *  Output Parameters
+  *  =================
+  *  pv         : Result of the verification.
+  *  Function name returns Boolean result:
+  *  TRUE       : Tree is sound.
+  *  FALSE      : Violation found; pv->tv_errno says which.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; *NOT* reset on entry.
+  *******************************************************************************/
+
+    long i, j, head, tail, *son;
+    int lh, rh;
+    t_node *p;
+    v_result res, *r, *rl, *rr;
+    v_work work;
+
+    extern t_split *tsplit(t_header * ph, t_node * root, long *head, long *tail);
+    extern void *tmalloc(t_header * ph, size_t size);
+    extern void tmfree(t_header * ph, void *p);
+    extern void tpool(long first, long last, void (*job) (void *, long), void *arg);
+
+    res.error = 0;
+    res.bad = NULL;
+    res.cnt = 0;
+    res.height = 0;
+    work.ts = NULL;
+    work.r = NULL;
+    son = NULL;
+
+    if ((p = ph->th_root) == NULL)
+	;
+    else if (p->tn_ulink != NULL)
+	verror(&res, BST_ERR_ULINK, p);
+    else if (p->tn_tag != ROOT)
+	verror(&res, BST_ERR_TAG, p);
+    else if (ph->th_ncnt < PVERIFY_MIN_NODES
+	     || (work.ts = tsplit(ph, p, &head, &tail)) == NULL
+	     || (work.r = (v_result *) tmalloc(ph, tail * sizeof(v_result))) == NULL
+	     || (son = (long *) tmalloc(ph, 2 * tail * sizeof(long))) == NULL)
+	vwalk(ph, p, &res);
+    else {
+	/* walk the subtrees in parallel: */
+	work.ph = ph;
+	tpool(head, tail, vjob, &work);
+
+	/* son[2i] and son[2i+1] are the entries of the left and right sons of top node i: */
+	for (i = 0; i < head; i++)
+	    son[2 * i] = son[2 * i + 1] = -1;
+	for (j = 1; j < tail; j++) {
+	    i = work.ts[j].ts_up;
+	    son[2 * i + (work.ts[j].ts_node == work.ts[i].ts_node->tn_llink ? 0 : 1)] = j;
+	}
+
+	/* then check the top nodes bottom up; sons always come after their parent: */
+	for (i = head - 1; i >= 0; i--) {
+	    r = &work.r[i];
+	    p = work.ts[i].ts_node;
+	    rl = son[2 * i] < 0 ? NULL : &work.r[son[2 * i]];
+	    rr = son[2 * i + 1] < 0 ? NULL : &work.r[son[2 * i + 1]];
+	    lh = rl == NULL ? 0 : rl->height;
+	    rh = rr == NULL ? 0 : rr->height;
+	    r->error = 0;
+	    r->cnt = 1 + (rl == NULL ? 0 : rl->cnt) + (rr == NULL ? 0 : rr->cnt);
+	    r->height = 1 + (lh > rh ? lh : rh);
+	    r->min = rl == NULL ? p : rl->min;
+	    r->max = rr == NULL ? p : rr->max;
+
+	    if (rl != NULL && rl->error)
+		verror(r, rl->error, rl->bad);
+	    else if (rr != NULL && rr->error)
+		verror(r, rr->error, rr->bad);
+	    else if (!vlinks(p, r))
+		;
+	    else if (rl != NULL && !TINORDER(ph, rl->max + 1, p + 1))
+		verror(r, BST_ERR_KEY_ORDER, p);
+	    else if (rr != NULL && !TINORDER(ph, p + 1, rr->min + 1))
+		verror(r, BST_ERR_KEY_ORDER, rr->min);
+	    else if (ph->th_pfx && (TNPFX(p) != TPFX(ph, p + 1) || (rl != NULL && TNPFX(rl->max) > TNPFX(p))
+				    || (rr != NULL && TNPFX(p) > TNPFX(rr->min))))
+		verror(r, BST_ERR_KEY_PREFIX, p);
+	    else
+		vbalance(ph, p, lh, rh, r);
+	}
+	res = work.r[0];
+    }
+    tmfree(ph, work.ts);
+    tmfree(ph, work.r);
+    tmfree(ph, son);
+
+    if (res.error == 0 && res.cnt != ph->th_ncnt)
+	verror(&res, BST_ERR_NODE_COUNT, NULL);
+    else if (res.error == 0 && ph->th_multi && NSUB(ph, ph->th_root) != ph->th_ncnt)
+	verror(&res, BST_ERR_SUBTREE_COUNT, ph->th_root);
+
+    pv->tv_errno = res.error;
+    pv->tv_leaf = res.bad == NULL ? NULL : (void *) (res.bad + 1);
+    pv->tv_ncnt = res.cnt;
+    pv->tv_height = res.height;
+    return (res.error == 0 ? TRUE : FALSE);
+}
+
+/* tverifypath: verify only what an insert or remove could have changed */
+Boolean tverifypath(t_header * ph, t_node * start, t_verify * pv)
+{
+ /*******************************************************************************
+  *  A private library function for trees created with TREE_VERIFY_PATH. After
+  *  bst_put or bst_remove only the path from the root down to the node inserted,
+  *  or to the parent of the node removed, has changed: rbal, balancel and
+  *  balancer only rotate nodes on that path and their sons, and move subtrees
+  *  hanging from those sons as a whole.
+  *
+  *  The path is taken once up the parent links from start into path[], then
+  *  gone down from the root by searching for the key of start, which must lead
+  *  along it; in a multimap, where a key equals that of start, path[] tells the
+  *  side. At each node on the way its sons and grandsons are checked for tags,
+  *  parent links and key order against the two nearest nodes on the path they
+  *  must lie between. Then path[] is gone back up from start, the height of
+  *  each node coming from that of its son below, and the balance factors of
+  *  the node and of its son beside the path are checked. Only the subtrees
+  *  hanging beside the path, trusted to be right, are measured, once each, going
+  *  down their taller side as the balance factors say; their heights are kept
+  *  nowhere else. This takes O(log n) compares per mutation; the node count is
+  *  not checked.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record of the tree.
+  *  start      : Node at the bottom of the changed path; NULL for the root.
+  *
+  *  Output Parameters
+  *  =================
+  *  pv         : Result of the verification; tv_ncnt is th_ncnt and tv_height
+  *               the height measured along the path.
+  *  Function name returns Boolean result:
+  *  TRUE       : Path is sound.
+  *  FALSE      : Violation found; pv->tv_errno says which.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; *NOT* reset on entry.
+  *******************************************************************************/
+
+    int cmp, lh, rh, height;
+    long d, depth;
+    t_node *p, *lo, *hi, *s, *stack[PATH_INIT], **path;
+    v_result res;
+
+    extern void *tmalloc(t_header * ph, size_t size);
+    extern void tmfree(t_header * ph, void *p);
+
+    res.error = 0;
+    res.bad = NULL;
+    height = 0;
+    path = stack;
+
+    if ((p = ph->th_root) == NULL)
+	;
+    else if (p->tn_ulink != NULL)
+	verror(&res, BST_ERR_ULINK, p);
+    else if (p->tn_tag != ROOT)
+	verror(&res, BST_ERR_TAG, p);
+    else {
+	if (start == NULL)
+	    start = p;
+
+	/* up from start to the root, no further than th_ncnt in case the links loop: */
+	for (depth = 0, s = start; s->tn_ulink != NULL && depth < ph->th_ncnt; s = s->tn_ulink)
+	    depth++;
+	if (s != p)
+	    verror(&res, BST_ERR_ULINK, s);
+	else if (depth >= PATH_INIT && (path = (t_node **) tmalloc(ph, (depth + 1) * sizeof(t_node *))) == NULL)
+	    verror(&res, BST_ERR_MALLOC, NULL);
+	else {
+	    for (d = depth, s = start; d >= 0; d--, s = s->tn_ulink)
+		path[d] = s;
+
+	    /* down, the key of start leading from each node on the path to the next: */
+	    lo = hi = NULL;
+	    for (d = 0; vsons(ph, p = path[d], lo, hi, &res) && d < depth; d++) {
+		if ((cmp = TCMP(ph, start + 1, p + 1)) == 0 && ph->th_multi)
+		    cmp = path[d + 1] == p->tn_llink ? -1 : 1;
+		if (cmp < 0) {
+		    hi = p;
+		    s = p->tn_llink;
+		} else if (cmp > 0) {
+		    lo = p;
+		    s = p->tn_rlink;
+		} else
+		    s = NULL;
+		if (s != path[d + 1]) {
+		    verror(&res, BST_ERR_KEY_ORDER, start);
+		    break;
+		}
+	    }
+
+	    /* and back up, each node with the height of its son on the path known: */
+	    for (d = depth; res.error == 0 && d >= 0; d--) {
+		p = path[d];
+		s = d == depth ? NULL : path[d + 1];
+		lh = p->tn_llink == NULL ? 0 : p->tn_llink == s ? height : vbeside(ph, p->tn_llink, &res);
+		rh = p->tn_rlink == NULL ? 0 : p->tn_rlink == s ? height : vbeside(ph, p->tn_rlink, &res);
+		if (res.error == 0 && vbalance(ph, p, lh, rh, &res))
+		    height = 1 + (lh > rh ? lh : rh);
+	    }
+	    if (path != stack)
+		tmfree(ph, path);
+	}
+    }
+
+    pv->tv_errno = res.error;
+    pv->tv_leaf = res.bad == NULL ? NULL : (void *) (res.bad + 1);
+    pv->tv_ncnt = ph->th_ncnt;
+    pv->tv_height = res.error == 0 ? height : vheight(ph->th_root);
+    return (res.error == 0 ? TRUE : FALSE);
+}
+
+/* vjob: verify subtree i */
+static void vjob(void *arg, long i)
+{
+    v_work *w;
+
+    w = (v_work *) arg;
+    vwalk(w->ph, w->ts[i].ts_node, &w->r[i]);
+}
+
+/* vwalk: verify a subtree in one postorder pass, heights coming back up from the leaves */
+static void vwalk(t_header * ph, t_node * root, v_result * r)
+{
+ /*******************************************************************************
+  *  A private local function that walks the subtree at root with the parent
+  *  links, no recursion. Going down, the tags and parent links of each node's
+  *  sons are checked; inorder, each key against the one before it; on the way
+  *  back up the heights of both subtrees of a node are known and its balance
+  *  factor is checked against them. h[2d] and h[2d+1] hold the heights of the
+  *  left and right subtrees of the node at depth d on the current path.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record of the tree.
+  *  root       : Root of the subtree to verify.
+  *
+  *  Output Parameters
+  *  =================
+  *  r          : Result for the subtree; r->error stops at the first violation.
+  *
+  *  Global Variables
+  *  =================
+  *  None.
+  *******************************************************************************/
+
+    int *h, *ph2, height;
+    long d, size;
+    t_node *p, *prev;
+
+    extern void *tmalloc(t_header * ph, size_t size);
+    extern void tmfree(t_header * ph, void *p);
+    extern void *tmrealloc(t_header * ph, void *p, size_t old, size_t size);
+
+    r->error = 0;
+    r->bad = NULL;
+    r->min = root;
+    r->max = root;
+    r->cnt = 0;
+    r->height = 0;
+
+    size = HEIGHTS_INIT;
+    if ((h = (int *) tmalloc(ph, 2 * size * sizeof(int))) == NULL) {
+	verror(r, BST_ERR_MALLOC, NULL);
+	return;
+    }
+
+    p = root;
+    prev = NULL;
+    d = 0;
+    h[0] = h[1] = 0;
+    if (!vlinks(p, r))
+	goto done;
+
+    for (;;) {
+	/* go down the left branch as far as it goes: */
+	while (p->tn_llink != NULL) {
+	    p = p->tn_llink;
+	    if (++d == size) {
+		size *= 2;
+		if ((ph2 = (int *) tmrealloc(ph, h, size * sizeof(int), 2 * size * sizeof(int))) == NULL) {
+		    verror(r, BST_ERR_MALLOC, NULL);
+		    goto done;
+		}
+		h = ph2;
+	    }
+	    h[2 * d] = h[2 * d + 1] = 0;
+	    if (!vlinks(p, r))
+		goto done;
+	}
+
+	for (;;) {
+	    /* inorder: check the key against the one before it */
+	    if (prev != NULL && !TINORDER(ph, prev + 1, p + 1)) {
+		verror(r, BST_ERR_KEY_ORDER, p);
+		goto done;
+	    }
+	    if (prev == NULL)
+		r->min = p;	/* first inorder, for the checks of the top nodes in tverify */
+
+	    /* and its prefix against the key and the prefix before it */
+	    if (ph->th_pfx && (TNPFX(p) != TPFX(ph, p + 1) || (prev != NULL && TNPFX(prev) > TNPFX(p)))) {
+		verror(r, BST_ERR_KEY_PREFIX, p);
+		goto done;
+	    }
+	    prev = p;
+	    r->cnt++;
+
+	    /* then take the right branch if there is one ... */
+	    if (p->tn_rlink != NULL) {
+		p = p->tn_rlink;
+		if (++d == size) {
+		    size *= 2;
+		    if ((ph2 = (int *) tmrealloc(ph, h, size * sizeof(int), 2 * size * sizeof(int))) == NULL) {
+			verror(r, BST_ERR_MALLOC, NULL);
+			goto done;
+		    }
+		    h = ph2;
+		}
+		h[2 * d] = h[2 * d + 1] = 0;
+		if (!vlinks(p, r))
+		    goto done;
+		break;
+	    }
+
+	    /* ... else go back up, finishing each node with both heights known, */
+	    /* until coming up from a left son whose parent is then visited     */
+	    for (;;) {
+		height = 1 + (h[2 * d] > h[2 * d + 1] ? h[2 * d] : h[2 * d + 1]);
+		if (!vbalance(ph, p, h[2 * d], h[2 * d + 1], r))
+		    goto done;
+		if (p == root) {
+		    r->height = height;
+		    goto done;
+		}
+		d--;
+		if (p->tn_tag == LEFT_SON) {
+		    h[2 * d] = height;
+		    p = p->tn_ulink;
+		    break;
+		}
+		h[2 * d + 1] = height;
+		p = p->tn_ulink;
+	    }
+	}
+    }
+
+  done:
+    r->max = prev == NULL ? root : prev;
+    tmfree(ph, h);
+}
+
+/* vlinks: check the tags and parent links of the sons of p */
+static Boolean vlinks(t_node * p, v_result * r)
+{
+    if (p->tn_llink != NULL) {
+	if (p->tn_llink->tn_tag != LEFT_SON)
+	    return (verror(r, BST_ERR_TAG, p->tn_llink));
+	if (p->tn_llink->tn_ulink != p)
+	    return (verror(r, BST_ERR_ULINK, p->tn_llink));
+    }
+    if (p->tn_rlink != NULL) {
+	if (p->tn_rlink->tn_tag != RIGHT_SON)
+	    return (verror(r, BST_ERR_TAG, p->tn_rlink));
+	if (p->tn_rlink->tn_ulink != p)
+	    return (verror(r, BST_ERR_ULINK, p->tn_rlink));
+    }
+    return (TRUE);
+}
+
+/* vbalance: check the balance factor of p against the heights of its subtrees, in a */
+/* multimap its subtree count against those of its sons, and its aggregate if any    */
+static Boolean vbalance(t_header * ph, t_node * p, int lh, int rh, v_result * r)
+{
+    double a[AGG_MAX / sizeof(double)];
+
+    if (ph->th_multi && TNSUB(ph, p) != NSUB(ph, p->tn_llink) + NSUB(ph, p->tn_rlink) + 1)
+	return (verror(r, BST_ERR_SUBTREE_COUNT, p));
+    if (ph->th_aggf != NULL) {
+	/* made again over a copy, so bytes th_aggf does not set, e.g. padding, compare equal */
+	memcpy(a, TAGG(ph, p), ph->th_asiz);
+	ph->th_aggf(a, TAGG(ph, p->tn_llink), p + 1, TAGG(ph, p->tn_rlink));
+	if (memcmp(a, TAGG(ph, p), ph->th_asiz) != 0)
+	    return (verror(r, BST_ERR_AGGREGATE, p));
+    }
+    if (ph->th_bsttype != AVL)
+	return (TRUE);
+    if (p->tn_bf != lh - rh || lh - rh < -1 || lh - rh > 1)
+	return (verror(r, BST_ERR_OUT_OF_BALANCE, p));
+    return (TRUE);
+}
+
+/* verror: note a violation in the result; always returns FALSE */
+static Boolean verror(v_result * r, int error, t_node * p)
+{
+    r->error = error;
+    r->bad = p;
+    return (FALSE);
+}
+
+/* vsons: check the links of a node on the changed path, its sons and grandsons lying between lo and hi */
+static Boolean vsons(t_header * ph, t_node * p, t_node * lo, t_node * hi, v_result * r)
+{
+    int i;
+    t_node *s, *slo, *shi;
+
+    if (!vlinks(p, r))
+	return (FALSE);
+    for (i = 0; i < 2; i++) {
+	s = i == 0 ? p->tn_llink : p->tn_rlink;
+	slo = i == 0 ? lo : p;
+	shi = i == 0 ? p : hi;
+	if (s == NULL)
+	    continue;
+	if (!vlinks(s, r) || !vbound(ph, s, slo, shi, r))
+	    return (FALSE);
+	if (s->tn_llink != NULL && !vbound(ph, s->tn_llink, slo, s, r))
+	    return (FALSE);
+	if (s->tn_rlink != NULL && !vbound(ph, s->tn_rlink, s, shi, r))
+	    return (FALSE);
+    }
+    return (TRUE);
+}
+
+/* vbeside: height of a son beside the changed path, its balance checked; 0 on a violation */
+static int vbeside(t_header * ph, t_node * s, v_result * r)
+{
+    int lh, rh;
+
+    lh = vheight(s->tn_llink);
+    rh = vheight(s->tn_rlink);
+    if (!vbalance(ph, s, lh, rh, r))
+	return (0);
+    return (1 + (lh > rh ? lh : rh));
+}
+
+/* vbound: check the key of p lies strictly between the keys of lo and hi, either may be NULL; */
+/* in a multimap it may be equal to them                                                      */
+static Boolean vbound(t_header * ph, t_node * p, t_node * lo, t_node * hi, v_result * r)
+{
+    if ((lo != NULL && !TINORDER(ph, lo + 1, p + 1)) || (hi != NULL && !TINORDER(ph, p + 1, hi + 1)))
+	return (verror(r, BST_ERR_KEY_ORDER, p));
+    return (TRUE);
+}
+
+/* vheight: height of a subtree measured down its taller side as the balance factors say */
+static int vheight(t_node * p)
+{
+    int h;
+
+    for (h = 0; p != NULL; h++)
+	p = p->tn_bf < 0 ? p->tn_rlink : p->tn_llink;
+    return (h);
+}
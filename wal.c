@@ -0,0 +1,542 @@
+/*
++------------------------------------------------------------------+
+| Copyright (C) 2023 Roger P. Johnson, roger0080@netscape.net      |
+|                                                                  |
+| This file is part of libbst.                                     |
+|                                                                  |
+| libbst is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU Lessor General Public License as   |
+| published by the Free Software Foundation, either version 3 of   |
+| the License, or (at your option) any later version.              |
+|                                                                  |
+| libbst is distributed in the hope that it will be useful, but    |
+| WITHOUT ANY WARRANTY; without even the implied warranty of       |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the     |
+| GNU Lessor General Public License for more details.              |
+|                                                                  |
+| You should have received a copy of the GNU Lessor General Public |
+| License along with libbst. If not, see www.gnu.org/licenses.     |
++------------------------------------------------------------------+
+*/
+
+#include <stdio.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef BST_HDR
+#include "bst.h"
+#endif
+
+/* checksum of a record of len bytes at p, of its tw_len first */
+#define  WALSUM(tl, p, len)  tfold(tsum(tsum(SUM_BASIS, &(tl), sizeof(unsigned int)), (p), (len)))
+
+/* the write ahead log of a tree; th_wal points to one */
+struct wal {
+    int fd;			/* the log file */
+    int sync;			/* WalSync */
+    pthread_mutex_t lock;	/* guards all below */
+    pthread_cond_t done;	/* a group commit ended */
+    char *buf;			/* records not yet written */
+    char *spare;		/* the buffer the group commit under way writes */
+    long size;			/* bytes of buf and of spare */
+    long len;			/* bytes in buf */
+    long lsn;			/* bytes logged since the log was opened */
+    long synced;		/* bytes of lsn written and synced */
+    int syncing;		/* a group commit is under way */
+    int err;			/* a write or sync failed; the log takes no more */
+};
+
+static char *RCSid[] = { "$Id$" };
+
+extern int bst_errno;
+
+static Boolean treplay(t_header * ph, char *path, long *good);
+static Boolean tflush(struct wal *pw);
+static Boolean tcommit(struct wal *pw);
+static Boolean twrite(int fd, char *p, long n);
+static unsigned int tfold(unsigned long h);
+
+
+/* bst_wal_open: replay a write ahead log into a tree and log its changes from then on */
+Boolean bst_wal_open(char *tname, char *path, int sync)
+{
+ /*******************************************************************************
+  *  A user acccessible function that gives a tree a write ahead log at path, so
+  *  that a tree kept in memory can be had back after a crash. The records in
+  *  the file, if any, are first replayed into the tree by bst_put and
+  *  bst_remove; a last record cut short or failing its checksum, as one being
+  *  written when the process or system went down, ends the replay and is cut
+  *  off. From then on every bst_put, bst_put_adopt and bst_remove that changes
+  *  the tree appends a record of the leaf to the log before the change is made:
+  *  a struct walrec with the length of the leaf, a remove flag and a checksum,
+  *  then the bytes of the leaf; a put of a key already there, or a remove of one
+  *  that is not, changes nothing and logs nothing.
+  *
+  *  How soon a record reaches the disk is given by sync:
+  *    WAL_NONE   : records are buffered, WAL_BUF bytes at a time, and written
+  *                 when the buffer fills, by bst_wal_commit or on closing;
+  *                 a crash loses what is still buffered.
+  *    WAL_WRITE  : each change writes its record before it returns; it
+  *                 survives the process dying but not the system.
+  *    WAL_COMMIT : records are buffered; bst_wal_commit writes and syncs all
+  *                 of them so far. Threads that call it together share one
+  *                 write and fdatasync (group commit): the first becomes the
+  *                 leader and syncs for all, the others wait for it, and those
+  *                 that come while it syncs are taken by the next leader. A
+  *                 thread holding a lock of its own around bst_put should call
+  *                 bst_wal_commit after letting it go, so others can join.
+  *    WAL_FSYNC  : each change commits its record, as WAL_COMMIT and
+  *                 bst_wal_commit, before it is made.
+  *
+  *  The log grows until bst_checkpoint dumps the tree and empties it. To come
+  *  back after a crash, bst_restore the last checkpoint (or create the tree
+  *  empty if there is none) and bst_wal_open the log. Replaying records the
+  *  checkpoint already holds is harmless, since a put never replaces a leaf.
+  *  That is not so for a multimap (see bst_multimap), where each put replayed
+  *  adds another leaf of the key and each remove takes the first one away, so
+  *  a multimap is refused a log.
+  *  A tree that already has a log has it closed first. bst_delete closes it.
+  *  The tree itself is not made safe for threads: changes to it must still be
+  *  made one at a time.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *  path       : Name of the log file; made if it does not exist.
+  *  sync       : WalSync level of the log.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The log is replayed and the tree logs its changes.
+  *  FALSE      : Tree not defined, frozen, a multimap, malloc error, or the
+  *               log could not be opened; the tree has no log.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+    struct wal *pw;
+    long good;
+
+    extern t_header *find_header(char *);
+    extern Boolean twalclose(t_header * ph);
+    extern void *tmalloc(t_header * ph, size_t size);
+    extern void tmfree(t_header * ph, void *p);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    if (ph->th_frozen) {
+	bst_errno = BST_ERR_TREE_FROZEN;
+	return (FALSE);
+    }
+    if (ph->th_multi) {
+	bst_errno = BST_ERR_WAL_MULTIMAP;
+	return (FALSE);
+    }
+    twalclose(ph);
+
+    if ((pw = (struct wal *) tmalloc(ph, sizeof(struct wal))) == NULL) {
+	bst_errno = BST_ERR_MALLOC;
+	return (FALSE);
+    }
+    pw->size = WAL_BUF > sizeof(t_walrec) + ph->th_usiz ? WAL_BUF : sizeof(t_walrec) + ph->th_usiz;
+    if ((pw->buf = (char *) tmalloc(ph, pw->size)) == NULL || (pw->spare = (char *) tmalloc(ph, pw->size)) == NULL) {
+	tmfree(ph, pw->buf);
+	tmfree(ph, pw);
+	bst_errno = BST_ERR_MALLOC;
+	return (FALSE);
+    }
+
+    /* Replay the log, then append to it from the end of its last whole record: */
+    if (treplay(ph, path, &good) == FALSE || (pw->fd = open(path, O_WRONLY | O_CREAT, 0644)) < 0) {
+	tmfree(ph, pw->spare);
+	tmfree(ph, pw->buf);
+	tmfree(ph, pw);
+	if (bst_errno != BST_ERR_MALLOC)
+	    bst_errno = BST_ERR_WAL_IO;
+	return (FALSE);
+    }
+    if (ftruncate(pw->fd, good) != 0 || lseek(pw->fd, good, SEEK_SET) != good) {
+	close(pw->fd);
+	tmfree(ph, pw->spare);
+	tmfree(ph, pw->buf);
+	tmfree(ph, pw);
+	bst_errno = BST_ERR_WAL_IO;
+	return (FALSE);
+    }
+
+    pw->sync = sync;
+    pthread_mutex_init(&pw->lock, NULL);
+    pthread_cond_init(&pw->done, NULL);
+    pw->len = pw->lsn = pw->synced = 0;
+    pw->syncing = pw->err = 0;
+    ph->th_wal = pw;
+    bst_errno = BST_ERR_RESET;
+    return (TRUE);
+}
+
+/* bst_wal_commit: make every record logged so far durable */
+Boolean bst_wal_commit(char *tname)
+{
+ /*******************************************************************************
+  *  A user acccessible function that returns once every record the write ahead
+  *  log of a tree has taken so far is written and synced to the disk, whatever
+  *  its WalSync level. Calls from several threads at once are served by as few
+  *  writes and syncs as can be (see bst_wal_open). It may be called while
+  *  another thread changes the tree, so unlike the other calls it leaves
+  *  bst_errno alone unless it fails.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The records are on the disk.
+  *  FALSE      : Tree not defined, it has no log, or the log could not be
+  *               written or synced.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; set only on failure.
+  *******************************************************************************/
+
+    t_header *ph;
+
+    extern t_header *find_header(char *);
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    if (ph->th_wal == NULL) {
+	bst_errno = BST_ERR_NO_WAL;
+	return (FALSE);
+    }
+    return (tcommit(ph->th_wal));
+}
+
+/* bst_checkpoint: dump a tree and empty its write ahead log */
+Boolean bst_checkpoint(char *tname, char *path)
+{
+ /*******************************************************************************
+  *  A user acccessible function that writes a tree to path as bst_dump does,
+  *  syncs the dump, and the directory it was renamed into, to the disk, and
+  *  then empties the write ahead log of the tree, so the log holds only the
+  *  changes made after the dump. If the system goes down between the two, the
+  *  whole log is replayed over the new dump, which is harmless (see
+  *  bst_wal_open). The tree must not be changed while this runs.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *  path       : Name of the dump to write; bst_restore reads it back.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The tree is in the dump and the log is empty.
+  *  FALSE      : Tree not defined, it has no log, or the dump or the log could
+  *               not be written; the log is left whole.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+    struct wal *pw;
+    Boolean r;
+
+    extern t_header *find_header(char *);
+    extern Boolean tdump(char *tname, char *path, Boolean durable);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    if ((pw = ph->th_wal) == NULL) {
+	bst_errno = BST_ERR_NO_WAL;
+	return (FALSE);
+    }
+
+    /* The dump, and the rename to it, must be on the disk before the log goes: */
+    if (tdump(tname, path, TRUE) == FALSE)
+	return (FALSE);
+
+    /* Every record so far is in the dump; drop them, written or not: */
+    pthread_mutex_lock(&pw->lock);
+    while (pw->syncing)
+	pthread_cond_wait(&pw->done, &pw->lock);
+    pw->len = 0;
+    pw->synced = pw->lsn;
+    pthread_cond_broadcast(&pw->done);
+    r = !pw->err && ftruncate(pw->fd, 0) == 0 && lseek(pw->fd, 0, SEEK_SET) == 0 && fdatasync(pw->fd) == 0;
+    if (!r)
+	pw->err = 1;
+    pthread_mutex_unlock(&pw->lock);
+    if (!r)
+	bst_errno = BST_ERR_WAL_IO;
+    return (r);
+}
+
+/* bst_wal_close: commit and close the write ahead log of a tree */
+Boolean bst_wal_close(char *tname)
+{
+ /*******************************************************************************
+  *  A user acccessible function that writes and syncs the records of the write
+  *  ahead log of a tree not yet on the disk and closes the log; the tree logs
+  *  no more changes.
+  *
+  *  Input Parameters
+  *  =================
+  *  tname      : Name of the tree.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The log is closed with every record on the disk.
+  *  FALSE      : Tree not defined, it has no log, or the last records could
+  *               not be written; the log is closed all the same.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Global error variable; reset on entry.
+  *******************************************************************************/
+
+    t_header *ph;
+
+    extern t_header *find_header(char *);
+    extern Boolean twalclose(t_header * ph);
+
+    bst_errno = BST_ERR_RESET;
+
+    if ((ph = find_header(tname)) == TREE_NOT_DEFINED) {
+	bst_errno = BST_ERR_TREE_NOT_DEFINED;
+	return (FALSE);
+    }
+    if (ph->th_wal == NULL) {
+	bst_errno = BST_ERR_NO_WAL;
+	return (FALSE);
+    }
+    return (twalclose(ph));
+}
+
+/* twallog: log a put or remove of the leaf of node pn ahead of making it */
+Boolean twallog(t_header * ph, int remove, t_node * pn)
+{
+ /*******************************************************************************
+  *  A private library function called by bst_put, bst_put_adopt and bst_remove
+  *  on a tree with a write ahead log once they know the tree will change, and
+  *  before they change it: it appends the record of the leaf of pn to the log
+  *  and writes or commits it as the WalSync level of the log asks.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record for this tree.
+  *  remove     : TRUE for a remove, FALSE for a put.
+  *  pn         : Pointer to the node whose leaf is put or holds the key removed.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : The record is logged; the change may be made.
+  *  FALSE      : The log could not be written; the change must not be made.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Set to BST_ERR_WAL_IO on failure.
+  *******************************************************************************/
+
+    struct wal *pw;
+    t_walrec w;
+    long n;
+    Boolean r;
+
+    pw = ph->th_wal;
+    w.tw_len = pn->tn_usiz | (remove ? WAL_REMOVE : 0);
+    w.tw_sum = WALSUM(w.tw_len, pn + 1, pn->tn_usiz);
+    n = sizeof(w) + pn->tn_usiz;
+
+    pthread_mutex_lock(&pw->lock);
+    r = !pw->err && (pw->len + n <= pw->size || tflush(pw));
+    if (r) {
+	memcpy(pw->buf + pw->len, &w, sizeof(w));
+	memcpy(pw->buf + pw->len + sizeof(w), pn + 1, pn->tn_usiz);
+	pw->len += n;
+	pw->lsn += n;
+	if (pw->sync == WAL_WRITE)
+	    r = tflush(pw);
+    }
+    pthread_mutex_unlock(&pw->lock);
+
+    if (r && pw->sync == WAL_FSYNC)
+	r = tcommit(pw);
+    if (!r)
+	bst_errno = BST_ERR_WAL_IO;
+    return (r);
+}
+
+/* twalclose: commit and close the write ahead log of a tree, if it has one */
+Boolean twalclose(t_header * ph)
+{
+ /*******************************************************************************
+  *  A private library function closing the log of a tree for bst_wal_close,
+  *  bst_wal_open and bst_delete, after committing the records not yet synced.
+  *
+  *  Input Parameters
+  *  =================
+  *  ph         : Pointer to the header record for this tree.
+  *
+  *  Output Parameters
+  *  =================
+  *  Function name returns Boolean result:
+  *  TRUE       : There was no log, or every record of it is on the disk.
+  *  FALSE      : The last records could not be written or synced.
+  *
+  *  Global Variables
+  *  =================
+  *  bst_errno  : Set to BST_ERR_WAL_IO on failure.
+  *******************************************************************************/
+
+    struct wal *pw;
+    Boolean r;
+
+    extern void tmfree(t_header * ph, void *p);
+
+    if ((pw = ph->th_wal) == NULL)
+	return (TRUE);
+    r = tcommit(pw);
+    close(pw->fd);
+    pthread_mutex_destroy(&pw->lock);
+    pthread_cond_destroy(&pw->done);
+    tmfree(ph, pw->spare);
+    tmfree(ph, pw->buf);
+    tmfree(ph, pw);
+    ph->th_wal = NULL;
+    return (r);
+}
+
+/* treplay: put and remove the leaves of the whole records of the log at path; good is their bytes */
+static Boolean treplay(t_header * ph, char *path, long *good)
+{
+    FILE *fp;
+    t_walrec w;
+    t_node *pn;
+    void *pl;
+    unsigned int len;
+
+    extern void *bst_alloc(char *);
+    extern Boolean bst_put(char *, void *);
+    extern Boolean bst_remove(char *, void *);
+    extern Boolean bst_release(char *, void *);
+
+    *good = 0;
+    if ((fp = fopen(path, "rb")) == NULL)
+	return (TRUE);		/* a new log */
+    if ((pl = bst_alloc(ph->th_name)) == NULL) {
+	fclose(fp);
+	return (FALSE);
+    }
+    setvbuf(fp, NULL, _IOFBF, WAL_BUF);
+
+    /* Each leaf is read into a node of the full size, told the size of the leaf: */
+    pn = (t_node *) pl - 1;
+    while (fread(&w, sizeof(w), 1, fp) == 1) {
+	len = w.tw_len & ~WAL_REMOVE;
+	if (len < 1 || len > (unsigned int) ph->th_usiz || fread(pl, len, 1, fp) != 1
+	    || w.tw_sum != WALSUM(w.tw_len, pl, len))
+	    break;
+	pn->tn_usiz = len;
+	if (w.tw_len & WAL_REMOVE)
+	    bst_remove(ph->th_name, pl);
+	else
+	    bst_put(ph->th_name, pl);
+	*good += sizeof(w) + len;
+    }
+    pn->tn_usiz = ph->th_usiz;
+    bst_release(ph->th_name, pl);
+    fclose(fp);
+    return (TRUE);
+}
+
+/* tflush: write the buffer of a log, after the group commit under way if any; pw->lock is held */
+static Boolean tflush(struct wal *pw)
+{
+    while (pw->syncing)
+	pthread_cond_wait(&pw->done, &pw->lock);
+    if (pw->err || !twrite(pw->fd, pw->buf, pw->len)) {
+	pw->err = 1;
+	return (FALSE);
+    }
+    pw->len = 0;
+    return (TRUE);
+}
+
+/* tcommit: return once every record logged so far is written and synced; leads a group commit if none is under way */
+static Boolean tcommit(struct wal *pw)
+{
+    long target, end, n;
+    char *p;
+    Boolean r;
+
+    pthread_mutex_lock(&pw->lock);
+    target = pw->lsn;
+    while (pw->synced < target && !pw->err)
+	if (pw->syncing)
+	    pthread_cond_wait(&pw->done, &pw->lock);
+	else {
+	    /* lead: take the buffer and everything in it, and let others fill the spare */
+	    pw->syncing = 1;
+	    p = pw->buf;
+	    n = pw->len;
+	    end = pw->lsn;
+	    pw->buf = pw->spare;
+	    pw->len = 0;
+	    pthread_mutex_unlock(&pw->lock);
+
+	    r = twrite(pw->fd, p, n) && fdatasync(pw->fd) == 0;
+
+	    pthread_mutex_lock(&pw->lock);
+	    pw->spare = p;
+	    pw->syncing = 0;
+	    if (r)
+		pw->synced = end;
+	    else
+		pw->err = 1;
+	    pthread_cond_broadcast(&pw->done);
+	}
+    r = !pw->err;
+    pthread_mutex_unlock(&pw->lock);
+    if (!r)
+	bst_errno = BST_ERR_WAL_IO;
+    return (r);
+}
+
+/* twrite: write n bytes at p to fd, however many write calls it takes */
+static Boolean twrite(int fd, char *p, long n)
+{
+    long w;
+
+    for (; n > 0; p += w, n -= w)
+	if ((w = write(fd, p, n)) < 0)
+	    return (FALSE);
+    return (TRUE);
+}
+
+/* tfold: a 64 bit checksum folded to 32 bits */
+static unsigned int tfold(unsigned long h)
+{
+    return ((unsigned int) (h ^ h >> 32));
+}